@@ -0,0 +1,888 @@
+//*****************************************************************************
+// Times the fits of zipf.c against the version 1.5 algorithm they replaced
+// (qsort(), then log10() and pow() for every point), so that the speedups
+// of version 1.6 can be measured again on any machine.
+//
+//    bench/zipf_bench [-n maxValues] [-t maxThreads] [case ...]
+//
+// Runs the named cases (all of them by default; "list" lists them; names
+// of bench/zipf_bench.cpp's cases are skipped). Inputs
+// are capped at maxValues values (default 1e7) and thread counts at
+// maxThreads (default: the number of processors). Each timing is the best
+// of a few runs of at least BENCH_SECONDS. Build it with make bench, and
+// with CFLAGS=-DZIPF_NO_SIMD for the scalar kernels.
+//*****************************************************************************
+
+#include "../zipf.c"
+
+#define BENCH_SECONDS 0.25
+#define BENCH_RUNS    3
+
+static size_t maxValues = 10000000;
+static int maxThreads = 1;
+
+//*****************************************************************************
+// A benchmark case: its name, what it measures and the function that runs it.
+//*****************************************************************************
+struct BenchCase
+{
+   const char *name;
+   const char *about;
+   void (*run)(void);
+};
+
+//*****************************************************************************
+// Seconds since an arbitrary start.
+//*****************************************************************************
+static double seconds(void)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+
+   return now.tv_sec + 1e-9 * now.tv_nsec;
+}
+
+//*****************************************************************************
+// Seconds per call of call(argument): the best of BENCH_RUNS runs, each
+// repeating the call for at least BENCH_SECONDS.
+//*****************************************************************************
+static double timeCall(void (*call)(void *), void *argument)
+{
+   double best = HUGE_VAL;
+   int run;
+
+   for(run=0;run<BENCH_RUNS;run++)
+   {
+      double start = seconds(), elapsed;
+      long numCalls = 0;
+
+      do
+      {
+         call(argument);
+         numCalls++;
+         elapsed = seconds() - start;
+      }
+      while(elapsed < BENCH_SECONDS);
+
+      if(elapsed / numCalls < best)
+         best = elapsed / numCalls;
+   }
+
+   return best;
+}
+
+//*****************************************************************************
+// Prints one timing, per call and per value, with its speedup over the
+// baseline time (when there is one).
+//*****************************************************************************
+static void report(const char *label, size_t numValues, double time, double baseline)
+{
+   printf("   %-34s %11zu %12.3f ms %9.2f ns/value", label, numValues, 1e3 * time, 1e9 * time / numValues);
+   if(baseline > 0)
+      printf(" %8.2fx", baseline / time);
+   printf("\n");
+}
+
+//*****************************************************************************
+// A xorshift64* generator, so that the inputs are the same on every run.
+//*****************************************************************************
+static uint64_t randomState = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t nextRandom(void)
+{
+   randomState ^= randomState >> 12;
+   randomState ^= randomState << 25;
+   randomState ^= randomState >> 27;
+
+   return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+//*****************************************************************************
+// A malloc'ed histogram of numCounts counts, the count of rank r being about
+// scale / r (rounded down to at least 1 if integral, else jittered by up to
+// 1%), as in a corpus of numCounts types. The counts are in random order,
+// or in ascending order (as byRank() sorts them) if ascending is TRUE.
+//*****************************************************************************
+static double *zipfCounts(size_t numCounts, double scale, int integral, int ascending)
+{
+   double *counts = (double *)malloc(sizeof(double) * numCounts);
+   size_t index;
+
+   for(index=0;index<numCounts;index++)
+   {
+      double count = scale / (index + 1);
+
+      // (the jitter keeps the counts of neighbouring ranks in order)
+      if(integral)
+         count = count < 1 ? 1 : floor(count);
+      else
+         count *= 1 + 0.01 * (nextRandom() >> 11) * 0x1.0p-53 / (index + 1);
+
+      counts[ascending ? numCounts - 1 - index : index] = count;
+   }
+
+   for(index=numCounts-1;index>0&&!ascending;index--)
+   {
+      size_t other = nextRandom() % (index + 1);
+      double count = counts[index];
+
+      counts[index] = counts[other];
+      counts[other] = count;
+   }
+
+   return counts;
+}
+
+//*****************************************************************************
+// Version 1.5's checkRanksAndCounts() and getSlopeR2(), for explicit ranks
+// (its three passes: validation, the all-equal check and the sums).
+//*****************************************************************************
+static void referenceSlopeR2(const int *ranks, const double *counts, size_t numRanks, struct ZipfValues *results)
+{
+   double sumX, sumY, sumXY, sumX2, sumY2, slope, r2;
+   size_t index;
+   int allCountsEqual = 1;
+
+   for(index=0;index<numRanks;index++)
+   {
+      if(ranks[index] <= 0.0 || counts[index] <= 0.0)
+      {
+         fprintf(stderr, "Ranks and counts should be strictly positive.\n");
+         exit(0);
+      }
+   }
+
+   for(index=0;(index < numRanks - 1) && allCountsEqual;index++)
+   {
+      if(counts[index] != counts[index + 1])
+         allCountsEqual = 0;
+   }
+   if(numRanks == 1 || allCountsEqual)
+   {
+      results->slope = results->yint = 0;
+      results->r2 = numRanks == 1 ? 0 : 1;
+      return;
+   }
+
+   sumX = sumY = sumXY = sumX2 = sumY2 = 0.0;
+   for(index=0;index<numRanks;index++)
+   {
+      double tmp1 = log10(ranks[index]);
+      double tmp2 = log10(counts[index]);
+
+      sumX  += tmp1;
+      sumY  += tmp2;
+      sumXY += tmp1 * tmp2;
+      sumX2 += pow(tmp1, 2);
+      sumY2 += pow(tmp2, 2);
+   }
+
+   slope = (numRanks*sumXY - sumX*sumY) / (numRanks*sumX2 - sumX*sumX);
+   r2 = (numRanks*sumXY - sumX*sumY)/(sqrt(numRanks*sumX2 - sumX*sumX)*sqrt(numRanks*sumY2 - sumY*sumY));
+
+   results->slope = slope;
+   results->r2    = r2 * r2;
+   results->yint  = (sumY - slope * sumX) / numRanks;
+}
+
+//*****************************************************************************
+// Prints how far a fit is from the reference one.
+//*****************************************************************************
+static void reportError(const char *label, const struct ZipfValues *fit, const struct ZipfValues *reference)
+{
+   printf("   %-34s slope %.3g, r2 %.3g, yint %.3g (relative error)\n", label,
+          fabs(fit->slope - reference->slope) / fabs(reference->slope),
+          fabs(fit->r2 - reference->r2) / fabs(reference->r2),
+          fabs(fit->yint - reference->yint) / fabs(reference->yint));
+}
+
+//*****************************************************************************
+// The arguments of the timed regression calls.
+//*****************************************************************************
+struct RegressionCall
+{
+   int *ranks;
+   double *counts;
+   size_t numValues;
+   struct ZipfValues results;
+};
+
+static void callReference(void *argument)
+{
+   struct RegressionCall *call = (struct RegressionCall *)argument;
+
+   referenceSlopeR2(call->ranks, call->counts, call->numValues, &call->results);
+}
+
+static void callSlopeR2(void *argument)
+{
+   struct RegressionCall *call = (struct RegressionCall *)argument;
+
+   getSlopeR2Into(call->ranks, call->numValues, call->counts, call->numValues, &call->results);
+}
+
+//*****************************************************************************
+// getSlopeR2() with explicit ranks: the per-point log10()s and sums
+// (vectorized, when the CPU allows) against version 1.5's loop.
+//*****************************************************************************
+static void benchRegression(void)
+{
+   size_t numValues = maxValues < 1000000 ? maxValues : 1000000, index;
+   struct RegressionCall call;
+   struct ZipfValues reference;
+   double baseline;
+
+   // the counts in ascending order, against their ranks, as byRank() fits them
+   call.counts = zipfCounts(numValues, 1e6, 0, TRUE);
+   call.ranks = (int *)malloc(sizeof(int) * numValues);
+   call.numValues = numValues;
+   for(index=0;index<numValues;index++)
+      call.ranks[index] = (int)(numValues - index);
+
+#ifdef ZIPF_X86_SIMD
+   printf("   kernels: %s\n", __builtin_cpu_supports("avx512f") ? "AVX-512" :
+          __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? "AVX2" : "scalar");
+#else
+   printf("   kernels: scalar (ZIPF_NO_SIMD)\n");
+#endif
+
+   baseline = timeCall(callReference, &call);
+   reference = call.results;
+   report("version 1.5 loop", numValues, baseline, 0);
+   report("getSlopeR2Into", numValues, timeCall(callSlopeR2, &call), baseline);
+   reportError("getSlopeR2Into", &call.results, &reference);
+
+   free(call.ranks);
+   free(call.counts);
+}
+
+//*****************************************************************************
+// getSlopeR2() with implicit ranks (sumX from lgamma(), sumX2 from the
+// cached prefix sums, so only the counts are log'ed per point) against
+// explicit ranks and version 1.5's loop, for 1e3 to 1e8 values. The error
+// of the closed-form sums is measured against long double sums.
+//*****************************************************************************
+static void benchImplicitRanks(void)
+{
+   size_t numValues, index;
+
+   for(numValues=1000;numValues<=maxValues&&numValues<=100000000;numValues*=10)
+   {
+      struct RegressionCall call;
+      struct ZipfValues reference;
+      long double exactX = 0, exactX2 = 0;
+      double sumX, sumX2, baseline;
+      char label[64];
+
+      call.counts = zipfCounts(numValues, 1e6, 0, TRUE);
+      call.ranks = (int *)malloc(sizeof(int) * numValues);
+      call.numValues = numValues;
+      for(index=0;index<numValues;index++)
+         call.ranks[index] = (int)(numValues - index);
+
+      baseline = timeCall(callReference, &call);
+      reference = call.results;
+      report("version 1.5 loop", numValues, baseline, 0);
+      report("getSlopeR2Into, explicit ranks", numValues, timeCall(callSlopeR2, &call), baseline);
+      free(call.ranks);
+      call.ranks = NULL;
+      report("getSlopeR2Into, implicit ranks", numValues, timeCall(callSlopeR2, &call), baseline);
+      reportError("getSlopeR2Into, implicit ranks", &call.results, &reference);
+
+      for(index=1;index<=numValues;index++)
+      {
+         long double x = log10l((long double)index);
+
+         exactX += x;
+         exactX2 += x * x;
+      }
+      rankLogSums(numValues, &sumX, &sumX2);
+      sprintf(label, "rankLogSums(%zu)", numValues);
+      printf("   %-34s sumX %.3g, sumX2 %.3g (relative error)\n", label,
+             (double)(fabsl(sumX - exactX) / exactX), (double)(fabsl(sumX2 - exactX2) / exactX2));
+
+      free(call.counts);
+   }
+}
+
+//*****************************************************************************
+// The arguments of the timed sorts and byRank() calls.
+//*****************************************************************************
+struct SortCall
+{
+   double *counts;
+   size_t numCounts;
+   double *copy;
+   int *ranks;
+   struct ZipfWorkspace *workspace;
+   struct ZipfValues results;
+};
+
+static void callQsort(void *argument)
+{
+   struct SortCall *call = (struct SortCall *)argument;
+
+   memcpy(call->copy, call->counts, sizeof(double) * call->numCounts);
+   qsort(call->copy, call->numCounts, sizeof(double), compare);
+}
+
+static void callSortedCopy(void *argument)
+{
+   struct SortCall *call = (struct SortCall *)argument;
+
+   sortedCopy(call->counts, call->numCounts, call->workspace);
+}
+
+// version 1.5's byRank(): a sorted copy, a rank array and getSlopeR2()
+static void callReferenceByRank(void *argument)
+{
+   struct SortCall *call = (struct SortCall *)argument;
+   size_t index;
+
+   callQsort(call);
+   for(index=0;index<call->numCounts;index++)
+      call->ranks[index] = (int)(call->numCounts - index);
+   referenceSlopeR2(call->ranks, call->copy, call->numCounts, &call->results);
+}
+
+static void callByRank(void *argument)
+{
+   struct SortCall *call = (struct SortCall *)argument;
+
+   byRankInto(call->counts, call->numCounts, &call->results, call->workspace);
+}
+
+//*****************************************************************************
+// The sort of byRank() (a counting sort for small integral counts, else a
+// radix sort), and byRank() as a whole, against version 1.5's qsort() on
+// one thread. (bench/zipf_bench.cpp compares it with std::sort().)
+//*****************************************************************************
+static void benchSort(void)
+{
+   size_t numCounts;
+   int integral;
+
+   setZipfThreads(1);
+   for(integral=TRUE;integral>=FALSE;integral--)
+   {
+      printf("   %s counts\n", integral ? "integral (counting sort)" : "fractional (radix sort)");
+
+      for(numCounts=10000;numCounts<=maxValues;numCounts*=10)
+      {
+         struct SortCall call;
+         struct ZipfValues reference;
+         double baseline;
+
+         // (integral counts below numCounts, as in a corpus with many rare types)
+         call.counts = zipfCounts(numCounts, integral ? numCounts / 10 : 1e6, integral, FALSE);
+         call.numCounts = numCounts;
+         call.copy = (double *)malloc(sizeof(double) * numCounts);
+         call.ranks = (int *)malloc(sizeof(int) * numCounts);
+         call.workspace = createZipfWorkspace();
+
+         baseline = timeCall(callQsort, &call);
+         report("qsort", numCounts, baseline, 0);
+         report("sortedCopy", numCounts, timeCall(callSortedCopy, &call), baseline);
+
+         baseline = timeCall(callReferenceByRank, &call);
+         reference = call.results;
+         report("version 1.5 byRank", numCounts, baseline, 0);
+         report("byRankInto", numCounts, timeCall(callByRank, &call), baseline);
+         reportError("byRankInto", &call.results, &reference);
+
+         freeZipfWorkspace(call.workspace);
+         free(call.ranks);
+         free(call.copy);
+         free(call.counts);
+      }
+   }
+}
+
+//*****************************************************************************
+// byRank() (parallel sort, then parallel sums) and getSlopeR2() with implicit
+// ranks on 1 to maxThreads threads (doubling), checking that every thread
+// count gives bitwise the same zipf values.
+//*****************************************************************************
+static void benchThreads(void)
+{
+   size_t numCounts = maxValues;
+   int integral, numThreads;
+
+   for(integral=TRUE;integral>=FALSE;integral--)
+   {
+      struct SortCall sortCall;
+      struct RegressionCall regressionCall;
+      struct ZipfValues byRankResults, slopeR2Results;
+      double byRankBaseline = 0, slopeR2Baseline = 0;
+
+      printf("   %s counts\n", integral ? "integral" : "fractional");
+      sortCall.counts = zipfCounts(numCounts, integral ? numCounts / 10 : 1e6, integral, FALSE);
+      sortCall.numCounts = numCounts;
+      sortCall.workspace = createZipfWorkspace();
+      regressionCall.counts = zipfCounts(numCounts, 1e6, integral, TRUE);
+      regressionCall.ranks = NULL;
+      regressionCall.numValues = numCounts;
+
+      for(numThreads=1;;numThreads=2*numThreads<maxThreads?2*numThreads:maxThreads)
+      {
+         char label[64];
+         double time;
+
+         setZipfThreads(numThreads);
+
+         time = timeCall(callByRank, &sortCall);
+         sprintf(label, "byRankInto, %d thread%s", numThreads, numThreads > 1 ? "s" : "");
+         report(label, numCounts, time, byRankBaseline);
+         if(numThreads == 1)
+         {
+            byRankBaseline = time;
+            byRankResults = sortCall.results;
+         }
+         else if(memcmp(&sortCall.results, &byRankResults, sizeof(struct ZipfValues)) != 0)
+            printf("   %-34s DIFFERENT zipf values than on 1 thread\n", label);
+
+         time = timeCall(callSlopeR2, &regressionCall);
+         sprintf(label, "getSlopeR2Into, %d thread%s", numThreads, numThreads > 1 ? "s" : "");
+         report(label, numCounts, time, slopeR2Baseline);
+         if(numThreads == 1)
+         {
+            slopeR2Baseline = time;
+            slopeR2Results = regressionCall.results;
+         }
+         else if(memcmp(&regressionCall.results, &slopeR2Results, sizeof(struct ZipfValues)) != 0)
+            printf("   %-34s DIFFERENT zipf values than on 1 thread\n", label);
+
+         if(numThreads == maxThreads)
+            break;
+      }
+
+      free(regressionCall.counts);
+      freeZipfWorkspace(sortCall.workspace);
+      free(sortCall.counts);
+   }
+
+   setZipfThreads(1);
+}
+
+//*****************************************************************************
+// Writes a text corpus of about numBytes bytes to a temporary file and
+// returns its (malloc'ed) path: words drawn from a vocabulary of 2e5 (about
+// that of 160 MB of English text) with probability proportional to 1 / rank,
+// separated by spaces, punctuation and newlines.
+//*****************************************************************************
+static char *writeCorpus(size_t numBytes)
+{
+   static const char separators[] = "       ,.\n";
+   const char *directory = getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp";
+   char *path = (char *)malloc(strlen(directory) + 32);
+   char *text = (char *)malloc(numBytes + 16);
+   size_t length = 0;
+   FILE *file;
+   int descriptor;
+
+   sprintf(path, "%s/zipf_bench_XXXXXX", directory);
+   if((descriptor = mkstemp(path)) < 0 || (file = fdopen(descriptor, "wb")) == NULL)
+   {
+      fprintf(stderr, "Could not create %s.\n", path);
+      exit(1);
+   }
+
+   while(length < numBytes)
+   {
+      // rank = 2e5^u is distributed as 1 / rank, and rarer words are
+      // longer (1 to 8 letters, 4.5 on average, as in English text)
+      uint64_t rank = (uint64_t)exp(12.206072645530174 * ((nextRandom() >> 11) * 0x1.0p-53));
+      int letters = 1 + (int)(0.45 * log2((double)rank + 1)), letter;
+
+      for(letter=0;letter<letters;letter++,rank/=26)
+         text[length++] = "etaoinshrdlcumwfgypbvkjxqz"[rank % 26];
+      text[length++] = separators[nextRandom() % (sizeof(separators) - 1)];
+   }
+
+   if(fwrite(text, 1, length, file) != length || fclose(file) != 0)
+   {
+      fprintf(stderr, "Could not write %s.\n", path);
+      exit(1);
+   }
+   free(text);
+
+   return path;
+}
+
+//*****************************************************************************
+// The arguments of the timed corpus counts.
+//*****************************************************************************
+struct CorpusCall
+{
+   const char *path;
+   size_t numTypes;
+};
+
+static void callCountTokens(void *argument)
+{
+   struct CorpusCall *call = (struct CorpusCall *)argument;
+   struct ZipfTokenTable *table = createZipfTokenTable();
+
+   countZipfTokensFile(table, call->path);
+   call->numTypes = getZipfTokenTypes(table);
+   freeZipfTokenTable(table);
+}
+
+static void callCorpus(void *argument)
+{
+   struct CorpusCall *call = (struct CorpusCall *)argument;
+
+   free(byRankCorpus(call->path));
+}
+
+//*****************************************************************************
+// Prints the throughput of a timed pass over numBytes bytes.
+//*****************************************************************************
+static void reportThroughput(const char *label, size_t numBytes, double time, double baseline)
+{
+   printf("   %-34s %11zu %12.3f ms %9.2f GB/s", label, numBytes, 1e3 * time, 1e-9 * numBytes / time);
+   if(baseline > 0)
+      printf(" %8.2fx", baseline / time);
+   printf("\n");
+}
+
+//*****************************************************************************
+// byRankCorpus() on one thread, over a generated corpus of 16 bytes per
+// -n value (160 MB by default), kept in the page cache: counting its tokens
+// into a fresh table, then counting and fitting them.
+//*****************************************************************************
+static void benchCorpus(void)
+{
+   size_t numBytes = 16 * maxValues;
+   struct CorpusCall call;
+
+   call.path = writeCorpus(numBytes);
+   setZipfThreads(1);
+
+   reportThroughput("countZipfTokensFile", numBytes, timeCall(callCountTokens, &call), 0);
+   printf("   %-34s %11zu types\n", "", call.numTypes);
+   reportThroughput("byRankCorpus", numBytes, timeCall(callCorpus, &call), 0);
+
+   remove(call.path);
+   free((char *)call.path);
+}
+
+//*****************************************************************************
+// byRankCorpus() over the corpus of the corpus case on 1 to maxThreads
+// threads (doubling): sharded counting, then the parallel merge. Every
+// thread count must give bitwise the same zipf values.
+//*****************************************************************************
+static void benchCorpusThreads(void)
+{
+   size_t numBytes = 16 * maxValues;
+   struct CorpusCall call;
+   struct ZipfValues *results, first = { 0, 0, 0 };
+   double baseline = 0;
+   int numThreads;
+
+   call.path = writeCorpus(numBytes);
+
+   for(numThreads=1;;numThreads=2*numThreads<maxThreads?2*numThreads:maxThreads)
+   {
+      char label[64];
+      double time;
+
+      setZipfThreads(numThreads);
+      time = timeCall(callCorpus, &call);
+      sprintf(label, "byRankCorpus, %d thread%s", numThreads, numThreads > 1 ? "s" : "");
+      reportThroughput(label, numBytes, time, baseline);
+
+      results = byRankCorpus(call.path);
+      if(numThreads == 1)
+      {
+         baseline = time;
+         first = *results;
+      }
+      else if(memcmp(results, &first, sizeof(struct ZipfValues)) != 0)
+         printf("   %-34s DIFFERENT zipf values than on 1 thread\n", label);
+      free(results);
+
+      if(numThreads == maxThreads)
+         break;
+   }
+
+   setZipfThreads(1);
+   remove(call.path);
+   free((char *)call.path);
+}
+
+//*****************************************************************************
+// Prints the number of histograms fitted per second by a timed call over
+// numHistograms histograms.
+//*****************************************************************************
+static void reportRate(const char *label, size_t numHistograms, double time, double baseline)
+{
+   printf("   %-34s %11zu %12.3f ms %9.3g fits/s", label, numHistograms, 1e3 * time, numHistograms / time);
+   if(baseline > 0)
+      printf(" %8.2fx", baseline / time);
+   printf("\n");
+}
+
+//*****************************************************************************
+// The arguments of the timed batch fits.
+//*****************************************************************************
+struct BatchCall
+{
+   double *values;
+   size_t *offsets;
+   size_t numBins;
+   size_t numHistograms;
+   double *copy;
+   int *ranks;
+   struct ZipfWorkspace *workspace;
+   struct ZipfValues *results;
+};
+
+// version 1.5's byRank() on each histogram, allocating as it did
+static void callReferenceEach(void *argument)
+{
+   struct BatchCall *call = (struct BatchCall *)argument;
+   size_t histogram, index, numBins = call->numBins;
+
+   for(histogram=0;histogram<call->numHistograms;histogram++)
+   {
+      double *copy = (double *)malloc(sizeof(double) * numBins);
+      int *ranks = (int *)malloc(sizeof(int) * numBins);
+
+      memcpy(copy, call->values + histogram * numBins, sizeof(double) * numBins);
+      qsort(copy, numBins, sizeof(double), compare);
+      for(index=0;index<numBins;index++)
+         ranks[index] = (int)(numBins - index);
+      referenceSlopeR2(ranks, copy, numBins, &call->results[histogram]);
+
+      free(ranks);
+      free(copy);
+   }
+}
+
+static void callByRankEach(void *argument)
+{
+   struct BatchCall *call = (struct BatchCall *)argument;
+   size_t histogram;
+
+   for(histogram=0;histogram<call->numHistograms;histogram++)
+      byRankInto(call->values + histogram * call->numBins, call->numBins, &call->results[histogram], call->workspace);
+}
+
+static void callByRankBatch(void *argument)
+{
+   struct BatchCall *call = (struct BatchCall *)argument;
+
+   byRankBatch(call->values, call->offsets, call->numHistograms, call->results);
+}
+
+static void callByRankBatchEqual(void *argument)
+{
+   struct BatchCall *call = (struct BatchCall *)argument;
+
+   byRankBatchEqual(call->values, call->numBins, call->numHistograms, call->results);
+}
+
+//*****************************************************************************
+// Fits per second of many small histograms (10 to 200 bins of small integer
+// counts, as in the features of a music corpus) on one thread: version
+// 1.5's byRank() on each, byRankInto() with a reused workspace on each,
+// byRankBatch() and byRankBatchEqual().
+//*****************************************************************************
+static void benchBatch(void)
+{
+   static const size_t binCounts[] = { 10, 12, 50, 128, 200 };
+   size_t size, histogram, index;
+
+   setZipfThreads(1);
+   for(size=0;size<sizeof(binCounts)/sizeof(binCounts[0]);size++)
+   {
+      struct BatchCall call;
+      double baseline;
+      size_t numBins = binCounts[size];
+
+      call.numBins = numBins;
+      call.numHistograms = maxValues / numBins < 100000 ? maxValues / numBins : 100000;
+      call.values = (double *)malloc(sizeof(double) * numBins * call.numHistograms);
+      call.offsets = (size_t *)malloc(sizeof(size_t) * (call.numHistograms + 1));
+      call.results = (struct ZipfValues *)malloc(sizeof(struct ZipfValues) * call.numHistograms);
+      call.workspace = createZipfWorkspace();
+      for(histogram=0;histogram<call.numHistograms;histogram++)
+      {
+         double *counts = zipfCounts(numBins, 1000, TRUE, FALSE);
+
+         for(index=0;index<numBins;index++)
+            call.values[histogram * numBins + index] = counts[index];
+         call.offsets[histogram] = histogram * numBins;
+         free(counts);
+      }
+      call.offsets[call.numHistograms] = call.numHistograms * numBins;
+
+      printf("   %zu bins\n", numBins);
+      baseline = timeCall(callReferenceEach, &call);
+      reportRate("version 1.5 byRank, each", call.numHistograms, baseline, 0);
+      reportRate("byRankInto, each", call.numHistograms, timeCall(callByRankEach, &call), baseline);
+      reportRate("byRankBatch", call.numHistograms, timeCall(callByRankBatch, &call), baseline);
+      reportRate("byRankBatchEqual", call.numHistograms, timeCall(callByRankBatchEqual, &call), baseline);
+
+      freeZipfWorkspace(call.workspace);
+      free(call.results);
+      free(call.offsets);
+      free(call.values);
+   }
+}
+
+//*****************************************************************************
+// getSlopeR2() with implicit ranks on Zipf-distributed integer counts (up to
+// 1e6, so their log10()s are looked up in the shared table) against the
+// same counts plus 0.5 (so they are computed) and version 1.5's loop.
+//*****************************************************************************
+static void benchCountLogs(void)
+{
+   size_t numValues, index;
+
+   for(numValues=100000;numValues<=maxValues;numValues*=10)
+   {
+      struct RegressionCall call;
+      struct ZipfValues reference;
+      double *integral = zipfCounts(numValues, 1e6, TRUE, TRUE);
+      double *fractional = (double *)malloc(sizeof(double) * numValues);
+      double baseline;
+
+      for(index=0;index<numValues;index++)
+         fractional[index] = integral[index] + 0.5;
+      call.ranks = (int *)malloc(sizeof(int) * numValues);
+      call.numValues = numValues;
+      for(index=0;index<numValues;index++)
+         call.ranks[index] = (int)(numValues - index);
+
+      call.counts = integral;
+      baseline = timeCall(callReference, &call);
+      reference = call.results;
+      report("version 1.5 loop", numValues, baseline, 0);
+      free(call.ranks);
+      call.ranks = NULL;
+      report("getSlopeR2Into, looked-up logs", numValues, timeCall(callSlopeR2, &call), baseline);
+      reportError("getSlopeR2Into, looked-up logs", &call.results, &reference);
+      call.counts = fractional;
+      report("getSlopeR2Into, computed logs", numValues, timeCall(callSlopeR2, &call), baseline);
+
+      free(fractional);
+      free(integral);
+   }
+}
+
+//*****************************************************************************
+// getSlopeR2() with implicit ranks on noisy relative frequencies (Zipf
+// exponents 0.8, 1 and 1.5, 1e6 values at most) with each log accuracy
+// tier of setZipfLogAccuracy(): its speed and its error against
+// ZIPF_LOG_EXACT (to the floats' precision, about 6e-8).
+//*****************************************************************************
+static void benchLogAccuracy(void)
+{
+   static const char *tiers[] = { "ZIPF_LOG_EXACT", "ZIPF_LOG_FINE", "ZIPF_LOG_FAST", "ZIPF_LOG_FASTEST" };
+   static const double exponents[] = { 0.8, 1.0, 1.5 };
+   size_t numValues = maxValues < 1000000 ? maxValues : 1000000, index;
+   int exponent, tier;
+
+   for(exponent=0;exponent<3;exponent++)
+   {
+      struct RegressionCall call;
+      struct ZipfValues exact = { 0, 0, 0 };
+      double baseline = 0;
+
+      // relative frequencies of ranks numValues..1, with 10% noise
+      call.counts = (double *)malloc(sizeof(double) * numValues);
+      call.ranks = NULL;
+      call.numValues = numValues;
+      for(index=0;index<numValues;index++)
+         call.counts[index] = pow((double)(numValues - index), -exponents[exponent]) *
+                              (1 + 0.1 * (nextRandom() >> 11) * 0x1.0p-53) / numValues;
+
+      printf("   exponent %g\n", exponents[exponent]);
+      for(tier=ZIPF_LOG_EXACT;tier<=ZIPF_LOG_FASTEST;tier++)
+      {
+         double time;
+
+         setZipfLogAccuracy(tier);
+         time = timeCall(callSlopeR2, &call);
+         report(tiers[tier], numValues, time, baseline);
+         if(tier == ZIPF_LOG_EXACT)
+         {
+            baseline = time;
+            exact = call.results;
+         }
+         else
+            reportError(tiers[tier], &call.results, &exact);
+      }
+
+      free(call.counts);
+   }
+
+   setZipfLogAccuracy(ZIPF_LOG_EXACT);
+}
+
+static const struct BenchCase benchCases[] =
+{
+   { "regression", "getSlopeR2() with explicit ranks (vectorized sums)", benchRegression },
+   { "implicit", "getSlopeR2() with implicit ranks (closed-form rank sums)", benchImplicitRanks },
+   { "sort", "byRank()'s counting and radix sorts against qsort()", benchSort },
+   { "threads", "byRank() and getSlopeR2() on 1 to maxThreads threads", benchThreads },
+   { "corpus", "counting the tokens of a text corpus and fitting them", benchCorpus },
+   { "corpus-threads", "byRankCorpus() on 1 to maxThreads threads", benchCorpusThreads },
+   { "batch", "fits per second of many small histograms", benchBatch },
+   { "count-logs", "getSlopeR2() on integer counts (table lookups of their logs)", benchCountLogs },
+   { "log-accuracy", "the speed and error of the approximate log10() tiers", benchLogAccuracy }
+};
+
+#define NUM_BENCH_CASES (sizeof(benchCases) / sizeof(benchCases[0]))
+
+int main(int argc, char **argv)
+{
+   size_t index;
+   int argument;
+   long processors = sysconf(_SC_NPROCESSORS_ONLN);
+
+   maxThreads = processors > 0 ? (int)processors : 1;
+
+   for(argument=1;argument<argc;argument++)
+   {
+      if(strcmp(argv[argument], "-n") == 0 && argument + 1 < argc)
+         maxValues = (size_t)strtod(argv[++argument], NULL);
+      else if(strcmp(argv[argument], "-t") == 0 && argument + 1 < argc)
+         maxThreads = atoi(argv[++argument]);
+      else if(strcmp(argv[argument], "list") == 0)
+      {
+         for(index=0;index<NUM_BENCH_CASES;index++)
+            printf("%-16s %s\n", benchCases[index].name, benchCases[index].about);
+         return 0;
+      }
+   }
+   if(maxValues < 1000 || maxThreads < 1)
+   {
+      fprintf(stderr, "Usage: %s [-n maxValues (at least 1000)] [-t maxThreads] [case ...]\n", argv[0]);
+      return 1;
+   }
+
+   for(index=0;index<NUM_BENCH_CASES;index++)
+   {
+      int selected = 1;
+
+      for(argument=1;argument<argc;argument++)
+      {
+         if(argv[argument][0] == '-')
+            argument++;
+         else if((selected = strcmp(argv[argument], benchCases[index].name) == 0))
+            break;
+      }
+      if(!selected)
+         continue;
+
+      printf("%s: %s\n", benchCases[index].name, benchCases[index].about);
+      benchCases[index].run();
+      fflush(stdout);
+   }
+
+   return 0;
+}
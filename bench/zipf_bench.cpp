@@ -0,0 +1,295 @@
+//*****************************************************************************
+// The C++ side of bench/zipf_bench.c: times zipf.c (compiled as C and
+// linked in) against what C++ code would use instead, and zipf.hpp against
+// zipf.c.
+//
+//    bench/zipf_bench_cpp [-n maxValues] [case ...]
+//
+// Runs the named cases (all of them by default; "list" lists them), with
+// the same timings as bench/zipf_bench.c. Names of that driver's cases are
+// skipped, since make bench passes both drivers the same arguments.
+//*****************************************************************************
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "../zipf.hpp"
+
+extern "C"
+{
+struct ZipfValues
+{
+   float slope;
+   float r2;
+   float yint;
+};
+
+struct ZipfWorkspace;
+
+struct ZipfWorkspace *createZipfWorkspace(void);
+void freeZipfWorkspace(struct ZipfWorkspace *);
+double *sortedCopy(double *, size_t, struct ZipfWorkspace *);
+int byRankInto(double *, size_t, struct ZipfValues *, struct ZipfWorkspace *);
+int bySize64Into(int64_t *, size_t, double *, size_t, struct ZipfValues *);
+int byRankBatchEqual(const double *, size_t, size_t, struct ZipfValues *);
+void setZipfThreads(int);
+}
+
+namespace
+{
+
+const double benchSeconds = 0.25;
+const int benchRuns = 3;
+
+std::size_t maxValues = 10000000;
+std::mt19937_64 randomEngine(0x9e3779b97f4a7c15ULL);
+
+//*****************************************************************************
+// Seconds per call of call(): the best of benchRuns runs, each repeating
+// the call for at least benchSeconds.
+//*****************************************************************************
+template <class Call>
+double timeCall(Call call)
+{
+   double best = HUGE_VAL;
+
+   for(int run=0;run<benchRuns;run++)
+   {
+      auto start = std::chrono::steady_clock::now();
+      double elapsed;
+      long numCalls = 0;
+
+      do
+      {
+         call();
+         numCalls++;
+         elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      }
+      while(elapsed < benchSeconds);
+
+      best = std::min(best, elapsed / numCalls);
+   }
+
+   return best;
+}
+
+//*****************************************************************************
+// Prints one timing, per call and per value, with its speedup over the
+// baseline time (when there is one).
+//*****************************************************************************
+void report(const char *label, std::size_t numValues, double time, double baseline)
+{
+   std::printf("   %-34s %11zu %12.3f ms %9.2f ns/value", label, numValues, 1e3 * time, 1e9 * time / numValues);
+   if(baseline > 0)
+      std::printf(" %8.2fx", baseline / time);
+   std::printf("\n");
+}
+
+//*****************************************************************************
+// numCounts counts in random order, the count of rank r being about
+// scale / r (rounded down to at least 1 if integral, else jittered by up
+// to 1%), as zipfCounts() of bench/zipf_bench.c makes them.
+//*****************************************************************************
+std::vector<double> zipfCounts(std::size_t numCounts, double scale, bool integral)
+{
+   std::uniform_real_distribution<double> jitter(0.0, 0.01);
+   std::vector<double> counts(numCounts);
+
+   for(std::size_t index=0;index<numCounts;index++)
+   {
+      double count = scale / (index + 1);
+
+      counts[index] = integral ? std::max(1.0, std::floor(count)) : count * (1 + jitter(randomEngine) / (index + 1));
+   }
+   std::shuffle(counts.begin(), counts.end(), randomEngine);
+
+   return counts;
+}
+
+//*****************************************************************************
+// The sort of byRank() (through sortedCopy()) against std::sort() on one
+// thread, for the inputs of bench/zipf_bench.c's sort case.
+//*****************************************************************************
+void benchSort()
+{
+   setZipfThreads(1);
+   for(int integral=1;integral>=0;integral--)
+   {
+      std::printf("   %s counts\n", integral ? "integral (counting sort)" : "fractional (radix sort)");
+
+      for(std::size_t numCounts=10000;numCounts<=maxValues;numCounts*=10)
+      {
+         std::vector<double> counts = zipfCounts(numCounts, integral ? numCounts / 10 : 1e6, integral);
+         std::vector<double> copy(numCounts);
+         struct ZipfWorkspace *workspace = createZipfWorkspace();
+
+         double baseline = timeCall([&] {
+            std::copy(counts.begin(), counts.end(), copy.begin());
+            std::sort(copy.begin(), copy.end());
+         });
+         report("std::sort", numCounts, baseline, 0);
+         report("sortedCopy", numCounts, timeCall([&] { sortedCopy(counts.data(), numCounts, workspace); }), baseline);
+
+         freeZipfWorkspace(workspace);
+      }
+   }
+}
+
+//*****************************************************************************
+// Prints the number of histograms fitted per second by a timed call over
+// numHistograms histograms.
+//*****************************************************************************
+void reportRate(const char *label, std::size_t numHistograms, double time, double baseline)
+{
+   std::printf("   %-34s %11zu %12.3f ms %9.3g fits/s", label, numHistograms, 1e3 * time, numHistograms / time);
+   if(baseline > 0)
+      std::printf(" %8.2fx", baseline / time);
+   std::printf("\n");
+}
+
+//*****************************************************************************
+// The largest difference between the zipf values of zipf.hpp and zipf.c.
+//*****************************************************************************
+double largestDifference(const std::vector<zipf::values> &fits, const std::vector<ZipfValues> &references)
+{
+   double largest = 0;
+
+   for(std::size_t index=0;index<fits.size();index++)
+   {
+      largest = std::max(largest, (double)std::fabs(fits[index].slope - references[index].slope));
+      largest = std::max(largest, (double)std::fabs(fits[index].r2 - references[index].r2));
+      largest = std::max(largest, (double)std::fabs(fits[index].yint - references[index].yint));
+   }
+
+   return largest;
+}
+
+//*****************************************************************************
+// zipf::by_rank<N> and zipf::by_size<N> on many histograms of N small integer
+// counts, against byRankInto() (with a reused workspace), byRankBatchEqual()
+// and bySize64Into() on one thread.
+//*****************************************************************************
+template<std::size_t N>
+void benchFixedSize()
+{
+   std::size_t numHistograms = std::min<std::size_t>(100000, maxValues / N);
+   std::vector<std::array<double, N>> histograms(numHistograms);
+   std::array<std::int64_t, N> sizes;
+   std::vector<zipf::values> fits(numHistograms);
+   std::vector<ZipfValues> references(numHistograms);
+   struct ZipfWorkspace *workspace = createZipfWorkspace();
+
+   for(std::array<double, N> &histogram : histograms)
+   {
+      std::vector<double> counts = zipfCounts(N, 1000, true);
+
+      std::copy(counts.begin(), counts.end(), histogram.begin());
+   }
+   for(std::size_t index=0;index<N;index++)
+      sizes[index] = (std::int64_t)index + 1;
+
+   std::printf("   %zu bins\n", N);
+   double baseline = timeCall([&] {
+      for(std::size_t histogram=0;histogram<numHistograms;histogram++)
+         byRankInto(histograms[histogram].data(), N, &references[histogram], workspace);
+   });
+   reportRate("byRankInto, each", numHistograms, baseline, 0);
+   reportRate("byRankBatchEqual", numHistograms, timeCall([&] {
+      byRankBatchEqual(histograms[0].data(), N, numHistograms, references.data());
+   }), baseline);
+   reportRate("zipf::by_rank<N>", numHistograms, timeCall([&] {
+      for(std::size_t histogram=0;histogram<numHistograms;histogram++)
+         fits[histogram] = zipf::by_rank(histograms[histogram]);
+   }), baseline);
+   byRankBatchEqual(histograms[0].data(), N, numHistograms, references.data());
+   std::printf("   %-34s %.3g (largest difference)\n", "zipf::by_rank<N>", largestDifference(fits, references));
+
+   baseline = timeCall([&] {
+      for(std::size_t histogram=0;histogram<numHistograms;histogram++)
+         bySize64Into(sizes.data(), N, histograms[histogram].data(), N, &references[histogram]);
+   });
+   reportRate("bySize64Into, each", numHistograms, baseline, 0);
+   reportRate("zipf::by_size<N>", numHistograms, timeCall([&] {
+      for(std::size_t histogram=0;histogram<numHistograms;histogram++)
+         fits[histogram] = zipf::by_size(sizes, histograms[histogram]);
+   }), baseline);
+   std::printf("   %-34s %.3g (largest difference)\n", "zipf::by_size<N>", largestDifference(fits, references));
+
+   freeZipfWorkspace(workspace);
+}
+
+void benchFixed()
+{
+   setZipfThreads(1);
+   benchFixedSize<7>();
+   benchFixedSize<12>();
+   benchFixedSize<128>();
+   benchFixedSize<256>();
+}
+
+//*****************************************************************************
+// A benchmark case: its name, what it measures and the function that runs it.
+//*****************************************************************************
+struct BenchCase
+{
+   const char *name;
+   const char *about;
+   void (*run)();
+};
+
+const BenchCase benchCases[] =
+{
+   { "sort", "byRank()'s counting and radix sorts against std::sort()", benchSort },
+   { "fixed", "zipf.hpp's fits for compile-time sizes against zipf.c", benchFixed }
+};
+
+}
+
+int main(int argc, char **argv)
+{
+   for(int argument=1;argument<argc;argument++)
+   {
+      if(std::strcmp(argv[argument], "-n") == 0 && argument + 1 < argc)
+         maxValues = (std::size_t)std::strtod(argv[++argument], nullptr);
+      else if(std::strcmp(argv[argument], "-t") == 0 && argument + 1 < argc)
+         argument++;   // (no case of this driver is threaded)
+      else if(std::strcmp(argv[argument], "list") == 0)
+      {
+         for(const BenchCase &benchCase : benchCases)
+            std::printf("%-16s %s\n", benchCase.name, benchCase.about);
+         return 0;
+      }
+   }
+   if(maxValues < 1000)
+   {
+      std::fprintf(stderr, "Usage: %s [-n maxValues (at least 1000)] [case ...]\n", argv[0]);
+      return 1;
+   }
+
+   for(const BenchCase &benchCase : benchCases)
+   {
+      bool selected = true;
+
+      for(int argument=1;argument<argc;argument++)
+      {
+         if(argv[argument][0] == '-')
+            argument++;
+         else if((selected = std::strcmp(argv[argument], benchCase.name) == 0))
+            break;
+      }
+      if(!selected)
+         continue;
+
+      std::printf("%s: %s\n", benchCase.name, benchCase.about);
+      benchCase.run();
+      std::fflush(stdout);
+   }
+
+   return 0;
+}
@@ -0,0 +1,210 @@
+//*****************************************************************************
+// Checks the mergeable accumulator of zipf.c (ZipfAccumulator):
+//    - merging shards in any grouping and order gives, to the last bit,
+//      the state and fit of one accumulator over all the points,
+//    - removing points leaves no trace of them,
+//    - encodeZipfAccumulator() / decodeZipfAccumulator() round-trip, and
+//      decoding rejects buffers that are not a valid encoding,
+//    - the fit agrees with bySize() over the same points.
+//*****************************************************************************
+
+#include "../zipf.c"
+
+#define NUM_POINTS 100000
+#define NUM_SHARDS 8
+
+static int numFailures = 0;
+
+//*****************************************************************************
+// Reports one check.
+//*****************************************************************************
+static void check(const char *name, int passed)
+{
+   printf("%s %s\n", passed ? "ok    " : "FAILED", name);
+   if(!passed)
+      numFailures++;
+}
+
+//*****************************************************************************
+// Tells whether two accumulators have the same state, as their encodings.
+//*****************************************************************************
+static int sameState(const struct ZipfAccumulator *a, const struct ZipfAccumulator *b)
+{
+   unsigned char encodedA[ZIPF_ACCUMULATOR_ENCODED_SIZE], encodedB[ZIPF_ACCUMULATOR_ENCODED_SIZE];
+
+   encodeZipfAccumulator(a, encodedA);
+   encodeZipfAccumulator(b, encodedB);
+   return memcmp(encodedA, encodedB, sizeof(encodedA)) == 0;
+}
+
+//*****************************************************************************
+// Tells whether two accumulators give bitwise the same fit.
+//*****************************************************************************
+static int sameFit(const struct ZipfAccumulator *a, const struct ZipfAccumulator *b)
+{
+   struct ZipfValues fitA, fitB;
+
+   finalizeZipfAccumulatorInto(a, &fitA);
+   finalizeZipfAccumulatorInto(b, &fitB);
+   return memcmp(&fitA, &fitB, sizeof(struct ZipfValues)) == 0;
+}
+
+//*****************************************************************************
+// Tells whether two floats agree to the given relative tolerance.
+//*****************************************************************************
+static int agrees(double a, double b, double tolerance)
+{
+   return fabs(a - b) <= tolerance * (fabs(b) > 1.0 ? fabs(b) : 1.0);
+}
+
+int main(void)
+{
+   static int64_t sizes[NUM_POINTS];
+   static double counts[NUM_POINTS];
+   struct ZipfAccumulator *all = createZipfAccumulator();
+   struct ZipfAccumulator *shards[NUM_SHARDS], *pairs[NUM_SHARDS], *merged = createZipfAccumulator(), *other = createZipfAccumulator();
+   unsigned char encoded[ZIPF_ACCUMULATOR_ENCODED_SIZE], corrupt[ZIPF_ACCUMULATOR_ENCODED_SIZE];
+   int order[NUM_SHARDS];
+   struct ZipfValues fit, reference;
+   size_t i;
+   int shard, width, passed;
+
+   // Zipf-like points with noise: integer and fractional counts, spanning
+   // many magnitudes, so that the sums' lowest bits matter
+   srand(1);
+   for(i=0;i<NUM_POINTS;i++)
+   {
+      sizes[i] = (int64_t)(i + 1);
+      counts[i] = 1e9 / pow((double)(i + 1), 1.1) * (0.5 + (double)rand() / RAND_MAX);
+      if(i % 3 == 0)
+         counts[i] = floor(counts[i]) + 1.0;
+   }
+
+   for(shard=0;shard<NUM_SHARDS;shard++)
+      shards[shard] = createZipfAccumulator();
+   for(i=0;i<NUM_POINTS;i++)
+   {
+      addZipfPoint(all, sizes[i], counts[i]);
+      addZipfPoint(shards[rand() % NUM_SHARDS], sizes[i], counts[i]);
+   }
+
+   // merged left to right
+   clearZipfAccumulator(merged);
+   for(shard=0;shard<NUM_SHARDS;shard++)
+      mergeZipfAccumulator(merged, shards[shard]);
+   check("merged left to right: same state as one accumulator", sameState(merged, all));
+   check("merged left to right: same fit as one accumulator", sameFit(merged, all));
+
+   // merged right to left
+   clearZipfAccumulator(merged);
+   for(shard=NUM_SHARDS-1;shard>=0;shard--)
+      mergeZipfAccumulator(merged, shards[shard]);
+   check("merged right to left: same state", sameState(merged, all));
+
+   // merged pairwise, as a tree: ((0+1)+(2+3))+((4+5)+(6+7))
+   for(shard=0;shard<NUM_SHARDS;shard++)
+   {
+      pairs[shard] = createZipfAccumulator();
+      mergeZipfAccumulator(pairs[shard], shards[shard]);
+   }
+   for(width=1;width<NUM_SHARDS;width*=2)
+      for(shard=0;shard+width<NUM_SHARDS;shard+=2*width)
+         mergeZipfAccumulator(pairs[shard], pairs[shard + width]);
+   check("merged as a tree: same state and fit", sameState(pairs[0], all) && sameFit(pairs[0], all));
+   for(shard=0;shard<NUM_SHARDS;shard++)
+      freeZipfAccumulator(pairs[shard]);
+
+   // merged in random orders
+   for(passed=TRUE,i=0;i<100;i++)
+   {
+      for(shard=0;shard<NUM_SHARDS;shard++)
+         order[shard] = shard;
+      for(shard=NUM_SHARDS-1;shard>0;shard--)
+      {
+         int j = rand() % (shard + 1), swap = order[shard];
+
+         order[shard] = order[j];
+         order[j] = swap;
+      }
+      clearZipfAccumulator(merged);
+      for(shard=0;shard<NUM_SHARDS;shard++)
+         mergeZipfAccumulator(merged, shards[order[shard]]);
+      passed &= sameState(merged, all);
+   }
+   check("merged in 100 random orders: same state", passed);
+
+   // shipped: each shard encoded, decoded elsewhere and merged
+   clearZipfAccumulator(merged);
+   for(passed=TRUE,shard=0;shard<NUM_SHARDS;shard++)
+   {
+      encodeZipfAccumulator(shards[shard], encoded);
+      passed &= decodeZipfAccumulator(other, encoded, sizeof(encoded)) == 0;
+      mergeZipfAccumulator(merged, other);
+   }
+   check("shards decoded and merged: same state and fit", passed && sameState(merged, all) && sameFit(merged, all));
+
+   // removing points undoes adding them
+   mergeZipfAccumulator(merged, shards[0]);
+   for(i=0;i<NUM_POINTS;i++)
+      addZipfPoint(merged, sizes[i] + 7, counts[i] * 3.0);
+   for(i=0;i<NUM_POINTS;i++)
+      removeZipfPoint(merged, sizes[i] + 7, counts[i] * 3.0);
+   clearZipfAccumulator(other);
+   mergeZipfAccumulator(other, all);
+   mergeZipfAccumulator(other, shards[0]);
+   check("points added then removed: no trace left", sameState(merged, other));
+
+   // round trip, and the layout of the header
+   encodeZipfAccumulator(all, encoded);
+   clearZipfAccumulator(other);
+   passed = decodeZipfAccumulator(other, encoded, sizeof(encoded)) == 0;
+   check("decoded encoding: same state and fit", passed && sameState(other, all) && sameFit(other, all));
+   check("encoding: 272 bytes, magic and version 2",
+         ZIPF_ACCUMULATOR_ENCODED_SIZE == 272 && memcmp(encoded, "ZIPFACCU", 8) == 0 &&
+         encoded[8] == 2 && encoded[9] == 0 && encoded[10] == 0 && encoded[11] == 0);
+
+   // invalid encodings are rejected, leaving the accumulator as it was
+   clearZipfAccumulator(other);
+   addZipfPoint(other, 3, 5.0);
+   clearZipfAccumulator(merged);
+   addZipfPoint(merged, 3, 5.0);
+   fflush(stdout);
+   fprintf(stderr, "(the following three messages are expected)\n");
+   passed = decodeZipfAccumulator(other, encoded, sizeof(encoded) - 1) == -1;
+   memcpy(corrupt, encoded, sizeof(corrupt));
+   corrupt[0] ^= 1;
+   passed &= decodeZipfAccumulator(other, corrupt, sizeof(corrupt)) == -1;
+   memcpy(corrupt, encoded, sizeof(corrupt));
+   corrupt[8] = 1;
+   passed &= decodeZipfAccumulator(other, corrupt, sizeof(corrupt)) == -1;
+   check("invalid encodings rejected, accumulator unchanged", passed && sameState(other, merged));
+
+   // agreement with the single-node fit
+   finalizeZipfAccumulatorInto(all, &fit);
+   bySize64Into(sizes, NUM_POINTS, counts, NUM_POINTS, &reference);
+   check("fit agrees with bySize()", agrees(fit.slope, reference.slope, 1e-6) && agrees(fit.r2, reference.r2, 1e-6) &&
+                                     agrees(fit.yint, reference.yint, 1e-6));
+
+   // the all-equal special case survives merging
+   clearZipfAccumulator(merged);
+   for(shard=0;shard<NUM_SHARDS;shard++)
+   {
+      clearZipfAccumulator(shards[shard]);
+      for(i=0;i<100;i++)
+         addZipfPoint(shards[shard], (int64_t)(shard * 100 + i + 1), 42.0);
+      mergeZipfAccumulator(merged, shards[shard]);
+   }
+   check("equal counts merged: still uniform", isAccumulatorUniform(merged));
+   addZipfPoint(shards[3], 1000, 43.0);
+   mergeZipfAccumulator(merged, shards[3]);
+   check("one different count merged: no longer uniform", !isAccumulatorUniform(merged));
+
+   for(shard=0;shard<NUM_SHARDS;shard++)
+      freeZipfAccumulator(shards[shard]);
+   freeZipfAccumulator(other);
+   freeZipfAccumulator(merged);
+   freeZipfAccumulator(all);
+
+   printf("%s\n", numFailures == 0 ? "all passed" : "some FAILED");
+   return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,220 @@
+//*****************************************************************************
+// Checks that the reentrant (Into) and batch entry points of zipf.c make no
+// heap allocations once warmed up.
+//
+// Build (see the Makefile's test target):
+//    cc -O2 -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc tests/alloc_test.c -lm -lpthread
+//
+// The linker sends zipf.c's malloc(), calloc() and realloc() calls through
+// the counting wrappers below. Each case runs once to grow its workspace
+// (and the shared log tables), then again a few times with the counter
+// reset, and must not allocate then. The batch cases allocate on every
+// call: one workspace per thread, plus the sorting network of
+// byRankBatchEqual(). So each call may make up to numThreads + 1
+// allocations, but no more for many histograms than for a few.
+//*****************************************************************************
+
+#include "../zipf.c"
+
+#define REPEATS 5
+
+void *__real_malloc(size_t);
+void *__real_calloc(size_t, size_t);
+void *__real_realloc(void *, size_t);
+
+static size_t numAllocations = 0;
+static int numFailures = 0;
+
+void *__wrap_malloc(size_t size)
+{
+   __atomic_fetch_add(&numAllocations, 1, __ATOMIC_RELAXED);
+   return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+   __atomic_fetch_add(&numAllocations, 1, __ATOMIC_RELAXED);
+   return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size)
+{
+   __atomic_fetch_add(&numAllocations, 1, __ATOMIC_RELAXED);
+   return __real_realloc(pointer, size);
+}
+
+//*****************************************************************************
+// Reports one case: passed if count is at most expected.
+//*****************************************************************************
+static void check(const char *name, size_t count, size_t expected)
+{
+   if(count > expected)
+   {
+      printf("FAILED %-32s %zu allocations (expected at most %zu)\n", name, count, expected);
+      numFailures++;
+   }
+   else
+      printf("ok     %-32s %zu allocations\n", name, count);
+}
+
+//*****************************************************************************
+// Fills counts[] with a Zipf-like histogram of integer counts, shuffled.
+//*****************************************************************************
+static void fillCounts(double *counts, size_t numCounts, unsigned seed)
+{
+   size_t i;
+
+   srand(seed);
+   for(i=0;i<numCounts;i++)
+      counts[i] = floor(1e6 / (double)(i + 1)) + 1.0 + rand() % 3;
+   for(i=numCounts-1;i>0;i--)
+   {
+      size_t j = (size_t)rand() % (i + 1);
+      double swap = counts[i];
+
+      counts[i] = counts[j];
+      counts[j] = swap;
+   }
+}
+
+//*****************************************************************************
+// Runs the steady-state cases with the given number of threads.
+//*****************************************************************************
+static void runCases(int numThreads, size_t numCounts)
+{
+   struct ZipfWorkspace *workspace = createZipfWorkspace();
+   struct ZipfAccumulator *accumulator = createZipfAccumulator();
+   struct ZipfValues results;
+   double *counts = (double *)malloc(sizeof(double) * numCounts);
+   double *smallCounts = (double *)malloc(sizeof(double) * numCounts);
+   int *sizes = (int *)malloc(sizeof(int) * numCounts);
+   int64_t *sizes64 = (int64_t *)malloc(sizeof(int64_t) * numCounts);
+   int64_t types[64];
+   double runCounts[64];
+   struct ZipfIndex *index;
+   size_t i, before;
+   int repeat;
+   char name[64];
+
+   setZipfThreads(numThreads);
+   fillCounts(counts, numCounts, 1);
+   for(i=0;i<numCounts;i++)
+   {
+      smallCounts[i] = fmod(counts[i], 1000.0) + 1.0;   // for the counting sorts
+      sizes[i] = (int)(i + 1);
+      sizes64[i] = (int64_t)(i + 1);
+   }
+   for(i=0;i<64;i++)
+   {
+      runCounts[i] = (double)(i + 1);
+      types[i] = (int64_t)(1000 / (i + 1));
+   }
+   index = createZipfIndex(counts, numCounts);
+
+#define STEADY(label, call)                                       \
+   do                                                             \
+   {                                                              \
+      call;                                                       \
+      before = numAllocations;                                    \
+      for(repeat=0;repeat<REPEATS;repeat++)                       \
+         call;                                                    \
+      snprintf(name, sizeof(name), "%s (%d threads)", label, numThreads); \
+      check(name, numAllocations - before, 0);                    \
+   } while(0)
+
+   STEADY("byRankInto", byRankInto(counts, numCounts, &results, workspace));
+   STEADY("byRankInto, small counts", byRankInto(smallCounts, numCounts, &results, workspace));
+   STEADY("byRankRangeInto", byRankRangeInto(counts, numCounts, 10, numCounts / 2, &results, workspace));
+   STEADY("byRankGroupedInto", byRankGroupedInto(counts, numCounts, &results, workspace));
+   STEADY("byRankCountOfCountsInto", byRankCountOfCountsInto(runCounts, types, 64, &results, workspace));
+   STEADY("bySizeInto", bySizeInto(sizes, numCounts, counts, numCounts, &results));
+   STEADY("bySize64Into", bySize64Into(sizes64, numCounts, counts, numCounts, &results));
+   STEADY("getSlopeR2Into", getSlopeR2Into(sizes, numCounts, counts, numCounts, &results));
+   STEADY("getSlopeR2_64Into", getSlopeR2_64Into(sizes64, numCounts, counts, numCounts, &results));
+   STEADY("byRankIndexInto", byRankIndexInto(index, 10, numCounts / 2, &results));
+   STEADY("accumulator", { clearZipfAccumulator(accumulator);
+                           for(i=0;i<1000;i++)
+                              addZipfPoint(accumulator, sizes64[i], counts[i]);
+                           finalizeZipfAccumulatorInto(accumulator, &results); });
+
+#undef STEADY
+
+   freeZipfIndex(index);
+   freeZipfAccumulator(accumulator);
+   freeZipfWorkspace(workspace);
+   free(sizes64);
+   free(sizes);
+   free(smallCounts);
+   free(counts);
+}
+
+//*****************************************************************************
+// Checks that batches of a few and of numHistograms histograms of numBins
+// counts each make at most one allocation per thread, plus one shared.
+//*****************************************************************************
+static void runBatches(int numThreads, size_t numBins, size_t numHistograms)
+{
+   size_t numValues = numBins * numHistograms;
+   double *values = (double *)malloc(sizeof(double) * numValues);
+   size_t *offsets = (size_t *)malloc(sizeof(size_t) * (numHistograms + 1));
+   size_t *firstRanks = (size_t *)malloc(sizeof(size_t) * numHistograms);
+   size_t *lastRanks = (size_t *)malloc(sizeof(size_t) * numHistograms);
+   struct ZipfValues *results = (struct ZipfValues *)malloc(sizeof(struct ZipfValues) * numHistograms);
+   struct ZipfIndex *index;
+   size_t i, few = numThreads * ZIPF_BATCH_CHUNK, before, small, large, expected = numThreads + 1;
+   char name[64];
+
+   setZipfThreads(numThreads);
+   for(i=0;i<numHistograms;i++)
+      fillCounts(values + i * numBins, numBins, (unsigned)i + 2);
+   for(i=0;i<=numHistograms;i++)
+      offsets[i] = i * numBins;
+   for(i=0;i<numHistograms;i++)
+   {
+      firstRanks[i] = 1 + i % (numBins / 2);
+      lastRanks[i] = numBins - i % (numBins / 4);
+   }
+   index = createZipfIndex(values, numBins);
+
+#define BATCH(label, smallCall, largeCall)                             \
+   do                                                                  \
+   {                                                                   \
+      largeCall;                                                       \
+      before = numAllocations;                                         \
+      smallCall;                                                       \
+      small = numAllocations - before;                                 \
+      before = numAllocations;                                         \
+      largeCall;                                                       \
+      large = numAllocations - before;                                 \
+      snprintf(name, sizeof(name), "%s (%d threads)", label, numThreads); \
+      check(name, small > large ? small : large, expected);            \
+   } while(0)
+
+   BATCH("byRankBatch", byRankBatch(values, offsets, few, results),
+                        byRankBatch(values, offsets, numHistograms, results));
+   BATCH("byRankBatchEqual", byRankBatchEqual(values, numBins, few, results),
+                             byRankBatchEqual(values, numBins, numHistograms, results));
+   BATCH("byRankIndexBatch", byRankIndexBatch(index, firstRanks, lastRanks, few, results),
+                             byRankIndexBatch(index, firstRanks, lastRanks, numHistograms, results));
+
+#undef BATCH
+
+   freeZipfIndex(index);
+   free(results);
+   free(lastRanks);
+   free(firstRanks);
+   free(offsets);
+   free(values);
+}
+
+int main(void)
+{
+   runCases(1, 100000);
+   runCases(4, 1000000);
+   runBatches(1, 32, 10000);
+   runBatches(4, 32, 10000);
+   runBatches(4, 1000, 1000);
+
+   printf("%s\n", numFailures == 0 ? "all passed" : "some FAILED");
+   return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+//*****************************************************************************
+// Checks the type-generic C++20 fits of zipf.hpp (zipf::by_rank() and
+// zipf::by_size() over std::span) against byRankInto() and bySize64Into()
+// of zipf.c (compiled as C and linked in), on the same values as doubles:
+//    - by_rank on counts of every integer width, signed and unsigned, and
+//      of float and double, through both of its integer kernels: the tally
+//      (counts smaller than their number) and the sorted copy,
+//    - by_size on sizes and counts of signed, unsigned and floating-point
+//      types,
+//    - the special cases (a single count, all counts equal),
+//    - std::invalid_argument for empty, non-positive, NaN or mismatched
+//      input, which zipf.c would exit on.
+//*****************************************************************************
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "../zipf.hpp"
+
+extern "C"
+{
+struct ZipfValues
+{
+   float slope;
+   float r2;
+   float yint;
+};
+
+struct ZipfWorkspace;
+
+int byRankInto(double *, size_t, struct ZipfValues *, struct ZipfWorkspace *);
+int bySize64Into(int64_t *, size_t, double *, size_t, struct ZipfValues *);
+}
+
+namespace
+{
+
+int numFailures = 0;
+
+//*****************************************************************************
+// Reports one check.
+//*****************************************************************************
+void check(const char *name, bool passed)
+{
+   std::printf("%s %s\n", passed ? "ok    " : "FAILED", name);
+   if(!passed)
+      numFailures++;
+}
+
+//*****************************************************************************
+// Tells whether the fits agree up to the rounding of their sums.
+//*****************************************************************************
+bool agrees(const zipf::values &fit, const ZipfValues &reference)
+{
+   auto close = [](double a, double b) { return std::fabs(a - b) <= 1e-5 * (std::fabs(b) > 1.0 ? std::fabs(b) : 1.0); };
+
+   return close(fit.slope, reference.slope) && close(fit.r2, reference.r2) && close(fit.yint, reference.yint);
+}
+
+//*****************************************************************************
+// Zipf-like counts of n ranks, scale / rank with up to 10% noise (whole
+// numbers, at least 1, if T is an integer type), in random order.
+//*****************************************************************************
+template<typename T>
+std::vector<T> zipfCounts(std::size_t n, double scale)
+{
+   std::vector<T> counts(n);
+
+   for(std::size_t index=0;index<n;index++)
+   {
+      double count = scale / (double)((index * 7919) % n + 1) * (1.0 + 0.1 * std::rand() / RAND_MAX);
+
+      counts[index] = std::is_integral_v<T> ? (T)std::max(1.0, std::floor(count)) : (T)count;
+   }
+
+   return counts;
+}
+
+//*****************************************************************************
+// by_rank on n counts of type T against byRankInto() on them as doubles.
+//*****************************************************************************
+template<typename T>
+void checkByRank(const char *type, const char *kernel, std::size_t n, double scale)
+{
+   std::vector<T> counts = zipfCounts<T>(n, scale);
+   std::vector<double> doubles(counts.begin(), counts.end());
+   ZipfValues reference;
+   char name[128];
+
+   byRankInto(doubles.data(), n, &reference, NULL);
+   zipf::values fit = zipf::by_rank(std::span<const T>(counts));
+
+   std::snprintf(name, sizeof(name), "by_rank<%s>, %zu counts (%s): slope %g", type, n, kernel, fit.slope);
+   check(name, agrees(fit, reference));
+}
+
+//*****************************************************************************
+// by_size on n counts of type T (see zipfCounts()) at odd sizes of type S
+// (2 rank - 1, with each count's rank) against bySize64Into() on them as
+// int64_t and doubles.
+//*****************************************************************************
+template<typename S, typename T>
+void checkBySize(const char *types, std::size_t n, double scale)
+{
+   std::vector<T> counts = zipfCounts<T>(n, scale);
+   std::vector<S> sizes(n);
+   std::vector<std::int64_t> sizes64(n);
+   std::vector<double> doubles(counts.begin(), counts.end());
+   ZipfValues reference;
+   char name[128];
+
+   for(std::size_t index=0;index<n;index++)
+   {
+      sizes[index] = (S)(2 * ((index * 7919) % n) + 1);
+      sizes64[index] = (std::int64_t)(2 * ((index * 7919) % n) + 1);
+   }
+
+   bySize64Into(sizes64.data(), n, doubles.data(), n, &reference);
+   zipf::values fit = zipf::by_size(std::span<const S>(sizes), std::span<const T>(counts));
+
+   std::snprintf(name, sizeof(name), "by_size<%s>, %zu points: slope %g", types, n, fit.slope);
+   check(name, agrees(fit, reference));
+}
+
+//*****************************************************************************
+// Tells whether the call throws std::invalid_argument.
+//*****************************************************************************
+template<typename Call>
+bool throwsInvalid(Call call)
+{
+   try
+   {
+      call();
+   }
+   catch(const std::invalid_argument &)
+   {
+      return true;
+   }
+
+   return false;
+}
+
+} // namespace
+
+int main()
+{
+   std::srand(1);
+
+   // the tally (largest count below their number) and the sorted copy,
+   // past the 1024 ranks of the rank log table
+   checkByRank<std::uint8_t>("uint8_t", "tally", 3000, 200.0);
+   checkByRank<std::int16_t>("int16_t", "tally", 3000, 2000.0);
+   checkByRank<std::int16_t>("int16_t", "sorted", 3000, 20000.0);
+   checkByRank<std::uint16_t>("uint16_t", "sorted", 3000, 50000.0);
+   checkByRank<std::int32_t>("int32_t", "tally", 3000, 2000.0);
+   checkByRank<std::int32_t>("int32_t", "sorted", 3000, 1e8);
+   checkByRank<std::uint32_t>("uint32_t", "tally", 3000, 2000.0);
+   checkByRank<std::uint32_t>("uint32_t", "sorted", 3000, 3e9);
+   checkByRank<std::int64_t>("int64_t", "tally", 3000, 2000.0);
+   checkByRank<std::uint64_t>("uint64_t", "sorted", 3000, 1e15);
+   checkByRank<float>("float", "sorted", 3000, 1e6);
+   checkByRank<double>("double", "sorted", 3000, 1e6);
+   checkByRank<double>("double", "sorted", 12, 0.5);
+
+   checkBySize<std::int32_t, std::uint32_t>("int32_t, uint32_t", 3000, 1e4);
+   checkBySize<std::uint64_t, std::int64_t>("uint64_t, int64_t", 3000, 1e12);
+   checkBySize<std::uint16_t, double>("uint16_t, double", 3000, 1e4);
+   checkBySize<double, float>("double, float", 3000, 1e4);
+   checkBySize<float, std::uint8_t>("float, uint8_t", 100, 200.0);
+
+   // the special cases
+   std::vector<std::uint32_t> one = { 42 }, equal(500, 7);
+   zipf::values fit = zipf::by_rank(std::span<const std::uint32_t>(one));
+   check("by_rank of a single count: slope 0, r2 0", fit.slope == 0.0f && fit.r2 == 0.0f);
+   fit = zipf::by_rank(std::span<const std::uint32_t>(equal));
+   check("by_rank of equal counts (tally): slope 0, r2 1", fit.slope == 0.0f && fit.r2 == 1.0f);
+   std::vector<double> equalDoubles(500, 7.0);
+   fit = zipf::by_rank(std::span<const double>(equalDoubles));
+   check("by_rank of equal counts (sorted): slope 0, r2 1", fit.slope == 0.0f && fit.r2 == 1.0f);
+
+   // the errors
+   std::vector<std::uint32_t> empty, withZero = { 5, 0, 3 }, sizes = { 1, 2, 3 }, shortSizes = { 1, 2 };
+   std::vector<std::int32_t> withNegative = { 5, -1, 3 }, negativeSizes = { 1, -2, 3 };
+   std::vector<double> withNaN = { 5.0, std::numeric_limits<double>::quiet_NaN(), 3.0 }, counts = { 5.0, 4.0, 3.0 };
+   check("by_rank of no counts throws", throwsInvalid([&] { zipf::by_rank(std::span<const std::uint32_t>(empty)); }));
+   check("by_rank of a zero count throws", throwsInvalid([&] { zipf::by_rank(std::span<const std::uint32_t>(withZero)); }));
+   check("by_rank of a negative count throws", throwsInvalid([&] { zipf::by_rank(std::span<const std::int32_t>(withNegative)); }));
+   check("by_rank of a NaN count throws", throwsInvalid([&] { zipf::by_rank(std::span<const double>(withNaN)); }));
+   check("by_size of no counts throws", throwsInvalid([&] {
+      zipf::by_size(std::span<const std::uint32_t>(sizes), std::span<const std::uint32_t>(empty)); }));
+   check("by_size of no sizes throws", throwsInvalid([&] {
+      zipf::by_size(std::span<const std::uint32_t>(empty), std::span<const double>(counts)); }));
+   check("by_size of mismatched lengths throws", throwsInvalid([&] {
+      zipf::by_size(std::span<const std::uint32_t>(shortSizes), std::span<const double>(counts)); }));
+   check("by_size of a negative size throws", throwsInvalid([&] {
+      zipf::by_size(std::span<const std::int32_t>(negativeSizes), std::span<const double>(counts)); }));
+   check("by_size of a zero count throws", throwsInvalid([&] {
+      zipf::by_size(std::span<const std::uint32_t>(sizes), std::span<const std::uint32_t>(withZero)); }));
+   check("by_size of a NaN count throws", throwsInvalid([&] {
+      zipf::by_size(std::span<const std::uint32_t>(sizes), std::span<const double>(withNaN)); }));
+
+   std::printf("%s\n", numFailures == 0 ? "all passed" : "some FAILED");
+   return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,226 @@
+//*****************************************************************************
+// Fits a histogram of more than INT_MAX values from a mapped file (opt-in:
+// see the Makefile's test-large target, which needs about 8 bytes of disk
+// per value, 24 GB by default).
+//
+//    tests/large_test file [numValues]
+//
+// Writes a histogram file of numValues (default 3e9) uint32 counts,
+// sorted in ascending order, with int32 keys, then checks
+// byRankHistogram() and bySizeHistogram() on it against references
+// computed without the per-point passes:
+//    - the count of rank r is floor(C / r), so the counts form about
+//      2 sqrt(C) runs of equal counts, which byRankCountOfCounts() fits
+//      from a count-of-counts table,
+//    - the key of value i is i % KEY_PERIOD + 1, so bySize()'s sums over a
+//      run come from prefix sums over one period of keys (in long double).
+// The file is removed afterwards.
+//*****************************************************************************
+
+#include "../zipf.c"
+
+#define COUNT_SCALE 4294967295.0
+#define KEY_PERIOD  1000003
+#define WRITE_CHUNK (1 << 22)
+
+static int numFailures = 0;
+
+//*****************************************************************************
+// Reports one check of a fit against its reference.
+//*****************************************************************************
+static void check(const char *name, const struct ZipfValues *fit, const struct ZipfValues *reference)
+{
+   int passed = fabs(fit->slope - reference->slope) <= 1e-5 * fabs(reference->slope) &&
+                fabs(fit->r2 - reference->r2) <= 1e-5 &&
+                fabs(fit->yint - reference->yint) <= 1e-5 * fabs(reference->yint);
+
+   printf("%s %s: slope %.7g r2 %.7g yint %.7g (expected %.7g %.7g %.7g)\n", passed ? "ok    " : "FAILED", name,
+          fit->slope, fit->r2, fit->yint, reference->slope, reference->r2, reference->yint);
+   if(!passed)
+      numFailures++;
+}
+
+//*****************************************************************************
+// The count of value i (of n, in ascending order): that of rank n - i.
+//*****************************************************************************
+static uint32_t countAt(uint64_t i, uint64_t n)
+{
+   return (uint32_t)floor(COUNT_SCALE / (double)(n - i));
+}
+
+//*****************************************************************************
+// Writes the histogram file. Returns 0, or -1 (with a message).
+//*****************************************************************************
+static int writeHistogram(const char *path, uint64_t n)
+{
+   FILE *file = fopen(path, "wb");
+   unsigned char header[ZIPF_HISTOGRAM_HEADER_SIZE] = { 0 };
+   uint32_t *buffer = (uint32_t *)malloc(sizeof(uint32_t) * WRITE_CHUNK);
+   uint32_t version = ZIPF_HISTOGRAM_VERSION, countType = ZIPF_COUNT_UINT32, keyType = ZIPF_KEY_INT32;
+   uint32_t flags = ZIPF_HISTOGRAM_SORTED;
+   uint64_t i, j;
+   int ok;
+
+   if(file == NULL)
+   {
+      fprintf(stderr, "Could not create %s.\n", path);
+      return -1;
+   }
+
+   memcpy(header, ZIPF_HISTOGRAM_MAGIC, 8);
+   memcpy(header + 8,  &version,   4);
+   memcpy(header + 12, &countType, 4);
+   memcpy(header + 16, &keyType,   4);
+   memcpy(header + 20, &flags,     4);
+   memcpy(header + 24, &n,         8);
+   ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+
+   for(i=0;ok&&i<n;i+=j)
+   {
+      for(j=0;j<WRITE_CHUNK&&i+j<n;j++)
+         buffer[j] = countAt(i + j, n);
+      ok = fwrite(buffer, sizeof(uint32_t), j, file) == j;
+   }
+
+   // the keys start at the next multiple of 8 bytes
+   if(ok && (ZIPF_HISTOGRAM_HEADER_SIZE + 4 * n) % 8 != 0)
+      ok = fwrite(header + 20, 1, 4, file) == 4;
+
+   for(i=0;ok&&i<n;i+=j)
+   {
+      for(j=0;j<WRITE_CHUNK&&i+j<n;j++)
+         buffer[j] = (uint32_t)((i + j) % KEY_PERIOD + 1);
+      ok = fwrite(buffer, sizeof(uint32_t), j, file) == j;
+   }
+
+   free(buffer);
+   if(fclose(file) != 0 || !ok)
+   {
+      fprintf(stderr, "Could not write %s.\n", path);
+      return -1;
+   }
+
+   return 0;
+}
+
+//*****************************************************************************
+// Sums log10(key) and log10(key)^2 over the values first..last - 1, from
+// the prefix sums of one period of keys.
+//*****************************************************************************
+static void keySums(const long double *logPrefix, const long double *squarePrefix, uint64_t first, uint64_t last,
+                    long double *sumX, long double *sumX2)
+{
+   uint64_t periods = last / KEY_PERIOD - first / KEY_PERIOD;
+
+   *sumX = periods * logPrefix[KEY_PERIOD] + logPrefix[last % KEY_PERIOD] - logPrefix[first % KEY_PERIOD];
+   *sumX2 = periods * squarePrefix[KEY_PERIOD] + squarePrefix[last % KEY_PERIOD] - squarePrefix[first % KEY_PERIOD];
+}
+
+int main(int argc, char **argv)
+{
+   uint64_t n = argc > 2 ? strtoull(argv[2], NULL, 10) : 3000000000ULL;
+   long double *logPrefix = (long double *)malloc(sizeof(long double) * (KEY_PERIOD + 1));
+   long double *squarePrefix = (long double *)malloc(sizeof(long double) * (KEY_PERIOD + 1));
+   long double sumX = 0, sumY = 0, sumXY = 0, sumX2 = 0, sumY2 = 0, runX, runX2, logCount, slope, r2;
+   double *runCounts = NULL;
+   int64_t *runTypes = NULL;
+   size_t numRuns = 0, capacity = 0;
+   struct ZipfHistogram *histogram;
+   struct ZipfValues fit, threaded, reference;
+   uint64_t first, last;
+   int key;
+
+   if(argc < 2)
+   {
+      fprintf(stderr, "Usage: %s file [numValues]\n", argv[0]);
+      return 1;
+   }
+
+   printf("writing %llu values to %s\n", (unsigned long long)n, argv[1]);
+   fflush(stdout);
+   if(writeHistogram(argv[1], n) != 0)
+      return 1;
+
+   // the runs of equal counts, and the bySize() sums over each
+   logPrefix[0] = squarePrefix[0] = 0;
+   for(key=1;key<=KEY_PERIOD;key++)
+   {
+      long double x = log10l((long double)key);
+
+      logPrefix[key] = logPrefix[key - 1] + x;
+      squarePrefix[key] = squarePrefix[key - 1] + x * x;
+   }
+   for(first=0;first<n;first=last)
+   {
+      uint32_t count = countAt(first, n);
+      uint64_t low = first, high = n;
+
+      // the run ends at the first value with a larger count
+      while(low + 1 < high)
+      {
+         uint64_t middle = low + (high - low) / 2;
+
+         if(countAt(middle, n) == count)
+            low = middle;
+         else
+            high = middle;
+      }
+      last = high;
+
+      if(numRuns == capacity)
+      {
+         capacity = capacity ? 2 * capacity : 1024;
+         runCounts = (double *)realloc(runCounts, sizeof(double) * capacity);
+         runTypes = (int64_t *)realloc(runTypes, sizeof(int64_t) * capacity);
+      }
+      runCounts[numRuns] = count;
+      runTypes[numRuns++] = (int64_t)(last - first);
+
+      keySums(logPrefix, squarePrefix, first, last, &runX, &runX2);
+      logCount = log10l((long double)count);
+      sumX += runX;
+      sumX2 += runX2;
+      sumY += (last - first) * logCount;
+      sumY2 += (last - first) * logCount * logCount;
+      sumXY += runX * logCount;
+   }
+   printf("%zu runs of equal counts\n", numRuns);
+
+   histogram = openZipfHistogram(argv[1]);
+   if(histogram == NULL || histogram->numValues != n)
+   {
+      fprintf(stderr, "Could not read back %s.\n", argv[1]);
+      remove(argv[1]);
+      return 1;
+   }
+
+   byRankCountOfCountsInto(runCounts, runTypes, numRuns, &reference, NULL);
+   byRankHistogramInto(histogram, &fit, NULL);
+   check("byRankHistogram", &fit, &reference);
+
+   setZipfThreads(4);
+   byRankHistogramInto(histogram, &threaded, NULL);
+   printf("%s byRankHistogram on 4 threads: same bits\n",
+          memcmp(&fit, &threaded, sizeof(struct ZipfValues)) == 0 ? "ok    " : "FAILED");
+   if(memcmp(&fit, &threaded, sizeof(struct ZipfValues)) != 0)
+      numFailures++;
+   setZipfThreads(1);
+
+   slope = (n * sumXY - sumX * sumY) / (n * sumX2 - sumX * sumX);
+   r2 = (n * sumXY - sumX * sumY) / (sqrtl(n * sumX2 - sumX * sumX) * sqrtl(n * sumY2 - sumY * sumY));
+   reference.slope = (float)slope;
+   reference.r2 = (float)(r2 * r2);
+   reference.yint = (float)((sumY - slope * sumX) / n);
+   bySizeHistogramInto(histogram, &fit);
+   check("bySizeHistogram", &fit, &reference);
+
+   closeZipfHistogram(histogram);
+   remove(argv[1]);
+   free(runTypes);
+   free(runCounts);
+   free(squarePrefix);
+   free(logPrefix);
+
+   printf("%s\n", numFailures == 0 ? "all passed" : "some FAILED");
+   return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,225 @@
+//*****************************************************************************
+// Checks the discrete power-law fit of zipf.c (powerLawFit()) against a
+// naive O(n^2) reference: for every xmin candidate, alpha by bisection on
+// the likelihood equation (with zeta's derivative by finite differences),
+// and the KS distance by counting the tail at every distinct value. The
+// candidates are capped at 32, so that both the full scan and the sampled
+// one (every k-th candidate, then the best one's neighbours) are covered:
+//    - alpha, sigma, xmin, numTail and the KS distance agree,
+//    - the fit does not depend on the number of threads,
+//    - equal values (where the likelihood has no maximum) give HUGE_VAL.
+//*****************************************************************************
+
+#define ZIPF_POWER_LAW_CANDIDATES_MAX 32
+
+#include "../zipf.c"
+
+static int numFailures = 0;
+
+//*****************************************************************************
+// Reports one check.
+//*****************************************************************************
+static void check(const char *name, int passed)
+{
+   printf("%s %s\n", passed ? "ok    " : "FAILED", name);
+   if(!passed)
+      numFailures++;
+}
+
+//*****************************************************************************
+// Tells whether two doubles agree to the given relative tolerance.
+//*****************************************************************************
+static int agrees(double a, double b, double tolerance)
+{
+   return fabs(a - b) <= tolerance * (fabs(b) > 1.0 ? fabs(b) : 1.0);
+}
+
+//*****************************************************************************
+// Fills values with numTail draws of a discrete power law of exponent
+// alpha from xmin (rounded from the continuous one, as Clauset et al.
+// generate them), then numBody uniform draws below xmin.
+//*****************************************************************************
+static void fillPowerLaw(double *values, size_t numTail, size_t numBody, double alpha, double xmin)
+{
+   size_t i;
+
+   for(i=0;i<numTail;i++)
+   {
+      double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+      values[i] = floor((xmin - 0.5) * pow(u, -1.0 / (alpha - 1.0)) + 0.5);
+   }
+   for(i=0;i<numBody;i++)
+      values[numTail + i] = 1.0 + rand() % (int)(xmin - 1.0);
+}
+
+//*****************************************************************************
+// The reference fit of the tail values >= xmin: alpha by bisection on
+// d ln(zeta(alpha, xmin)) / d alpha = -mean(ln(x)), the KS distance at each
+// distinct value of the tail, and sigma from the second derivative.
+//*****************************************************************************
+static void referenceTail(const double *values, size_t numValues, double xmin, double *alpha, double *ks,
+                          double *sigma, size_t *numTail)
+{
+   double sumLogs = 0.0, low = 1.0 + 1e-9, high = 50.0, middle, h, slope, zetaMin, largest = 0.0;
+   size_t i, j, n = 0;
+
+   for(i=0;i<numValues;i++)
+      if(values[i] >= xmin)
+      {
+         sumLogs += log(values[i]);
+         n++;
+      }
+
+   while(high - low > 1e-13 * high)
+   {
+      middle = (low + high) / 2.0;
+      h = 1e-6 * middle;
+      slope = (log(hurwitzZeta(middle + h, xmin)) - log(hurwitzZeta(middle - h, xmin))) / (2.0 * h);
+      if(-slope > sumLogs / n)
+         low = middle;
+      else
+         high = middle;
+   }
+   *alpha = (low + high) / 2.0;
+
+   h = 1e-4 * *alpha;
+   *sigma = 1.0 / sqrt(n * (log(hurwitzZeta(*alpha + h, xmin)) - 2.0 * log(hurwitzZeta(*alpha, xmin)) +
+                            log(hurwitzZeta(*alpha - h, xmin))) / (h * h));
+
+   zetaMin = hurwitzZeta(*alpha, xmin);
+   for(i=0;i<numValues;i++)
+   {
+      double x = values[i], above = 0.0, difference;
+
+      if(x < xmin)
+         continue;
+      for(j=0;j<numValues;j++)
+         above += values[j] > x;
+      difference = fabs(above / n - hurwitzZeta(*alpha, x + 1.0) / zetaMin);
+      if(difference > largest)
+         largest = difference;
+   }
+   *ks = largest;
+   *numTail = n;
+}
+
+//*****************************************************************************
+// The reference fit: the distinct values leaving at least
+// ZIPF_POWER_LAW_TAIL_MIN values (and two distinct ones) in the tail are
+// the candidates; past ZIPF_POWER_LAW_CANDIDATES_MAX of them, every k-th
+// is tried, then those between the best one and its sampled neighbours.
+// Returns the number of candidates.
+//*****************************************************************************
+static size_t referenceFit(double *values, size_t numValues, struct ZipfPowerLaw *fit)
+{
+   double *distinct = (double *)malloc(sizeof(double) * numValues), alpha, ks, sigma;
+   size_t numDistinct = 0, numCandidates, stride, first, last, best, i, j, numTail;
+   int pass;
+
+   qsort(values, numValues, sizeof(double), compare);
+   for(i=0;i<numValues;i++)
+      if(i == 0 || values[i] != values[i - 1])
+         distinct[numDistinct++] = values[i];
+
+   for(numCandidates=1;numCandidates<numDistinct-1;numCandidates++)
+   {
+      size_t above = 0;
+
+      for(j=0;j<numValues;j++)
+         above += values[j] >= distinct[numCandidates];
+      if(above < ZIPF_POWER_LAW_TAIL_MIN)
+         break;
+   }
+
+   stride = numCandidates > ZIPF_POWER_LAW_CANDIDATES_MAX ? (numCandidates - 1) / ZIPF_POWER_LAW_CANDIDATES_MAX + 1 : 1;
+   first = 0;
+   last = numCandidates - 1;
+   best = 0;
+   for(pass=0;pass<(stride > 1 ? 2 : 1);pass++)
+   {
+      size_t step = pass == 0 ? stride : 1;
+
+      fit->ks = HUGE_VAL;
+      for(i=first;i<=last;i+=step)
+      {
+         referenceTail(values, numValues, distinct[i], &alpha, &ks, &sigma, &numTail);
+         if(ks < fit->ks)
+         {
+            best = i;
+            fit->alpha = alpha;
+            fit->ks = ks;
+            fit->sigma = sigma;
+            fit->numTail = numTail;
+         }
+      }
+      first = best >= stride ? best - stride + 1 : 0;
+      last = best + stride - 1 < numCandidates ? best + stride - 1 : numCandidates - 1;
+   }
+   fit->xmin = distinct[best];
+
+   free(distinct);
+   return numCandidates;
+}
+
+//*****************************************************************************
+// Fits the values with powerLawFit() on one and four threads and checks
+// both against the reference, and that the reference took the full or the
+// sampled scan as expected.
+//*****************************************************************************
+static void checkFit(const char *label, double *values, size_t numValues, int sampled)
+{
+   struct ZipfPowerLaw fit, threaded, reference = { 0, 0, 0, 0, 0 };
+   size_t numCandidates;
+   char name[128];
+
+   setZipfThreads(1);
+   powerLawFitInto(values, numValues, &fit);
+   setZipfThreads(4);
+   powerLawFitInto(values, numValues, &threaded);
+   setZipfThreads(1);
+   numCandidates = referenceFit(values, numValues, &reference);
+
+   snprintf(name, sizeof(name), "%s: %zu candidates, %s scan", label, numCandidates, sampled ? "sampled" : "full");
+   check(name, (numCandidates > ZIPF_POWER_LAW_CANDIDATES_MAX) == sampled);
+   snprintf(name, sizeof(name), "%s: xmin %g, %zu in the tail", label, fit.xmin, fit.numTail);
+   check(name, fit.xmin == reference.xmin && fit.numTail == reference.numTail);
+   snprintf(name, sizeof(name), "%s: alpha %.12g (reference %.12g)", label, fit.alpha, reference.alpha);
+   check(name, agrees(fit.alpha, reference.alpha, 1e-8));
+   snprintf(name, sizeof(name), "%s: sigma %.8g (reference %.8g)", label, fit.sigma, reference.sigma);
+   check(name, agrees(fit.sigma, reference.sigma, 1e-5));
+   snprintf(name, sizeof(name), "%s: KS distance %.12g (reference %.12g)", label, fit.ks, reference.ks);
+   check(name, fabs(fit.ks - reference.ks) <= 1e-9);
+   snprintf(name, sizeof(name), "%s: same fit on 4 threads", label);
+   check(name, memcmp(&fit, &threaded, sizeof(fit)) == 0);
+}
+
+int main(void)
+{
+   static double values[3000];
+   struct ZipfPowerLaw fit;
+   size_t i;
+
+   srand(1);
+
+   fillPowerLaw(values, 2000, 1000, 2.5, 6.0);
+   checkFit("alpha 2.5 from 6", values, 3000, TRUE);
+
+   fillPowerLaw(values, 300, 100, 3.0, 4.0);
+   checkFit("alpha 3 from 4", values, 400, FALSE);
+
+   // where the approximation of the MLE is furthest off
+   fillPowerLaw(values, 1000, 0, 3.5, 1.0);
+   checkFit("alpha 3.5 from 1", values, 1000, FALSE);
+
+   fillPowerLaw(values, 2500, 0, 1.7, 1.0);
+   checkFit("alpha 1.7 from 1", values, 2500, TRUE);
+
+   for(i=0;i<20;i++)
+      values[i] = 100.0;
+   powerLawFitInto(values, 20, &fit);
+   check("equal values: alpha and sigma HUGE_VAL, KS distance 0",
+         fit.alpha == HUGE_VAL && fit.sigma == HUGE_VAL && fit.ks == 0.0 && fit.xmin == 100.0 && fit.numTail == 20);
+
+   printf("%s\n", numFailures == 0 ? "all passed" : "some FAILED");
+   return numFailures == 0 ? 0 : 1;
+}
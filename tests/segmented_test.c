@@ -0,0 +1,182 @@
+//*****************************************************************************
+// Checks the two-regime fit of zipf.c (byRankSegmented()) against a
+// brute-force scan: every knee is fitted afresh, each regime's squared
+// residuals summed from its own least-squares line, and the two regimes
+// at the best knee are fitted by byRankRange():
+//    - the O(n) knee scan finds the knee of the brute-force one (or one
+//      whose total is equal to rounding),
+//    - head and tail agree with byRankRange() over ranks 1..knee and
+//      knee + 1..n,
+//    - byRankIndexSegmentedInto() on a prebuilt index gives, to the last
+//      bit, what byRankSegmentedInto() does, and so do several threads
+//      once there are more knees than ZIPF_CHUNK_SIZE (where the
+//      brute-force scan would be too slow, and is left out).
+//*****************************************************************************
+
+#include "../zipf.c"
+
+#define NUM_COUNTS  2000
+#define NUM_THREADED (ZIPF_CHUNK_SIZE * 3)
+
+static int numFailures = 0;
+
+//*****************************************************************************
+// Reports one check.
+//*****************************************************************************
+static void check(const char *name, int passed)
+{
+   printf("%s %s\n", passed ? "ok    " : "FAILED", name);
+   if(!passed)
+      numFailures++;
+}
+
+//*****************************************************************************
+// Tells whether two floats agree to the given relative tolerance.
+//*****************************************************************************
+static int agrees(double a, double b, double tolerance)
+{
+   return fabs(a - b) <= tolerance * (fabs(b) > 1.0 ? fabs(b) : 1.0);
+}
+
+//*****************************************************************************
+// Tells whether two zipf values agree to the given relative tolerance.
+//*****************************************************************************
+static int sameValues(const struct ZipfValues *a, const struct ZipfValues *b, double tolerance)
+{
+   return agrees(a->slope, b->slope, tolerance) && agrees(a->r2, b->r2, tolerance) &&
+          agrees(a->yint, b->yint, tolerance);
+}
+
+//*****************************************************************************
+// The squared residuals of the least-squares line through the points
+// (x[i], y[i]), first <= i <= last, by the two-pass textbook formulas.
+//*****************************************************************************
+static double naiveResiduals(const double *x, const double *y, size_t first, size_t last)
+{
+   double n = (double)(last - first + 1), meanX = 0.0, meanY = 0.0, sxx = 0.0, sxy = 0.0, error = 0.0, slope;
+   size_t i;
+
+   for(i=first;i<=last;i++)
+   {
+      meanX += x[i] / n;
+      meanY += y[i] / n;
+   }
+   for(i=first;i<=last;i++)
+   {
+      sxx += (x[i] - meanX) * (x[i] - meanX);
+      sxy += (x[i] - meanX) * (y[i] - meanY);
+   }
+   slope = sxy / sxx;
+   for(i=first;i<=last;i++)
+   {
+      double residual = y[i] - meanY - slope * (x[i] - meanX);
+      error += residual * residual;
+   }
+
+   return error;
+}
+
+//*****************************************************************************
+// Checks the index and thread variants of the segmented fit of the counts
+// against it, then (up to NUM_COUNTS counts) the fit against the
+// brute-force scan and against byRankRange().
+//*****************************************************************************
+static void checkSegmented(const char *label, double *counts, size_t numCounts)
+{
+   double *sorted, *x, *y, *errors;
+   struct ZipfSegmentedValues fit, indexed, threaded;
+   struct ZipfValues head, tail;
+   struct ZipfIndex *index;
+   size_t i, knee, best = ZIPF_SEGMENT_MIN;
+   char name[128];
+
+   setZipfThreads(1);
+   byRankSegmentedInto(counts, numCounts, &fit);
+   index = createZipfIndex(counts, numCounts);
+   byRankIndexSegmentedInto(index, &indexed);
+   setZipfThreads(4);
+   byRankSegmentedInto(counts, numCounts, &threaded);
+   setZipfThreads(1);
+
+   snprintf(name, sizeof(name), "%s: same fit from a prebuilt index", label);
+   check(name, memcmp(&fit, &indexed, sizeof(fit)) == 0);
+   snprintf(name, sizeof(name), "%s: same fit on 4 threads", label);
+   check(name, memcmp(&fit, &threaded, sizeof(fit)) == 0);
+   freeZipfIndex(index);
+   if(numCounts > NUM_COUNTS)
+      return;
+
+   // rank i + 1 is the (i + 1)-th largest count
+   sorted = (double *)malloc(sizeof(double) * numCounts);
+   x = (double *)malloc(sizeof(double) * numCounts);
+   y = (double *)malloc(sizeof(double) * numCounts);
+   errors = (double *)malloc(sizeof(double) * numCounts);
+   memcpy(sorted, counts, sizeof(double) * numCounts);
+   qsort(sorted, numCounts, sizeof(double), compare);
+   for(i=0;i<numCounts;i++)
+   {
+      x[i] = log10((double)(i + 1));
+      y[i] = log10(sorted[numCounts - 1 - i]);
+   }
+   for(knee=ZIPF_SEGMENT_MIN;knee<=numCounts-ZIPF_SEGMENT_MIN;knee++)
+   {
+      errors[knee] = naiveResiduals(x, y, 0, knee - 1) + naiveResiduals(x, y, knee, numCounts - 1);
+      if(errors[knee] < errors[best])
+         best = knee;
+   }
+
+   snprintf(name, sizeof(name), "%s: knee %zu (brute force %zu)", label, fit.kneeRank, best);
+   check(name, fit.kneeRank >= ZIPF_SEGMENT_MIN && fit.kneeRank <= numCounts - ZIPF_SEGMENT_MIN &&
+               agrees(errors[fit.kneeRank], errors[best], 1e-9));
+
+   byRankRangeInto(counts, numCounts, 1, fit.kneeRank, &head, NULL);
+   byRankRangeInto(counts, numCounts, fit.kneeRank + 1, numCounts, &tail, NULL);
+   snprintf(name, sizeof(name), "%s: head slope %g, tail slope %g as byRankRange()", label, fit.head.slope, fit.tail.slope);
+   check(name, sameValues(&fit.head, &head, 1e-5) && sameValues(&fit.tail, &tail, 1e-5));
+
+   free(sorted);
+   free(x);
+   free(y);
+   free(errors);
+}
+
+int main(void)
+{
+   static double counts[NUM_THREADED];
+   size_t i;
+
+   // exponent 0.7 up to rank 300, then 1.6, with 5% noise, shuffled
+   srand(1);
+   for(i=0;i<NUM_COUNTS;i++)
+   {
+      double rank = (double)(i + 1);
+      double count = rank <= 300 ? 1e6 * pow(rank, -0.7) : 1e6 * pow(300.0, 0.9) * pow(rank, -1.6);
+
+      counts[(i * 7919) % NUM_COUNTS] = count * (0.95 + 0.1 * rand() / RAND_MAX);
+   }
+   checkSegmented("knee at 300", counts, NUM_COUNTS);
+
+   // one regime: the knee only splits the noise
+   for(i=0;i<NUM_COUNTS;i++)
+      counts[i] = 1e5 / (i + 1.0) * (0.9 + 0.2 * rand() / RAND_MAX);
+   checkSegmented("no knee", counts, NUM_COUNTS);
+
+   // small integer counts, with long runs of ties and a flat tail of ones
+   for(i=0;i<NUM_COUNTS;i++)
+      counts[i] = floor(500.0 / (i + 1.0)) + 1.0;
+   checkSegmented("integral counts", counts, NUM_COUNTS);
+
+   // the fewest counts, with a single knee to try
+   for(i=0;i<2*ZIPF_SEGMENT_MIN;i++)
+      counts[i] = 100.0 / (i + 1.0) + (i % 2);
+   checkSegmented("the fewest counts", counts, 2 * ZIPF_SEGMENT_MIN);
+
+   // enough knees for several chunks of them
+   for(i=0;i<NUM_THREADED;i++)
+      counts[i] = (i < 5000 ? 1e8 * pow(i + 1.0, -0.8) : 1e8 * pow(5000.0, 0.4) * pow(i + 1.0, -1.2)) *
+                  (0.95 + 0.1 * rand() / RAND_MAX);
+   checkSegmented("more knees than a chunk", counts, NUM_THREADED);
+
+   printf("%s\n", numFailures == 0 ? "all passed" : "some FAILED");
+   return numFailures == 0 ? 0 : 1;
+}
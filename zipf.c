@@ -15,7 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 
-/* zipf.c       Version 1.5          24-Dec-2009
+/* zipf.c       Version 1.6          16-Oct-2026
  *                                                                
  * This module encapsulates functions that may be used to calculate
  * the slope and r2 (fit) of a trendline
@@ -28,8 +28,9 @@
  * The bySize distribution plots the values (y-axis)
  * against the supplised keys (x-axis) in log-log scale.
  * 
- * Usage: Call bySize(int *ranks, int numRanks, double *counts, int numCounts) and.or
- *             byRank(double *counts, int numCounts) functions.
+ * Usage: Call bySize(int *ranks, size_t numRanks, double *counts, size_t numCounts) and.or
+ *             byRank(double *counts, size_t numCounts) functions.
+ *        (or their allocation-free versions, bySizeInto() and byRankInto()).
  *
  * Output: slope and R2 
  * 
@@ -42,6 +43,82 @@
  *
  *          Thomas Zalonis - translate to C.
  *          
+ * version 1.6 (October 16, 2026)
+ *     - getSlopeR2() now stages its input in blocks and computes log10() and the regression sums
+ *       with AVX2 or AVX-512 kernels when the CPU supports them (runtime dispatch, scalar fallback).
+ *       The vectorized log10() differs from libm by a few ulps, so the sums agree with the scalar
+ *       path to about 1e-13 relative, far below the float precision of ZipfValues.
+ *       Compile with -DZIPF_NO_SIMD to force the scalar path.
+ *     - byRank(), bySize() and getSlopeR2() now read the data only once: validation, the all-equal
+ *       check (smallest count == largest count) and the regression sums share a single streaming pass.
+ *     - Added byRankInto(), bySizeInto() and getSlopeR2Into(), which store the results in a caller-owned
+ *       struct; byRankInto() takes its scratch memory from an optional, reusable ZipfWorkspace
+ *       (createZipfWorkspace() / freeZipfWorkspace()), so repeated calls make no heap allocations,
+ *       on any number of threads (tests/alloc_test.c checks this; run it with make test).
+ *       byRank() no longer leaks its sorted copy of the counts.
+ *     - byRank() no longer builds a rank array. getSlopeR2() takes ranks == NULL to mean the implicit
+ *       ranks n..1 of ascending counts, and reads their log10() from a shared, lazily grown table.
+ *     - With implicit ranks, sumX = log10(n!) comes from lgamma() and sumX2 from cached prefix sums
+ *       (continued by Euler-Maclaurin past the table), instead of being added up point by point.
+ *     - Added byRankGrouped(), which adds each run of tied counts to the regression sums at once
+ *       (one log10() per distinct count, rank log sums from lgamma() differences).
+ *     - Added byRankCountOfCounts(), which fits a histogram given as a count-of-counts table
+ *       (count value -> number of types) in O(distinct counts), without expanding it.
+ *     - byRank() and byRankGrouped() now sort with a counting sort (small integral counts) or an
+ *       LSD radix sort on the IEEE-754 bits (other positive counts) instead of comparisons.
+ *     - Added setZipfThreads(). Large byRank() sorts and getSlopeR2() passes are spread over that many
+ *       threads; the sums are reduced chunk by chunk in a fixed order, so the results are bitwise the
+ *       same for any number of threads.
+ *     - Lengths are now size_t and ranks internally 64-bit, so byRank(), bySize() and getSlopeR2()
+ *       accept more than 2^31 values. Added bySize64() and getSlopeR2_64() for 64-bit keys/ranks;
+ *       byRankCountOfCounts() now takes 64-bit numbers of types (tests/large_test.c fits 3e9 values
+ *       from a mapped histogram file; run it with make test-large).
+ *     - Added openZipfHistogram(), which maps a binary histogram file (little-endian header, then
+ *       uint32, uint64 or double counts and optional int32/int64 keys) read-only into memory, and
+ *       byRankHistogram() / bySizeHistogram(), which fit it straight from the mapping: integer counts
+ *       are converted block by block as they are summed, and only an unsorted byRank fit copies them.
+ *     - Added byRankCorpus(), which counts the tokens of a text file (mapped, or read in chunks) in an
+ *       open-addressing hash table (createZipfTokenTable(), countZipfTokens()) and fits their counts.
+ *       Tokens are runs of letters, digits and non-ASCII bytes, found 64 bytes at a time from bit masks.
+ *     - Large texts are counted by setZipfThreads() threads, each into a table of its own; the tables
+ *       are split into 64 shards by hash and merged shard by shard in parallel, without locks.
+ *     - Added ZipfAccumulator (createZipfAccumulator(), addZipfPoint(), removeZipfPoint(),
+ *       finalizeZipfAccumulator()), which updates a bySize fit in O(1) per point. Its sums are kept
+ *       exactly in fixed point, so removing points leaves no rounding behind.
+ *     - Added mergeZipfAccumulator(), encodeZipfAccumulator() and decodeZipfAccumulator(): fits sharded
+ *       over processes can ship their accumulators (a fixed 272-byte little-endian encoding) instead
+ *       of the raw points, and merge them into exactly the fit of all the points.
+ *     - Added byRankBatch(), which fits many histograms stored back to back (values plus offsets) into
+ *       an array of results, on setZipfThreads() threads with one workspace per thread.
+ *     - Short inputs of small integer counts are now sorted by a branch-free counting sort instead of
+ *       the quicksort, whose mispredicted branches dominated fitting small histograms.
+ *     - Added byRankBatchEqual() for batches of equal-sized histograms, which fits up to 256-bin
+ *       histograms 8 at a time, one per AVX2/AVX-512 lane, sorting them with a vectorized
+ *       odd-even merge sorting network.
+ *     - Added zipf.hpp, a header-only C++17 version of byRank() and bySize() for histograms whose
+ *       number of bins is known at compile time (zipf::by_rank<N>, zipf::by_size<N> on std::array).
+ *     - zipf.hpp also offers, with C++20, type-generic zipf::by_rank<T> and zipf::by_size<S, T> on
+ *       std::span, for integer or floating-point counts and sizes; integer counts are fitted from a
+ *       tally when small, and log'ed once per run of equal counts.
+ *     - Integer counts up to ZIPF_COUNT_LOG_TABLE_MAX (2^20) have their log10() looked up in the shared,
+ *       lazily grown table of log10() of the integers (the rank log table) instead of computed, with
+ *       AVX2/AVX-512 gathers; fractional or larger counts are still log'ed. So are explicit ranks and
+ *       bySize() keys up to the same bound.
+ *     - Added setZipfLogAccuracy(), an opt-in approximate log10() (polynomials of degree 9, 5 or 3,
+ *       with errors up to 7.1e-10, 1.3e-6 and 5.9e-5) for the per-point passes of the fits.
+ *     - Added byRankRange(), which fits only the ranks firstRank..lastRank, selecting that window of
+ *       the counts in O(n) on average and sorting only the window.
+ *     - Added ZipfIndex (createZipfIndex()), which sorts the counts once and keeps prefix sums of the
+ *       regression, so byRankIndex() fits any range of ranks in O(1); byRankIndexBatch() fits many.
+ *     - Added byRankSegmented(), a two-regime fit that tries every knee in O(1) on an index and
+ *       returns both regimes' zipf values and the knee rank.
+ *     - Added powerLawFit(), the discrete maximum-likelihood power-law exponent of Clauset, Shalizi
+ *       and Newman, with xmin chosen by KS distance over all candidates (alpha per candidate by
+ *       Newton's method on the Hurwitz zeta function, seeded from suffix sums, KS distances by
+ *       bisection of the tail, candidates spread over the threads).
+ *       A first pass over a sample of the candidates bounds the best distance, so most give up early;
+ *       past 2^18 candidates only a sample is tried (plus the neighbours of the best one).
+ *
  * version 1.5 (December 24, 2008)  J.R. Armstrong and Bill Manaris
  *     - Now we are differentiating between monotonous and random phenomena (vertical vs. horizontal trendlines).
  *       In the first case, we return slope = 0 and r2 = 0.
@@ -70,21 +147,196 @@
  * Libraries needed:
  * -----------------
  * stdlib for qsort
+ * pthread for the shared lookup tables
+ * POSIX.1-2008 for mmap() and the pthread barriers (the feature test macros
+ *    are defined below, so the file builds with -std=c99)
+ * immintrin (x86 with GCC or clang only) for the AVX2/AVX-512 kernels
  *
  */
 
+// POSIX (pthread barriers) and madvise(), which -std=c99 would hide
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <float.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <string.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#if !defined(ZIPF_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ZIPF_X86_SIMD 1
+#include <immintrin.h>
+#endif
 
 #define FALSE 0
 #define TRUE 1
 
+// largest rank whose log10() is kept in the shared rank log table
+// (4M ranks, i.e. 32 MB); larger ranks are log'ed as needed
+#ifndef ZIPF_RANK_LOG_TABLE_MAX
+#define ZIPF_RANK_LOG_TABLE_MAX (1 << 22)
+#endif
+
+// integer counts up to this have their log10() looked up in the same
+// table (see countLogBlock()); larger or fractional counts are log'ed
+// (at most ZIPF_RANK_LOG_TABLE_MAX, which is also the default when that
+// is set lower)
+#ifndef ZIPF_COUNT_LOG_TABLE_MAX
+#if ZIPF_RANK_LOG_TABLE_MAX < (1 << 20)
+#define ZIPF_COUNT_LOG_TABLE_MAX ZIPF_RANK_LOG_TABLE_MAX
+#else
+#define ZIPF_COUNT_LOG_TABLE_MAX (1 << 20)
+#endif
+#endif
+
+#if ZIPF_COUNT_LOG_TABLE_MAX > ZIPF_RANK_LOG_TABLE_MAX
+#error "ZIPF_COUNT_LOG_TABLE_MAX should be at most ZIPF_RANK_LOG_TABLE_MAX"
+#endif
+
+// runs of tied ranks at least this long get their rank log sums from
+// lgamma() rather than adding them up
+#define ZIPF_SHORT_RUN 16
+
+// inputs shorter than this are sorted by sortCounts() rather than by
+// the counting or radix sorts
+#define ZIPF_RADIX_SORT_MIN 1024
+
+// shorter inputs whose counts are all integers below this are sorted by
+// smallCountingSortCounts(), with the tally on the stack
+#define ZIPF_SMALL_COUNTING_MAX 4096
+
+// digit size and number of passes of radixSortCounts() (6 x 11 bits)
+#define ZIPF_RADIX_BITS   11
+#define ZIPF_RADIX_PASSES 6
+
+// most threads used by one call
+#define ZIPF_MAX_THREADS 256
+
+// getSlopeR2() sums the points in chunks of this many (each summed by one
+// thread), so the rounding never depends on the number of threads; its
+// threads take on this many chunks at a time, whose sums are kept on the
+// stack until they are merged
+#define ZIPF_CHUNK_SIZE (1 << 16)
+#define ZIPF_CHUNK_ROUND 256
+
+// inputs shorter than this are always sorted by one thread, and the
+// parallel counting sort is only used for counts below the second bound
+// (larger small integers are counted by one thread)
+#define ZIPF_PARALLEL_SORT_MIN (1 << 18)
+#define ZIPF_PARALLEL_COUNTING_MAX (1 << 16)
+
+// number of points staged (converted and log'ed) at a time by getSlopeR2();
+// small enough that a block of each staged array stays in L1 cache
+#define ZIPF_BLOCK_SIZE 256
+
+// binary histogram files (see openZipfHistogram()): header size, count
+// and key types, and flags
+#define ZIPF_HISTOGRAM_MAGIC       "ZIPFHIST"
+#define ZIPF_HISTOGRAM_VERSION     1
+#define ZIPF_HISTOGRAM_HEADER_SIZE 32
+
+#define ZIPF_COUNT_UINT32 1
+#define ZIPF_COUNT_UINT64 2
+#define ZIPF_COUNT_DOUBLE 3
+
+#define ZIPF_KEY_NONE  0
+#define ZIPF_KEY_INT32 1
+#define ZIPF_KEY_INT64 2
+
+#define ZIPF_HISTOGRAM_SORTED 1
+
+// number of shards of a token table (chosen by the top bits of the hash),
+// and initial number of slots, and of bytes of interned tokens, of each
+// shard; the slots are doubled when they get half full
+#define ZIPF_TOKEN_SHARD_BITS 6
+#define ZIPF_TOKEN_SHARDS (1 << ZIPF_TOKEN_SHARD_BITS)
+#define ZIPF_TOKEN_SLOTS  256
+#define ZIPF_TOKEN_BYTES  4096
+
+// texts shorter than this are always counted by one thread
+#define ZIPF_PARALLEL_TOKENS_MIN (1 << 22)
+
+// size of the reads of countZipfTokensFile() when it cannot map the file
+#define ZIPF_READ_SIZE (1 << 20)
+
+// bytes classified at a time, and tokens hashed and added at a time, by
+// countZipfTokens()
+#define ZIPF_TOKEN_SPAN  4096
+#define ZIPF_TOKEN_BATCH 64
+
+// byRankBatch() hands out histograms to its threads this many at a time
+#define ZIPF_BATCH_CHUNK 64
+
+// byRankIndexBatch() hands out rank ranges to its threads this many at a time
+#define ZIPF_INDEX_CHUNK 4096
+
+// each regime of a segmented fit (see byRankSegmented()) has at least this
+// many ranks
+#define ZIPF_SEGMENT_MIN 3
+
+// powerLawFit() tries as xmin every distinct value that leaves at least
+// this many values in the tail; past the second bound of such candidates,
+// it tries an evenly spaced sample of them, then those next to the best
+// one (see scanPowerLawCandidates())
+#define ZIPF_POWER_LAW_TAIL_MIN 10
+#ifndef ZIPF_POWER_LAW_CANDIDATES_MAX
+#define ZIPF_POWER_LAW_CANDIDATES_MAX (1 << 18)
+#endif
+
+// powerLawFit() hands out its candidates to its threads this many at a
+// time, after bounding the best distance with those spaced by 1/64th of
+// their position; its KS distances walk ranges of up to the last bound of
+// values, stepping the Hurwitz zeta function over gaps of up to as much;
+// from the given value on, they take it from its asymptotic expansion,
+// splitting ranges in as many parts and walking up to the leaf bound of
+// values at once (see powerLawDistance()); each alpha takes at most the
+// last bound of steps (see powerLawAlpha())
+#define ZIPF_POWER_LAW_CHUNK     64
+#define ZIPF_POWER_LAW_SAMPLE    64
+#define ZIPF_ZETA_STEPS_MAX      16
+#define ZIPF_ZETA_ASYMPTOTIC_MIN 100.0
+#define ZIPF_POWER_LAW_SPLIT     16
+#define ZIPF_POWER_LAW_LEAF      64
+#define ZIPF_POWER_LAW_STEPS_MAX 100
+
+// byRankBatchEqual() fits this many histograms at once, one per vector
+// lane, when they have at most ZIPF_LANE_BINS_MAX bins
+// (or ZIPF_LANE_BINS_SCALAR bins without AVX2, where the network's
+// min/max are not vector operations)
+#define ZIPF_LANES            8
+#define ZIPF_LANE_BINS_MAX    256
+#define ZIPF_LANE_BINS_SCALAR 8
+
+// fixed-point format of the exact sums of a ZipfAccumulator: words of two's
+// complement, little end first, whose lowest bit weighs 2^-ZIPF_EXACT_SCALE
+// (fine enough for the exact product of any two log10()s of doubles, and
+// wide enough for the sums of 2^64 points)
+#define ZIPF_EXACT_WORDS 5
+#define ZIPF_EXACT_SCALE 232
+
+// encoded accumulators (see encodeZipfAccumulator()): header and size
+#define ZIPF_ACCUMULATOR_MAGIC        "ZIPFACCU"
+#define ZIPF_ACCUMULATOR_VERSION      2
+#define ZIPF_ACCUMULATOR_ENCODED_SIZE (72 + 5 * 8 * ZIPF_EXACT_WORDS)
+
+// accuracy tiers of the per-point log10()s (see setZipfLogAccuracy()),
+// with the largest absolute error of each tier's log10()
+#define ZIPF_LOG_EXACT    0   // libm, or the vectorized log10() (a few ulps)
+#define ZIPF_LOG_FINE     1   // 7.1e-10
+#define ZIPF_LOG_FAST     2   // 1.3e-6
+#define ZIPF_LOG_FASTEST  3   // 5.9e-5
+
+#define ZIPF_LOG10_2 0.301029995663981195213738894724
+#define ZIPF_SQRT2   1.41421356237309504880168872421
+
 //*****************************************************************************
 // This struct is used to return multiple values from byRank()
 // ****************************************************************************
@@ -95,201 +347,5350 @@ struct ZipfValues
    float yint;
 };
 
+//*****************************************************************************
+// This struct is used to return the two regimes of byRankSegmented()
+// ****************************************************************************
+struct ZipfSegmentedValues
+{
+   struct ZipfValues head;       // ranks 1..kneeRank
+   struct ZipfValues tail;       // ranks kneeRank + 1..n
+   size_t            kneeRank;   // the last rank of the head
+};
+
+//*****************************************************************************
+// This struct is used to return the discrete power-law fit of powerLawFit()
+// ****************************************************************************
+struct ZipfPowerLaw
+{
+   double alpha;     // exponent of p(x) ~ x^-alpha, for x >= xmin
+   double sigma;     // standard error of alpha, 1 / sqrt(numTail var(ln x)) under the fit
+   double xmin;      // smallest value of the power-law tail
+   double ks;        // Kolmogorov-Smirnov distance between the tail and the fit
+   size_t numTail;   // number of values >= xmin
+};
+
+//*****************************************************************************
+// This struct holds the regression sums accumulated by getSlopeR2()
+// (X is log10 of the ranks, Y is log10 of the counts), along with the
+// ranges of the raw ranks and counts seen in the same pass.
+// ****************************************************************************
+struct ZipfSums
+{
+   double sumX;
+   double sumY;
+   double sumXY;
+   double sumX2;
+   double sumY2;
+
+   double minX;   // smallest rank (for validation)
+   double minY;   // smallest count (for validation)
+   double maxY;   // largest count (all counts are equal when minY == maxY)
+};
+
+//*****************************************************************************
+// This struct is the reusable scratch space of byRankInto(). It is one
+// arena, grown on demand and carved up by each call, so after the first
+// few calls no more heap allocations happen. A workspace may be shared by
+// consecutive calls, but not by calls running at the same time.
+// ****************************************************************************
+struct ZipfWorkspace
+{
+   char   *arena;      // the scratch memory
+   size_t  capacity;   // size of arena in bytes
+   size_t  used;       // bytes handed out by allocWorkspace() during the current call
+};
+
+//*****************************************************************************
+// This struct describes a run of types sharing the same count
+// (one row of a count-of-counts table).
+// ****************************************************************************
+struct ZipfRun
+{
+   double  count;    // the count shared by the run
+   int64_t length;   // number of types in the run
+};
+
+//*****************************************************************************
+// This struct describes a binary histogram file mapped into memory by
+// openZipfHistogram(); counts and keys point straight into the mapping.
+// ****************************************************************************
+struct ZipfHistogram
+{
+   void        *map;         // the whole file, mapped read-only
+   size_t       mapSize;     // size of the mapping in bytes
+   size_t       numValues;   // number of counts (and keys)
+   int          countType;   // ZIPF_COUNT_UINT32, ZIPF_COUNT_UINT64 or ZIPF_COUNT_DOUBLE
+   int          keyType;     // ZIPF_KEY_NONE, ZIPF_KEY_INT32 or ZIPF_KEY_INT64
+   int          flags;       // ZIPF_HISTOGRAM_SORTED, or 0
+   const void  *counts;
+   const void  *keys;        // NULL if the file has no keys
+};
+
+//*****************************************************************************
+// These structs hold the token counts of a text corpus (see
+// countZipfTokens()). A token table is split into ZIPF_TOKEN_SHARDS shards
+// by the top bits of the tokens' hashes, so that threads can merge their
+// tables shard by shard. Each shard is an open-addressing hash table
+// (linear probing), whose slots hold short tokens whole and refer to
+// longer ones, which are interned in one growing arena.
+// ****************************************************************************
+struct ZipfToken
+{
+   uint32_t hash;     // low half of the hash of the token's bytes
+   uint32_t length;   // number of bytes in the token
+   uint64_t count;    // number of occurrences (0 for an empty slot)
+   uint64_t prefix;   // the first 8 bytes of the token, zero-padded
+   size_t   offset;   // start of the token's bytes in the table's arena (longer tokens)
+};
+
+struct ZipfTokenShard
+{
+   struct ZipfToken *slots;
+   size_t            numSlots;         // a power of two
+   size_t            numTypes;         // distinct tokens (used slots)
+   char             *strings;          // the interned bytes of the tokens longer than 8 bytes
+   size_t            stringsUsed;
+   size_t            stringsCapacity;
+};
+
+struct ZipfTokenTable
+{
+   struct ZipfTokenShard shards[ZIPF_TOKEN_SHARDS];
+};
+
+//*****************************************************************************
+// These structs hold the running state of an incremental bySize fit (see
+// addZipfPoint()). The regression sums are kept exactly, in fixed point,
+// so points can be removed again without leaving rounding behind, and the
+// fit does not depend on the order of the updates. Whether all counts are
+// equal is tracked from the exact sums of the counts' IEEE-754 bits and of
+// their squares: the points are uniform exactly when n times the sum of
+// the squares equals the square of the sum (see isAccumulatorUniform()).
+// ****************************************************************************
+struct ZipfExactSum
+{
+   uint64_t words[ZIPF_EXACT_WORDS];
+};
+
+struct ZipfAccumulator
+{
+   struct ZipfExactSum  sumX;
+   struct ZipfExactSum  sumY;
+   struct ZipfExactSum  sumXY;
+   struct ZipfExactSum  sumX2;
+   struct ZipfExactSum  sumY2;
+   uint64_t             numPoints;
+   unsigned __int128    countBits;         // sum of the counts' bits
+   uint64_t             countSquares[3];   // sum of their squares (192 bits, lowest word first)
+};
+
+//*****************************************************************************
+// These structs hold a histogram's counts sorted by rank, and the prefix
+// sums of the regression over ranks 1..r (see createZipfIndex()). Each
+// sum is kept with the rounding errors made adding it up, so that the
+// difference of two prefix sums is as accurate as summing the range anew.
+// ****************************************************************************
+struct ZipfIndexEntry
+{
+   double sums[5];     // sumX, sumY, sumXY, sumX2, sumY2 over ranks 1..r
+   double errors[5];   // the rounding errors of sums
+};
+
+struct ZipfIndex
+{
+   double                 *counts;      // counts[r - 1] has rank r (largest first)
+   struct ZipfIndexEntry  *prefix;      // prefix[r], r = 0..numCounts
+   size_t                  numCounts;
+};
+
+//*****************************************************************************
+// This struct holds the shared table of log10() of the ranks
+// (see getRankLogTable()), which also serves integer counts.
+// ****************************************************************************
+struct RankLogTable
+{
+   double *logs;           // logs[r] = log10(r)
+   double *squarePrefix;   // squarePrefix[r] = logs[1]^2 + ... + logs[r]^2
+   size_t  size;           // number of entries, including the unused [0]
+};
+
+static struct RankLogTable *rankLogTable = NULL;
+static pthread_mutex_t rankLogTableLock = PTHREAD_MUTEX_INITIALIZER;
+
+//*****************************************************************************
+// These structs hold the work shared by the threads of runParallel():
+// what each thread runs, accumulateSums()'s chunks and
+// parallelSortCounts()'s tallies.
+// ****************************************************************************
+struct ParallelStart
+{
+   void (*run)(void *, int, int);
+   void  *argument;
+   int    thread;
+   int    numThreads;
+};
+
+struct SumsTask
+{
+   int              *ranks;       // 32-bit ranks, or NULL
+   int64_t          *ranks64;     // 64-bit ranks, or NULL (both NULL for implicit ranks)
+   const double     *counts;      // double counts, or NULL
+   const uint32_t   *counts32;    // 32-bit integer counts, or NULL
+   const uint64_t   *counts64;    // 64-bit integer counts, or NULL
+   size_t            numPoints;
+   const double     *rankLogs;    // rank log table, or NULL
+   struct ZipfSums  *partials;    // the sums of each chunk of the current round
+   size_t            nextChunk;   // next chunk to be claimed by a thread
+   size_t            firstChunk;  // the current round of chunks
+   size_t            lastChunk;
+};
+
+struct SortTask
+{
+   double            *counts;
+   double            *buffer;     // numCounts doubles of scratch
+   size_t             numCounts;
+   int64_t            maxCount;   // counting sort up to maxCount, or -1 for the radix sort
+   size_t             numDigits;  // size of each thread's tally
+   size_t            *tallies;    // numThreads tallies of numDigits entries
+   pthread_barrier_t  barrier;
+};
+
+struct BatchTask
+{
+   const double       *values;          // the counts of all histograms, back to back
+   const size_t       *offsets;         // numHistograms + 1 offsets into values
+   size_t              numHistograms;
+   struct ZipfValues  *results;         // one per histogram
+   size_t              nextChunk;       // next chunk of ZIPF_BATCH_CHUNK histograms to be claimed
+};
+
+struct LaneTask
+{
+   const double       *values;           // the counts of all histograms, back to back
+   size_t              numBins;          // number of counts in every histogram
+   size_t              numHistograms;
+   struct ZipfValues  *results;          // one per histogram
+   const uint16_t     *comparators;      // the sorting network, as pairs of bins
+   int                 numComparators;
+   size_t              nextChunk;        // next chunk of ZIPF_BATCH_CHUNK histograms to be claimed
+};
+
+struct IndexTask
+{
+   const struct ZipfIndex  *index;
+   const size_t            *firstRanks;
+   const size_t            *lastRanks;
+   size_t                   numRanges;
+   struct ZipfValues       *results;      // one per range
+   size_t                   nextChunk;    // next chunk of ZIPF_INDEX_CHUNK ranges to be claimed
+};
+
+struct SegmentTask
+{
+   const struct ZipfIndex  *index;
+   double                  *bestErrors;   // the smallest squared error of each chunk of knees
+   size_t                  *bestKnees;    // and its knee
+   size_t                   nextChunk;    // next chunk of ZIPF_CHUNK_SIZE knees to be claimed
+};
+
+struct PowerLawTask
+{
+   const double  *values;          // the distinct values, ascending
+   const double  *logs;            // their ln()
+   const double  *tailCounts;      // tailCounts[j]: number of values >= values[j] (numDistinct + 1 entries)
+   const double  *tailLogs;        // tailLogs[j]: sum of ln() of the same values
+   size_t         numDistinct;
+   size_t         firstCandidate;  // xmin = values[firstCandidate + i * stride], i < numCandidates
+   size_t         stride;
+   size_t         numCandidates;
+   double        *alphas;          // the fit of each candidate
+   double        *distances;       // and its KS distance
+   double         cutoff;          // candidates give up past this distance
+   size_t         nextChunk;       // next chunk of ZIPF_POWER_LAW_CHUNK candidates to be claimed
+};
+
+struct PowerLawTail
+{
+   const struct PowerLawTask  *task;
+   double                      numTail;   // number of values in the tail
+   double                      alpha;
+   double                      zetaMin;   // zeta(alpha, xmin)
+   double                      zetaTerms[3];   // the corrections of tailZeta()
+   double                      largest;   // largest CDF difference found so far
+   size_t                      largestIndex;   // and the distinct value it is at
+   double                      cutoff;    // where to give up on it
+};
+
+struct TokenTask
+{
+   const char              *text;
+   size_t                  *bounds;   // numThreads + 1 chunk boundaries, on separators
+   struct ZipfTokenTable  **tables;   // each thread's own table
+   struct ZipfTokenTable   *table;    // the table the counts are merged into
+   int                      numTables;
+};
+
+static int zipfThreads = 1;
+static int zipfLogAccuracy = ZIPF_LOG_EXACT;
+
+// log10(1 + t) = t * (c[0] + c[1] t + ... + c[degree] t^degree) on
+// sqrt(1/2) - 1 <= t < sqrt(2) - 1, for each approximate tier
+// (interpolated at the Chebyshev nodes, so close to minimax)
+static const int zipfLogDegrees[3] = { 9, 5, 3 };
+static const double zipfLogCoefficients[3][10] =
+{
+   { 0.43429448163540274, -0.21714719099100979, 0.14476487948797137, -0.10858047841629218, 0.086862976318128948,
+     -0.07212923189989108, 0.061668296829162229, -0.057613642169943559, 0.055618402412283614, -0.032360090582533294 },
+   { 0.43429610720168604, -0.2171015542160083, 0.1444719933009502, -0.11045566324034492, 0.095395859905579569,
+     -0.060895136183201734 },
+   { 0.43417768617506952, -0.21815639190751168, 0.15358045769035128, -0.097119378135721995 }
+};
+
+// B(2j) / (2j)!, j = 1..6, for the Euler-Maclaurin formula of hurwitzZeta()
+// and powerLawLogMean()
+static const double zetaBernoulli[6] = { 1.0 / 12.0, -1.0 / 720.0, 1.0 / 30240.0, -1.0 / 1209600.0,
+                                         1.0 / 47900160.0, -691.0 / 1307674368000.0 };
+
 
 // zipf related 
-struct ZipfValues *getSlopeR2(int *, int, double *, int);
-int checkRanksAndCounts(int *, int, double *, int);
-struct ZipfValues *bySize(int *, int, double *, int);
+struct ZipfValues *getSlopeR2(int *, size_t, double *, size_t);
+struct ZipfValues *getSlopeR2_64(int64_t *, size_t, double *, size_t);
+int checkRanksAndCounts(int *, size_t, double *, size_t);
+int checkNumRanksAndCounts(size_t, size_t);
+int checkSums(struct ZipfSums *);
+void clearSums(struct ZipfSums *);
+void accumulateSums(struct SumsTask *, struct ZipfSums *);
+void sumsThread(void *, int, int);
+void accumulateChunk(struct SumsTask *, size_t, struct ZipfSums *);
+void mergeSums(struct ZipfSums *, const struct ZipfSums *);
+void finishSlopeR2(size_t, struct ZipfSums *, struct ZipfValues *);
+const struct RankLogTable *getRankLogTable(size_t);
+void rankLogSums(size_t, double *, double *);
+double rankRangeLogSum(const struct RankLogTable *, int64_t, int64_t);
+void accumulateRun(const struct RankLogTable *, double, int64_t, int64_t, struct ZipfSums *);
+struct ZipfValues *bySize(int *, size_t, double *, size_t);
+struct ZipfValues *bySize64(int64_t *, size_t, double *, size_t);
 int compare(const void *, const void *);
-struct ZipfValues *byRank(double *, int);
+double *sortedCopy(double *, size_t, struct ZipfWorkspace *);
+void sortCopiedCounts(double *, size_t, double *, double, double, int, struct ZipfWorkspace *);
+size_t sortTallyBytes(size_t);
+void countingSortCounts(double *, size_t, int64_t, size_t *);
+void smallCountingSortCounts(double *, size_t, int64_t, double *);
+void radixSortCounts(double *, size_t, double *);
+void parallelSortCounts(double *, size_t, double *, size_t *, int64_t, int);
+void sortThread(void *, int, int);
+void sortCounts(double *, size_t);
+void heapSortCounts(double *, size_t);
+void selectCounts(double *, size_t, size_t);
+struct ZipfValues *byRank(double *, size_t);
+int byRankInto(double *, size_t, struct ZipfValues *, struct ZipfWorkspace *);
+struct ZipfValues *byRankRange(double *, size_t, size_t, size_t);
+int byRankRangeInto(double *, size_t, size_t, size_t, struct ZipfValues *, struct ZipfWorkspace *);
+struct ZipfValues *byRankGrouped(double *, size_t);
+int byRankGroupedInto(double *, size_t, struct ZipfValues *, struct ZipfWorkspace *);
+struct ZipfValues *byRankCountOfCounts(double *, int64_t *, size_t);
+int byRankCountOfCountsInto(double *, int64_t *, size_t, struct ZipfValues *, struct ZipfWorkspace *);
+int compareRuns(const void *, const void *);
+int byRankBatch(const double *, const size_t *, size_t, struct ZipfValues *);
+void batchThread(void *, int, int);
+int byRankBatchEqual(const double *, size_t, size_t, struct ZipfValues *);
+void laneThread(void *, int, int);
+void fitLanes(const struct LaneTask *, size_t);
+int sortingNetwork(int, uint16_t *);
+int bySizeInto(int *, size_t, double *, size_t, struct ZipfValues *);
+int bySize64Into(int64_t *, size_t, double *, size_t, struct ZipfValues *);
+int getSlopeR2Into(int *, size_t, double *, size_t, struct ZipfValues *);
+int getSlopeR2_64Into(int64_t *, size_t, double *, size_t, struct ZipfValues *);
+int fitSlopeR2(struct SumsTask *, struct ZipfValues *);
+struct ZipfHistogram *openZipfHistogram(const char *);
+void closeZipfHistogram(struct ZipfHistogram *);
+struct ZipfValues *byRankHistogram(const struct ZipfHistogram *);
+int byRankHistogramInto(const struct ZipfHistogram *, struct ZipfValues *, struct ZipfWorkspace *);
+struct ZipfValues *bySizeHistogram(const struct ZipfHistogram *);
+int bySizeHistogramInto(const struct ZipfHistogram *, struct ZipfValues *);
+void setTaskCounts(struct SumsTask *, const struct ZipfHistogram *);
+double *sortedHistogramCopy(const struct ZipfHistogram *, struct ZipfWorkspace *);
+struct ZipfAccumulator *createZipfAccumulator(void);
+void freeZipfAccumulator(struct ZipfAccumulator *);
+void clearZipfAccumulator(struct ZipfAccumulator *);
+void addZipfPoint(struct ZipfAccumulator *, int64_t, double);
+void removeZipfPoint(struct ZipfAccumulator *, int64_t, double);
+void updateZipfAccumulator(struct ZipfAccumulator *, int64_t, double, int);
+struct ZipfValues *finalizeZipfAccumulator(const struct ZipfAccumulator *);
+int finalizeZipfAccumulatorInto(const struct ZipfAccumulator *, struct ZipfValues *);
+int isAccumulatorUniform(const struct ZipfAccumulator *);
+static inline void addCountWords(uint64_t *, const uint64_t *, int, int);
+static inline void multiplyCountWords(const uint64_t *, int, const uint64_t *, int, uint64_t *);
+void mergeZipfAccumulator(struct ZipfAccumulator *, const struct ZipfAccumulator *);
+void encodeZipfAccumulator(const struct ZipfAccumulator *, unsigned char *);
+int decodeZipfAccumulator(struct ZipfAccumulator *, const unsigned char *, size_t);
+static inline void storeLittle32(unsigned char *, uint32_t);
+static inline void storeLittle64(unsigned char *, uint64_t);
+static inline uint32_t loadLittle32(const unsigned char *);
+static inline uint64_t loadLittle64(const unsigned char *);
+void addExactSum(struct ZipfExactSum *, double);
+void addExactWords(struct ZipfExactSum *, const uint64_t *);
+double exactSumValue(const struct ZipfExactSum *);
+struct ZipfIndex *createZipfIndex(double *, size_t);
+void freeZipfIndex(struct ZipfIndex *);
+struct ZipfValues *byRankIndex(const struct ZipfIndex *, size_t, size_t);
+int byRankIndexInto(const struct ZipfIndex *, size_t, size_t, struct ZipfValues *);
+int byRankIndexBatch(const struct ZipfIndex *, const size_t *, const size_t *, size_t, struct ZipfValues *);
+void indexThread(void *, int, int);
+void indexRangeSums(const struct ZipfIndex *, size_t, size_t, struct ZipfSums *);
+struct ZipfSegmentedValues *byRankSegmented(double *, size_t);
+int byRankSegmentedInto(double *, size_t, struct ZipfSegmentedValues *);
+int byRankIndexSegmentedInto(const struct ZipfIndex *, struct ZipfSegmentedValues *);
+void segmentThread(void *, int, int);
+void scanKnees(const struct ZipfIndex *, size_t, size_t, double *, size_t *);
+double residualSquares(size_t, const struct ZipfSums *);
+struct ZipfPowerLaw *powerLawFit(double *, size_t);
+int powerLawFitInto(double *, size_t, struct ZipfPowerLaw *);
+size_t scanPowerLawCandidates(struct PowerLawTask *, size_t, size_t, size_t, double *, double *);
+void powerLawThread(void *, int, int);
+void fitPowerLawTail(const struct PowerLawTask *, size_t, double, double *, double *, size_t *);
+void powerLawDistance(struct PowerLawTail *, size_t, double, size_t, double);
+void tailDifference(struct PowerLawTail *, size_t, double);
+double tailZeta(const struct PowerLawTail *, size_t);
+double asymptoticZeta(const struct PowerLawTail *, double, double);
+double powerLawAlpha(double, double, double);
+double powerLawLogMean(double, double, double *);
+static inline void addZetaTerm(double *, double, double, double, double, double);
+double hurwitzZeta(double, double);
+void checkRankRange(size_t, size_t, size_t);
+struct ZipfValues *byRankCorpus(const char *);
+struct ZipfValues *byRankTokens(const struct ZipfTokenTable *);
+int byRankTokensInto(const struct ZipfTokenTable *, struct ZipfValues *, struct ZipfWorkspace *);
+struct ZipfTokenTable *createZipfTokenTable(void);
+void freeZipfTokenTable(struct ZipfTokenTable *);
+int countZipfTokensFile(struct ZipfTokenTable *, const char *);
+void countZipfTokens(struct ZipfTokenTable *, const char *, size_t);
+void countTokenRange(struct ZipfTokenTable *, const char *, size_t);
+void countTokensThread(void *, int, int);
+void mergeTokensThread(void *, int, int);
+size_t getZipfTokenTypes(const struct ZipfTokenTable *);
+void createZipfTokenShard(struct ZipfTokenShard *);
+static inline int scanCounts(const double *, size_t, double *, double *, double *);
+static inline int isTokenByte(unsigned char);
+static inline uint64_t loadTokenWord(const unsigned char *, size_t, const unsigned char *);
+static inline uint64_t hashToken(const unsigned char *, size_t, uint64_t, const unsigned char *);
+void addTokenBatch(struct ZipfTokenTable *, const unsigned char **, const size_t *, int, const unsigned char *);
+void addZipfToken(struct ZipfTokenShard *, const char *, size_t, uint64_t, uint64_t, uint64_t);
+void growZipfTokenShard(struct ZipfTokenShard *);
+struct ZipfWorkspace *createZipfWorkspace(void);
+void freeZipfWorkspace(struct ZipfWorkspace *);
+void reserveWorkspace(struct ZipfWorkspace *, size_t);
+void *allocWorkspace(struct ZipfWorkspace *, size_t);
+void setZipfThreads(int);
+int getZipfThreads(void);
+void setZipfLogAccuracy(int);
+int getZipfLogAccuracy(void);
+void runParallel(int, void (*)(void *, int, int), void *);
+void *parallelStart(void *);
+void log10Block(const double *, double *, int);
+void approxLog10Block(const double *, double *, int, int);
+void expBlock(const double *, double *, int);
+int countLogBlock(const double *, double *, int, double, double);
+void rangeBlock(const double *, int, double *, double *);
+void accumulateLogBlock(const double *, const double *, int, struct ZipfSums *);
+void sortLanes(double *, const uint16_t *, int);
+void accumulateLanes(const double *, const double *, int, double (*)[ZIPF_LANES]);
+void tokenMaskBlock(const unsigned char *, size_t, uint64_t *);
 
 
 //*****************************************************************************
 // The byRank distribution plots the values (y-axis)
 // against the ranks of the values from largest to smallest 
 // (x-axis) in log-log scale. The ranks are generated automatically.
+//
+// The returned struct is malloc'ed and must be freed by the caller
+// (see byRankInto() for a version that does not allocate).
 //*****************************************************************************
-struct ZipfValues *byRank(double *counts, int numCounts)
+struct ZipfValues *byRank(double *counts, size_t numCounts)
 {
-   double *newCounts = (double *)malloc(sizeof(double) * numCounts);
-   int *newRanks = (int *)malloc(sizeof(int) * numCounts);
-
-   int index;
-   for(index=0;index<numCounts;index++)
-   {
-      newCounts[index] = counts[index];
-      newRanks[index]  = numCounts - index;
-   }
-  
-   qsort((void *)newCounts, numCounts, sizeof(double), compare);
+   struct ZipfValues *results = (struct ZipfValues *)malloc(sizeof(struct ZipfValues));
 
-   checkRanksAndCounts(newRanks, numCounts, newCounts, numCounts);
+   byRankInto(counts, numCounts, results, NULL);
 
-   return getSlopeR2(newRanks, numCounts, newCounts, numCounts);
+   return results;
 }
 
 //*****************************************************************************
-// 'Double' comparison function needed for sorting. This function
-// is passed in as a parameter to qsort() in the byRank() function.
+// Reentrant version of byRank(). The zipf values are stored in the
+// caller's results struct, and the sorted copy of the counts lives in
+// the given workspace, which is grown as needed and can be reused by the
+// next call. With a NULL workspace, a temporary one is used and freed.
 //*****************************************************************************
-int compare(const void *a, const void *b)
+int byRankInto(double *counts, size_t numCounts, struct ZipfValues *results, struct ZipfWorkspace *workspace)
 {
-   double d = *( (double *) a)  - *( (double *) b );
-   
-   if(d > 0.0) 
-   {
-      return 1;
-   } 
-   else if (d < 0.0) 
-   {
-      return -1;
-   } 
-   else 
-   {
-      return 0;
-   }
+   struct ZipfWorkspace temporary = { NULL, 0, 0 };
+   struct ZipfWorkspace *scratch = workspace != NULL ? workspace : &temporary;
+
+   checkNumRanksAndCounts(numCounts, numCounts);
+
+   double *newCounts = sortedCopy(counts, numCounts, scratch);
+
+   // the ranks (numCounts for the smallest count down to 1 for the largest)
+   // are implicit, so no rank array is built or read
+   getSlopeR2Into(NULL, numCounts, newCounts, numCounts, results);
+
+   free(temporary.arena);
+
+   return 0;
 }
 
 //*****************************************************************************
-// The bySize distribution plots the values (y-axis)
-// against the supplised keys (x-axis) in log-log scale.
+// Same as byRank(), over the ranks firstRank..lastRank only (1 being the
+// largest count), e.g. to fit the head of a large vocabulary without its
+// noisy tail. Only that window of the counts is sorted: the counts are
+// partitioned around the two bounding ranks by selectCounts(), in
+// O(numCounts) on average, and the lastRank - firstRank + 1 counts in
+// between are then sorted.
+//
+// The returned struct is malloc'ed and must be freed by the caller
+// (see byRankRangeInto() for a version that does not allocate).
 //*****************************************************************************
-struct ZipfValues *bySize(int *sizes, int numSizes, double *counts, int numCounts)
+struct ZipfValues *byRankRange(double *counts, size_t numCounts, size_t firstRank, size_t lastRank)
 {
-   checkRanksAndCounts(sizes, numSizes, counts, numCounts);
-   return getSlopeR2(sizes, numSizes, counts, numCounts);
+   struct ZipfValues *results = (struct ZipfValues *)malloc(sizeof(struct ZipfValues));
+
+   byRankRangeInto(counts, numCounts, firstRank, lastRank, results, NULL);
+
+   return results;
 }
 
 //*****************************************************************************
-// Supporting function for bySize() and byRank(). Checks the passed values
-// for correctness.
+// Reentrant version of byRankRange() (see byRankInto()).
 //*****************************************************************************
-int checkRanksAndCounts(int *ranks, int numRanks, double *counts, int numCounts)
+int byRankRangeInto(double *counts, size_t numCounts, size_t firstRank, size_t lastRank,
+                    struct ZipfValues *results, struct ZipfWorkspace *workspace)
 {
-   if(numCounts == 0)
+   struct ZipfWorkspace temporary = { NULL, 0, 0 };
+   struct ZipfWorkspace *scratch = workspace != NULL ? workspace : &temporary;
+
+   checkNumRanksAndCounts(numCounts, numCounts);
+
+   checkRankRange(firstRank, lastRank, numCounts);
+
+   size_t numRanks = lastRank - firstRank + 1;
+   reserveWorkspace(scratch, sizeof(double) * (numCounts + numRanks) + sortTallyBytes(numRanks));
+   double *newCounts = (double *)allocWorkspace(scratch, sizeof(double) * numCounts);
+   double *buffer = (double *)allocWorkspace(scratch, sizeof(double) * numRanks);
+
+   size_t index;
+   int positive = TRUE;
+   for(index=0;index<numCounts;index++)
    {
-      fprintf(stderr, "Counts should contain at least one element.\n");
-      exit(0);
+      newCounts[index] = counts[index];
+      positive &= counts[index] > 0.0;   // false for NaNs too
    }
 
-   if(numRanks == 0)
+   if(!positive)
    {
-      fprintf(stderr, "Ranks should contain at least one element.\n");
+      fprintf(stderr, "Counts and values should be strictly positive.\n");
       exit(0);
    }
 
-   if(numRanks != numCounts)
+   // in ascending order, rank r is at index numCounts - r: bring the
+   // window's smallest count to numCounts - lastRank (the larger ones
+   // after it), then its largest to numCounts - firstRank (the window
+   // before it), and sort the window
+   double *window = newCounts + (numCounts - lastRank);
+   selectCounts(newCounts, numCounts, numCounts - lastRank);
+   selectCounts(window, lastRank, numRanks - 1);
+
+   double min, max;
+   int integral = scanCounts(window, numRanks, NULL, &min, &max);
+   sortCopiedCounts(window, numRanks, buffer, min, max, integral, scratch);
+
+   // the run starting at index holds ranks lastRank - index down to
+   // lastRank - end + 1; the rank-only sums are added up over the window
+   const struct RankLogTable *table = getRankLogTable(lastRank < ZIPF_RANK_LOG_TABLE_MAX ? lastRank : ZIPF_RANK_LOG_TABLE_MAX);
+   struct ZipfSums sums;
+   size_t end, rank;
+
+   clearSums(&sums);
+   sums.minX = (double)firstRank;
+   for(index=0;index<numRanks;index=end)
    {
-      fprintf(stderr, "Ranks (%d) and counts (%d) should have the same size.\n", numRanks, numCounts);
-      exit(0);
+      for(end=index+1;end<numRanks && window[end] == window[index];end++)
+         ;
+
+      accumulateRun(table, window[index], lastRank - end + 1, lastRank - index, &sums);
    }
+   checkSums(&sums);
 
-   int i;
-   for(i=0;i<numRanks;i++)
+   for(rank=firstRank;rank<=lastRank;rank++)
    {
-      if(ranks[i] <= 0.0)
-      {
-         fprintf(stderr, "Ranks should be strictly positive.\n");
-         exit(0);
-      }
-
-      if(counts[i] <= 0.0)
-      {
-         fprintf(stderr, "Counts and values should be strictly positive.\n");
-         exit(0);
-      }
+      double x = rank < table->size ? table->logs[rank] : log10((double)rank);
+      sums.sumX  += x;
+      sums.sumX2 += x * x;
    }
 
+   finishSlopeR2(numRanks, &sums, results);
+
+   free(temporary.arena);
+
    return 0;
 }
 
 //*****************************************************************************
-// Supporting function for byRank() and bySize(). The actual zipf values 
-// (slope, R2 and yint) are calculated in this function and returned
-// as a struct.
+// Fits many histograms with byRank() in one call. The histograms are
+// stored back to back (CSR layout): histogram i has the counts
+// values[offsets[i]] .. values[offsets[i+1] - 1], so offsets has
+// numHistograms + 1 entries, and its zipf values go to results[i].
+//
+// The histograms are spread over getZipfThreads() threads, started once
+// for the whole batch, and each thread sorts into one workspace of its
+// own, so after the first few histograms nothing more is allocated. This
+// is meant for many small histograms, where the per-call setup of
+// byRank() would cost as much as the fit itself.
 //*****************************************************************************
-struct ZipfValues *getSlopeR2(int *ranks, int numRanks, double *counts, int numCounts)
+int byRankBatch(const double *values, const size_t *offsets, size_t numHistograms, struct ZipfValues *results)
 {
-   struct ZipfValues *results = (struct ZipfValues *)malloc(sizeof(struct ZipfValues));
-   double sumX, sumY, sumXY, sumX2, sumY2,slope, r2, yint;
-   int index;
-
-   sumX = sumY = sumXY = sumX2 = sumY2 = 0.0;
+   struct BatchTask task = { values, offsets, numHistograms, results, 0 };
+   size_t numChunks = (numHistograms + ZIPF_BATCH_CHUNK - 1) / ZIPF_BATCH_CHUNK;
+   int numThreads = (size_t)getZipfThreads() < numChunks ? getZipfThreads() : (int)numChunks;
 
-   // one exterme case:
-   // if the phenomenon is monotonous (only one type of event, e.g., ['a', 'a', 'a']),
-   // then the slope is negative infinity (cannot draw a line with only one data point),
-   // so indicate this with slope = 0 AND r2 = 0
-   if(numRanks == 1)
-   {
-      slope = 0.0;
-      r2 = 0.0;
-   }
+   if(numThreads <= 1)
+      batchThread(&task, 0, 1);
    else
-   {
-      //the other extreme case:
-      //if the phenomenon is uniformly distributed (several types of events,
-      //but all having the same number of instances, e.g., ['a', 'b', 'a', 'b', 'a', 'b']),
-      //then the slope = 0 and r2 = 1 (a horizontal line).
+      runParallel(numThreads, batchThread, &task);
 
-      //check if all counts are equal
+   return 0;
+}
 
-      int allCountsEqual = 1;
-      for(index=0;(index < numRanks - 1) && allCountsEqual;index++)
-      {
-         if(counts[index] != counts[index + 1])
-            allCountsEqual = 0;
-      }
+//*****************************************************************************
+// Supporting function for byRankBatch(), run by each thread: takes the
+// next unclaimed chunk of histograms until there are none left.
+//*****************************************************************************
+void batchThread(void *argument, int thread, int numThreads)
+{
+   struct BatchTask *task = (struct BatchTask *)argument;
+   struct ZipfWorkspace workspace = { NULL, 0, 0 };
+   size_t numChunks = (task->numHistograms + ZIPF_BATCH_CHUNK - 1) / ZIPF_BATCH_CHUNK;
+   size_t chunk, histogram, last;
 
-      if(allCountsEqual)
-      {
-         slope = 0.0;
-         r2 = 1.0;
-      }
-      else // general case, so calculate actual slope and r2 values
-      {
-         double tmp1,tmp2;
-         for(index=0;index<numRanks;index++)
-         {
-            // only calculating the follow log()s once for efficiency
-            tmp1 = log10(ranks[index]);
-            tmp2 = log10(counts[index]);
-
-            sumX  += tmp1;
-            sumY  += tmp2;
-            sumXY += tmp1 * tmp2;
-            sumX2 += pow(tmp1, 2);
-            sumY2 += pow(tmp2, 2);
-         }
+   (void)thread;
+   (void)numThreads;
 
-         // calculate slope
-         if((numRanks*sumX2 - sumX*sumX) == 0.0)
-            slope = 0.0;
-         else
-            slope = ((numRanks*sumXY - sumX*sumY) / (numRanks*sumX2 - sumX*sumX));
+   while((chunk = __atomic_fetch_add(&task->nextChunk, 1, __ATOMIC_RELAXED)) < numChunks)
+   {
+      histogram = chunk * ZIPF_BATCH_CHUNK;
+      last = task->numHistograms - histogram < ZIPF_BATCH_CHUNK ? task->numHistograms : histogram + ZIPF_BATCH_CHUNK;
 
-         // calculate r2   
-         if(sqrt((numRanks*sumX2 - sumX*sumX) * (numRanks*sumY2 - sumY*sumY)) == 0.0)
-         {
-            r2 = 0.0;
-         }
-         else
-         {
-            r2 = (numRanks*sumXY - sumX*sumY)/(sqrt(numRanks*sumX2 - sumX*sumX)*sqrt(numRanks*sumY2 - sumY*sumY));
-            r2 = r2 * r2;
-         }
-      }
+      // byRankInto() only reads the counts
+      for(;histogram<last;histogram++)
+         byRankInto((double *)task->values + task->offsets[histogram],
+                    task->offsets[histogram + 1] - task->offsets[histogram],
+                    &task->results[histogram], &workspace);
    }
 
-   // calculate y-intercept
-   yint = (sumY - slope * sumX) / numRanks;
-
-   // packing slope, r2 and yint into a ZipfValues struct
-   // so that all three can be returned at once.
-   results->slope = slope;
-   results->r2    = r2;
-   results->yint  = yint;
-
-   return results;
+   free(workspace.arena);
 }
 
+//*****************************************************************************
+// Same as byRankBatch(), for histograms that all have numBins counts:
+// histogram i has the counts values[i * numBins] .. values[(i+1) * numBins - 1].
+//
+// Histograms of up to ZIPF_LANE_BINS_MAX bins (ZIPF_LANE_BINS_SCALAR
+// without AVX2) are fitted ZIPF_LANES at a time, one per SIMD lane: the group is transposed so that each bin is a
+// vector across the histograms, sorted by a sorting network of vector
+// min/max operations (the same for every group, so built once), log'ed
+// and summed a vector at a time. The results agree with byRank() up to
+// the rounding of the sums; any other histograms go through byRankInto().
+//*****************************************************************************
+int byRankBatchEqual(const double *values, size_t numBins, size_t numHistograms, struct ZipfValues *results)
+{
+   uint16_t *comparators = NULL;
+   struct LaneTask task = { values, numBins, numHistograms, results, NULL, 0, 0 };
+   size_t numChunks = (numHistograms + ZIPF_BATCH_CHUNK - 1) / ZIPF_BATCH_CHUNK;
+   int numThreads = (size_t)getZipfThreads() < numChunks ? getZipfThreads() : (int)numChunks;
+   size_t maxBins = ZIPF_LANE_BINS_SCALAR;
+
+   if(numHistograms == 0)
+      return 0;
+
+   checkNumRanksAndCounts(numBins, numBins);
+
+#ifdef ZIPF_X86_SIMD
+   __builtin_cpu_init();
+   if(__builtin_cpu_supports("avx2"))
+      maxBins = ZIPF_LANE_BINS_MAX;
+#endif
+
+   if(numBins <= maxBins)
+   {
+      comparators = (uint16_t *)malloc(2 * sizeof(uint16_t) * sortingNetwork((int)numBins, NULL));
+      task.comparators = comparators;
+      task.numComparators = sortingNetwork((int)numBins, comparators);
+   }
+
+   if(numThreads <= 1)
+      laneThread(&task, 0, 1);
+   else
+      runParallel(numThreads, laneThread, &task);
+
+   free(comparators);
+
+   return 0;
+}
+
+//*****************************************************************************
+// Supporting function for byRankBatchEqual(), run by each thread: takes
+// the next unclaimed chunk of histograms until there are none left, and
+// fits it a group of ZIPF_LANES histograms at a time.
+//*****************************************************************************
+void laneThread(void *argument, int thread, int numThreads)
+{
+   struct LaneTask *task = (struct LaneTask *)argument;
+   struct ZipfWorkspace workspace = { NULL, 0, 0 };
+   size_t numChunks = (task->numHistograms + ZIPF_BATCH_CHUNK - 1) / ZIPF_BATCH_CHUNK;
+   size_t chunk, histogram, last;
+
+   (void)thread;
+   (void)numThreads;
+
+   while((chunk = __atomic_fetch_add(&task->nextChunk, 1, __ATOMIC_RELAXED)) < numChunks)
+   {
+      histogram = chunk * ZIPF_BATCH_CHUNK;
+      last = task->numHistograms - histogram < ZIPF_BATCH_CHUNK ? task->numHistograms : histogram + ZIPF_BATCH_CHUNK;
+
+      if(task->comparators != NULL)
+         for(;histogram+ZIPF_LANES<=last;histogram+=ZIPF_LANES)
+            fitLanes(task, histogram);
+
+      // byRankInto() only reads the counts
+      for(;histogram<last;histogram++)
+         byRankInto((double *)task->values + histogram * task->numBins, task->numBins,
+                    &task->results[histogram], &workspace);
+   }
+
+   free(workspace.arena);
+}
+
+//*****************************************************************************
+// Supporting function for laneThread(). Fits the ZIPF_LANES histograms
+// starting at the given one, each in one lane of the vectors: the counts
+// are transposed into bins x lanes blocks, sorted down the bins, and
+// their logs summed. The implicit rank sums (sumX, sumX2) are shared by
+// all lanes, and the smallest and largest count of each lane are its
+// first and last sorted bins.
+//*****************************************************************************
+void fitLanes(const struct LaneTask *task, size_t histogram)
+{
+   double block[ZIPF_LANE_BINS_MAX * ZIPF_LANES], logs[ZIPF_LANE_BINS_MAX * ZIPF_LANES];
+   double laneSums[3][ZIPF_LANES];
+   int numBins = (int)task->numBins;
+   const double *counts = task->values + histogram * task->numBins;
+   const struct RankLogTable *table = getRankLogTable(numBins);
+   struct ZipfSums sums;
+   double sumX, sumX2, minCount, maxCount;
+   int bin, lane, positive = TRUE;
+
+   for(lane=0;lane<ZIPF_LANES;lane++)
+      for(bin=0;bin<numBins;bin++)
+      {
+         double count = counts[lane * numBins + bin];
+         block[bin * ZIPF_LANES + lane] = count;
+         positive &= count > 0.0;   // false for NaNs too
+      }
+
+   if(!positive)
+   {
+      fprintf(stderr, "Counts and values should be strictly positive.\n");
+      exit(0);
+   }
+
+   sortLanes(block, task->comparators, task->numComparators);
+
+   // the lanes' smallest and largest counts are their first and last bins
+   minCount = block[0];
+   maxCount = block[(numBins - 1) * ZIPF_LANES];
+   for(lane=1;lane<ZIPF_LANES;lane++)
+   {
+      if(block[lane] < minCount) minCount = block[lane];
+      if(block[(numBins - 1) * ZIPF_LANES + lane] > maxCount) maxCount = block[(numBins - 1) * ZIPF_LANES + lane];
+   }
+
+   if(!countLogBlock(block, logs, numBins * ZIPF_LANES, minCount, maxCount))
+      log10Block(block, logs, numBins * ZIPF_LANES);
+   accumulateLanes(logs, table->logs, numBins, laneSums);
+   rankLogSums(numBins, &sumX, &sumX2);
+
+   for(lane=0;lane<ZIPF_LANES;lane++)
+   {
+      sums.sumX  = sumX;
+      sums.sumY  = laneSums[0][lane];
+      sums.sumXY = laneSums[1][lane];
+      sums.sumX2 = sumX2;
+      sums.sumY2 = laneSums[2][lane];
+      sums.minX  = 1.0;
+      sums.minY  = block[lane];
+      sums.maxY  = block[(numBins - 1) * ZIPF_LANES + lane];
+
+      finishSlopeR2(numBins, &sums, &task->results[histogram + lane]);
+   }
+}
+
+//*****************************************************************************
+// Builds Batcher's odd-even merge sorting network for n elements (the
+// network for the next power of two, less the comparators that would
+// touch the padding, which never swap). Stores each comparator as a pair
+// (lower bin, higher bin) into comparators, unless it is NULL, and
+// returns the number of comparators.
+//*****************************************************************************
+int sortingNetwork(int n, uint16_t *comparators)
+{
+   int p, k, j, i, count = 0;
+
+   for(p=1;p<n;p*=2)
+      for(k=p;k>=1;k/=2)
+         for(j=k%p;j+k<n;j+=2*k)
+            for(i=0;i<k && i+j+k<n;i++)
+               if((i + j) / (2 * p) == (i + j + k) / (2 * p))
+               {
+                  if(comparators != NULL)
+                  {
+                     comparators[2 * count]     = (uint16_t)(i + j);
+                     comparators[2 * count + 1] = (uint16_t)(i + j + k);
+                  }
+                  count++;
+               }
+
+   return count;
+}
+
+//*****************************************************************************
+// Same as byRank(), but walks the sorted counts as runs of equal counts
+// (count value, run length), so that log10() is taken once per distinct
+// count and each run is added to the regression sums in O(1). This is
+// much faster than byRank() on histograms with long runs of tied counts
+// (natural language and music, where often half the types have count 1),
+// and gives the same results up to rounding.
+//
+// The returned struct is malloc'ed and must be freed by the caller
+// (see byRankGroupedInto() for a version that does not allocate).
+//*****************************************************************************
+struct ZipfValues *byRankGrouped(double *counts, size_t numCounts)
+{
+   struct ZipfValues *results = (struct ZipfValues *)malloc(sizeof(struct ZipfValues));
+
+   byRankGroupedInto(counts, numCounts, results, NULL);
+
+   return results;
+}
+
+//*****************************************************************************
+// Reentrant version of byRankGrouped() (see byRankInto()).
+//*****************************************************************************
+int byRankGroupedInto(double *counts, size_t numCounts, struct ZipfValues *results, struct ZipfWorkspace *workspace)
+{
+   struct ZipfWorkspace temporary = { NULL, 0, 0 };
+   struct ZipfWorkspace *scratch = workspace != NULL ? workspace : &temporary;
+
+   checkNumRanksAndCounts(numCounts, numCounts);
+
+   double *newCounts = sortedCopy(counts, numCounts, scratch);
+   size_t index;
+
+   // the counts are ascending, so the run starting at index holds
+   // ranks numCounts - index down to numCounts - end + 1
+   const struct RankLogTable *table = getRankLogTable(numCounts < ZIPF_RANK_LOG_TABLE_MAX ? numCounts : ZIPF_RANK_LOG_TABLE_MAX);
+   struct ZipfSums sums;
+   size_t end;
+
+   clearSums(&sums);
+   sums.minX = 1.0;
+   for(index=0;index<numCounts;index=end)
+   {
+      for(end=index+1;end<numCounts && newCounts[end] == newCounts[index];end++)
+         ;
+
+      accumulateRun(table, newCounts[index], numCounts - end + 1, numCounts - index, &sums);
+   }
+   checkSums(&sums);
+
+   rankLogSums(numCounts, &sums.sumX, &sums.sumX2);
+   finishSlopeR2(numCounts, &sums, results);
+
+   free(temporary.arena);
+
+   return 0;
+}
+
+//*****************************************************************************
+// Same as byRank(), but takes the histogram in "frequency of frequencies"
+// form: numTypes[i] types have count counts[i] (the counts need not be
+// sorted or distinct, and entries with numTypes[i] == 0 are ignored).
+// Gives the same results as expanding the table into a full count vector
+// and calling byRank(), in O(numDistinct) time and memory.
+//
+// The returned struct is malloc'ed and must be freed by the caller
+// (see byRankCountOfCountsInto() for a version that does not allocate).
+//*****************************************************************************
+struct ZipfValues *byRankCountOfCounts(double *counts, int64_t *numTypes, size_t numDistinct)
+{
+   struct ZipfValues *results = (struct ZipfValues *)malloc(sizeof(struct ZipfValues));
+
+   byRankCountOfCountsInto(counts, numTypes, numDistinct, results, NULL);
+
+   return results;
+}
+
+//*****************************************************************************
+// Reentrant version of byRankCountOfCounts() (see byRankInto()).
+//*****************************************************************************
+int byRankCountOfCountsInto(double *counts, int64_t *numTypes, size_t numDistinct, struct ZipfValues *results, struct ZipfWorkspace *workspace)
+{
+   struct ZipfWorkspace temporary = { NULL, 0, 0 };
+   struct ZipfWorkspace *scratch = workspace != NULL ? workspace : &temporary;
+   size_t index, numCounts = 0, numRuns = 0;
+
+   reserveWorkspace(scratch, sizeof(struct ZipfRun) * numDistinct);
+   struct ZipfRun *runs = (struct ZipfRun *)allocWorkspace(scratch, sizeof(struct ZipfRun) * numDistinct);
+
+   for(index=0;index<numDistinct;index++)
+   {
+      if(numTypes[index] < 0)
+      {
+         fprintf(stderr, "Numbers of types should not be negative.\n");
+         exit(0);
+      }
+
+      if(numTypes[index] > 0)
+      {
+         runs[numRuns].count  = counts[index];
+         runs[numRuns].length = numTypes[index];
+         numRuns++;
+         numCounts += numTypes[index];
+      }
+   }
+
+   checkNumRanksAndCounts(numCounts, numCounts);
+
+   // only the (few) distinct counts are sorted, and only if they are
+   // not in ascending order already
+   for(index=1;index<numRuns && runs[index - 1].count <= runs[index].count;index++)
+      ;
+   if(index < numRuns)
+      qsort((void *)runs, numRuns, sizeof(struct ZipfRun), compareRuns);
+
+   // as in byRankGroupedInto(), ranks run from numCounts for the smallest
+   // count down to 1 for the largest
+   const struct RankLogTable *table = getRankLogTable(numCounts < ZIPF_RANK_LOG_TABLE_MAX ? numCounts : ZIPF_RANK_LOG_TABLE_MAX);
+   struct ZipfSums sums;
+   int64_t lastRank = numCounts;
+
+   clearSums(&sums);
+   sums.minX = 1.0;
+   for(index=0;index<numRuns;index++)
+   {
+      accumulateRun(table, runs[index].count, lastRank - runs[index].length + 1, lastRank, &sums);
+      lastRank -= runs[index].length;
+   }
+   checkSums(&sums);
+
+   rankLogSums(numCounts, &sums.sumX, &sums.sumX2);
+   finishSlopeR2(numCounts, &sums, results);
+
+   free(temporary.arena);
+
+   return 0;
+}
+
+//*****************************************************************************
+// 'Double' comparison function needed for sorting. This function
+// is passed in as a parameter to qsort() in the byRank() function.
+//*****************************************************************************
+int compare(const void *a, const void *b)
+{
+   double d = *( (double *) a)  - *( (double *) b );
+   
+   if(d > 0.0) 
+   {
+      return 1;
+   } 
+   else if (d < 0.0) 
+   {
+      return -1;
+   } 
+   else 
+   {
+      return 0;
+   }
+}
+
+//*****************************************************************************
+// ZipfRun comparison function needed for sorting (by count). This function
+// is passed in as a parameter to qsort() in byRankCountOfCounts().
+//*****************************************************************************
+int compareRuns(const void *a, const void *b)
+{
+   return compare(&((const struct ZipfRun *)a)->count, &((const struct ZipfRun *)b)->count);
+}
+
+//*****************************************************************************
+// Supporting function for byRankInto() and byRankGroupedInto(). Copies the
+// counts into the workspace (which it reserves) and sorts the copy in
+// ascending order, choosing the sort from what the copy loop saw:
+//   - a counting sort, when all counts are small integers
+//     (largest count below numCounts),
+//   - an LSD radix sort on the IEEE-754 bits, when all counts are
+//     positive (their bit patterns then sort like the values),
+//   - for short inputs, the counting sort if all counts are small
+//     integers (below ZIPF_SMALL_COUNTING_MAX and 16 * numCounts), else
+//     sortCounts(),
+//   - sortCounts() when some count is not positive (the fit then stops
+//     with an error anyway).
+//*****************************************************************************
+double *sortedCopy(double *counts, size_t numCounts, struct ZipfWorkspace *workspace)
+{
+   reserveWorkspace(workspace, 2 * sizeof(double) * numCounts + sortTallyBytes(numCounts));
+   double *newCounts = (double *)allocWorkspace(workspace, sizeof(double) * numCounts);
+   double *buffer = (double *)allocWorkspace(workspace, sizeof(double) * numCounts);
+
+   double min, max;
+   int integral = scanCounts(counts, numCounts, newCounts, &min, &max);
+
+   sortCopiedCounts(newCounts, numCounts, buffer, min, max, integral, workspace);
+
+   return newCounts;
+}
+
+//*****************************************************************************
+// Supporting function for sortedCopy() and byRankRangeInto(). Finds the
+// smallest and largest counts (copying them into copy, unless it is NULL)
+// and returns whether all of them are integers, without converting any
+// count out of int64_t's range: past 2^52 every double is an integer, and
+// only NaNs are not. The sorts of sortCopiedCounts() check the range
+// before they convert counts.
+//*****************************************************************************
+static inline int scanCounts(const double *counts, size_t numCounts, double *copy, double *min, double *max)
+{
+   double smallest = HUGE_VAL, largest = -HUGE_VAL;
+   size_t index;
+   int integral = TRUE;
+
+   for(index=0;index<numCounts;index++)
+   {
+      double count = counts[index];
+      if(copy != NULL) copy[index] = count;
+      if(count < smallest) smallest = count;
+      if(count > largest) largest = count;
+      integral &= fabs(count) < 0x1p52 ? count == (double)(int64_t)count : count == count;
+   }
+
+   *min = smallest;
+   *max = largest;
+   return integral;
+}
+
+//*****************************************************************************
+// Supporting function for sortedCopy() and sortedHistogramCopy(). Sorts
+// the copied counts, given the range of the counts and whether they are
+// all integers (see sortedCopy() for the choice of sort). The buffer
+// holds numCounts doubles, and the tallies of a parallel sort come from
+// the workspace, which must have sortTallyBytes(numCounts) bytes left.
+//*****************************************************************************
+void sortCopiedCounts(double *newCounts, size_t numCounts, double *buffer, double min, double max, int integral,
+                      struct ZipfWorkspace *workspace)
+{
+   // large inputs are sorted by several threads (the counting sort only
+   // while its per-thread tallies stay small; past that, small integers
+   // are still counted, by one thread, which beats the radix sort's six
+   // passes on any likely number of threads)
+   int numThreads = numCounts < ZIPF_PARALLEL_SORT_MIN ? 1 : getZipfThreads();
+   size_t *tallies = numThreads > 1 ? (size_t *)allocWorkspace(workspace, sortTallyBytes(numCounts)) : NULL;
+
+   if(numCounts < ZIPF_RADIX_SORT_MIN)
+   {
+      // short inputs of small integers are counted, which beats the
+      // mispredicted branches of sortCounts() while the tally stays
+      // within a small multiple of the input
+      if(integral && min > 0.0 && max < ZIPF_SMALL_COUNTING_MAX && max < 16.0 * numCounts)
+         smallCountingSortCounts(newCounts, numCounts, (int64_t)max, buffer);
+      else
+         sortCounts(newCounts, numCounts);
+   }
+   else if(!(min > 0.0))
+      sortCounts(newCounts, numCounts);
+   else if(integral && max < (double)numCounts)
+   {
+      if(numThreads == 1 || max >= ZIPF_PARALLEL_COUNTING_MAX)
+         countingSortCounts(newCounts, numCounts, (int64_t)max, (size_t *)buffer);
+      else
+         parallelSortCounts(newCounts, numCounts, buffer, tallies, (int64_t)max, numThreads);
+   }
+   else
+   {
+      if(numThreads == 1)
+         radixSortCounts(newCounts, numCounts, buffer);
+      else
+         parallelSortCounts(newCounts, numCounts, buffer, tallies, -1, numThreads);
+   }
+}
+
+//*****************************************************************************
+// Supporting function for the callers of sortCopiedCounts(). Returns the
+// workspace bytes that sorting numCounts counts needs on top of the counts
+// and the buffer: the per-thread tallies of a parallel sort, sized for the
+// counting sort's largest digits (none on one thread).
+//*****************************************************************************
+size_t sortTallyBytes(size_t numCounts)
+{
+   int numThreads = numCounts < ZIPF_PARALLEL_SORT_MIN ? 1 : getZipfThreads();
+
+   return numThreads > 1 ? sizeof(size_t) * ZIPF_PARALLEL_COUNTING_MAX * numThreads : 0;
+}
+
+//*****************************************************************************
+// Sorts positive integral counts no larger than max in O(numCounts + max),
+// using the tally array (at least max + 1 entries).
+//*****************************************************************************
+void countingSortCounts(double *counts, size_t numCounts, int64_t max, size_t *tally)
+{
+   size_t index, repeat;
+   int64_t value;
+
+   memset(tally, 0, sizeof(size_t) * (max + 1));
+   for(index=0;index<numCounts;index++)
+      tally[(int64_t)counts[index]]++;
+
+   for(index=0,value=1;value<=max;value++)
+      for(repeat=tally[value];repeat>0;repeat--)
+         counts[index++] = value;
+}
+
+//*****************************************************************************
+// Version of countingSortCounts() for short inputs (max below
+// ZIPF_SMALL_COUNTING_MAX), with the tally on the stack. The tally is
+// turned into starting offsets and the counts are scattered into buffer
+// (numCounts doubles) and copied back, so, unlike writing out each
+// count's repeats, no step depends on an unpredictable branch.
+//*****************************************************************************
+void smallCountingSortCounts(double *counts, size_t numCounts, int64_t max, double *buffer)
+{
+   uint32_t tally[ZIPF_SMALL_COUNTING_MAX];
+   uint32_t offset, next;
+   size_t index;
+   int64_t value;
+
+   memset(tally, 0, sizeof(uint32_t) * (max + 1));
+   for(index=0;index<numCounts;index++)
+      tally[(int64_t)counts[index]]++;
+
+   for(value=1,offset=0;value<=max;value++)
+   {
+      next = offset + tally[value];
+      tally[value] = offset;
+      offset = next;
+   }
+
+   for(index=0;index<numCounts;index++)
+      buffer[tally[(int64_t)counts[index]]++] = counts[index];
+
+   memcpy(counts, buffer, sizeof(double) * numCounts);
+}
+
+//*****************************************************************************
+// Sorts positive counts with an LSD radix sort on their IEEE-754 bit
+// patterns, 11 bits per pass, using buffer (numCounts doubles) as the
+// other half of each pass. The histograms of all passes are built in one
+// read, and passes where every count has the same digit (typically the
+// high exponent bits, or the low mantissa bits of integers) are skipped.
+//*****************************************************************************
+void radixSortCounts(double *counts, size_t numCounts, double *buffer)
+{
+   static const int shifts[ZIPF_RADIX_PASSES] = { 0, 11, 22, 33, 44, 55 };
+   size_t histograms[ZIPF_RADIX_PASSES][1 << ZIPF_RADIX_BITS];
+   const unsigned long long mask = (1 << ZIPF_RADIX_BITS) - 1;
+   unsigned long long bits;
+   double *from = counts, *to = buffer, *swap;
+   size_t index, offset, next;
+   int pass, digit;
+
+   memset(histograms, 0, sizeof(histograms));
+   for(index=0;index<numCounts;index++)
+   {
+      memcpy(&bits, &counts[index], sizeof(bits));
+      for(pass=0;pass<ZIPF_RADIX_PASSES;pass++)
+         histograms[pass][(bits >> shifts[pass]) & mask]++;
+   }
+
+   for(pass=0;pass<ZIPF_RADIX_PASSES;pass++)
+   {
+      memcpy(&bits, &from[0], sizeof(bits));
+      if(histograms[pass][(bits >> shifts[pass]) & mask] == numCounts)
+         continue;
+
+      // turn the histogram into starting offsets
+      for(digit=0,offset=0;digit<=(int)mask;digit++)
+      {
+         next = offset + histograms[pass][digit];
+         histograms[pass][digit] = offset;
+         offset = next;
+      }
+
+      for(index=0;index<numCounts;index++)
+      {
+         memcpy(&bits, &from[index], sizeof(bits));
+         to[histograms[pass][(bits >> shifts[pass]) & mask]++] = from[index];
+      }
+
+      swap = from; from = to; to = swap;
+   }
+
+   if(from != counts)
+      memcpy(counts, from, sizeof(double) * numCounts);
+}
+
+//*****************************************************************************
+// Sorts the counts in ascending order, in place and without allocating
+// (an introsort: quicksort with median-of-three pivots, insertion sort for
+// short ranges, and heapsort if the recursion gets too deep).
+//*****************************************************************************
+void sortCounts(double *counts, size_t numCounts)
+{
+   size_t n;
+   int depthLimit = 0;
+   for(n=numCounts;n>1;n>>=1)
+      depthLimit += 2;
+
+   while(numCounts > 16)
+   {
+      if(depthLimit-- == 0)
+      {
+         heapSortCounts(counts, numCounts);
+         return;
+      }
+
+      // median of three, also placing sentinels at both ends
+      size_t last = numCounts - 1, middle = numCounts / 2;
+      double tmp;
+      if(counts[middle] < counts[0])    { tmp = counts[middle]; counts[middle] = counts[0];    counts[0] = tmp; }
+      if(counts[last]   < counts[0])    { tmp = counts[last];   counts[last]   = counts[0];    counts[0] = tmp; }
+      if(counts[last]   < counts[middle]) { tmp = counts[last]; counts[last]   = counts[middle]; counts[middle] = tmp; }
+      double pivot = counts[middle];
+
+      size_t i = 0, j = last;
+      for(;;)
+      {
+         do i++; while(counts[i] < pivot);
+         do j--; while(counts[j] > pivot);
+         if(i >= j)
+            break;
+         tmp = counts[i]; counts[i] = counts[j]; counts[j] = tmp;
+      }
+
+      // recurse into the smaller side, loop on the larger one
+      if(j + 1 < numCounts - j - 1)
+      {
+         sortCounts(counts, j + 1);
+         counts += j + 1;
+         numCounts -= j + 1;
+      }
+      else
+      {
+         sortCounts(counts + j + 1, numCounts - j - 1);
+         numCounts = j + 1;
+      }
+   }
+
+   size_t i, j;
+   for(i=1;i<numCounts;i++)
+   {
+      double value = counts[i];
+      for(j=i;j>0 && counts[j - 1] > value;j--)
+         counts[j] = counts[j - 1];
+      counts[j] = value;
+   }
+}
+
+//*****************************************************************************
+// Supporting function for sortCounts(). Heapsort, used when quicksort
+// keeps picking bad pivots.
+//*****************************************************************************
+void heapSortCounts(double *counts, size_t numCounts)
+{
+   int64_t start, end, root, child;
+   double tmp;
+
+   for(end=numCounts,start=(int64_t)numCounts/2-1;end>1;)
+   {
+      if(start >= 0)
+      {
+         root = start--;                   // building the heap
+      }
+      else
+      {
+         end--;                            // moving the largest to the end
+         tmp = counts[0]; counts[0] = counts[end]; counts[end] = tmp;
+         root = 0;
+      }
+
+      while((child = 2 * root + 1) < end)
+      {
+         if(child + 1 < end && counts[child + 1] > counts[child])
+            child++;
+         if(counts[root] >= counts[child])
+            break;
+         tmp = counts[root]; counts[root] = counts[child]; counts[child] = tmp;
+         root = child;
+      }
+   }
+}
+
+//*****************************************************************************
+// Partially sorts the counts in ascending order, so that counts[nth] is
+// the count a full sort would put there, with none larger before it and
+// none smaller after it (quickselect, with the median-of-three pivots of
+// sortCounts(), which takes over if the pivots keep being bad).
+// O(numCounts) on average.
+//*****************************************************************************
+void selectCounts(double *counts, size_t numCounts, size_t nth)
+{
+   size_t n;
+   int depthLimit = 0;
+   for(n=numCounts;n>1;n>>=1)
+      depthLimit += 2;
+
+   while(numCounts > 16)
+   {
+      if(depthLimit-- == 0)
+      {
+         sortCounts(counts, numCounts);
+         return;
+      }
+
+      // median of three, also placing sentinels at both ends
+      size_t last = numCounts - 1, middle = numCounts / 2;
+      double tmp;
+      if(counts[middle] < counts[0])    { tmp = counts[middle]; counts[middle] = counts[0];    counts[0] = tmp; }
+      if(counts[last]   < counts[0])    { tmp = counts[last];   counts[last]   = counts[0];    counts[0] = tmp; }
+      if(counts[last]   < counts[middle]) { tmp = counts[last]; counts[last]   = counts[middle]; counts[middle] = tmp; }
+      double pivot = counts[middle];
+
+      size_t i = 0, j = last;
+      for(;;)
+      {
+         do i++; while(counts[i] < pivot);
+         do j--; while(counts[j] > pivot);
+         if(i >= j)
+            break;
+         tmp = counts[i]; counts[i] = counts[j]; counts[j] = tmp;
+      }
+
+      // only the side holding nth is partitioned further
+      if(nth <= j)
+         numCounts = j + 1;
+      else
+      {
+         counts += j + 1;
+         numCounts -= j + 1;
+         nth -= j + 1;
+      }
+   }
+
+   sortCounts(counts, numCounts);
+}
+
+//*****************************************************************************
+// The bySize distribution plots the values (y-axis)
+// against the supplised keys (x-axis) in log-log scale.
+//*****************************************************************************
+struct ZipfValues *bySize(int *sizes, size_t numSizes, double *counts, size_t numCounts)
+{
+   struct ZipfValues *results = (struct ZipfValues *)malloc(sizeof(struct ZipfValues));
+
+   bySizeInto(sizes, numSizes, counts, numCounts, results);
+
+   return results;
+}
+
+//*****************************************************************************
+// Same as bySize(), for 64-bit sizes.
+//*****************************************************************************
+struct ZipfValues *bySize64(int64_t *sizes, size_t numSizes, double *counts, size_t numCounts)
+{
+   struct ZipfValues *results = (struct ZipfValues *)malloc(sizeof(struct ZipfValues));
+
+   bySize64Into(sizes, numSizes, counts, numCounts, results);
+
+   return results;
+}
+
+//*****************************************************************************
+// Reentrant version of bySize(); the zipf values are stored in the
+// caller's results struct. It never allocates.
+//*****************************************************************************
+int bySizeInto(int *sizes, size_t numSizes, double *counts, size_t numCounts, struct ZipfValues *results)
+{
+   // the per-element checks are done by getSlopeR2Into() in the same pass
+   // that accumulates the regression sums
+   checkNumRanksAndCounts(numSizes, numCounts);
+   return getSlopeR2Into(sizes, numSizes, counts, numCounts, results);
+}
+
+//*****************************************************************************
+// Reentrant version of bySize64() (see bySizeInto()).
+//*****************************************************************************
+int bySize64Into(int64_t *sizes, size_t numSizes, double *counts, size_t numCounts, struct ZipfValues *results)
+{
+   checkNumRanksAndCounts(numSizes, numCounts);
+   return getSlopeR2_64Into(sizes, numSizes, counts, numCounts, results);
+}
+
+//*****************************************************************************
+// Maps a binary histogram file into memory, so that byRankHistogram() and
+// bySizeHistogram() can fit it without parsing or copying it (the pages
+// are read in by the fit itself, sequentially). The file must stay
+// unchanged while it is open. Returns NULL (with a message) if the file
+// cannot be opened or is not a valid histogram file.
+//
+// The format is little-endian:
+//
+//    offset  size  field
+//    0       8     magic "ZIPFHIST"
+//    8       4     version (1)
+//    12      4     count type: 1 = uint32, 2 = uint64, 3 = double (IEEE-754)
+//    16      4     key type: 0 = no keys, 1 = int32, 2 = int64
+//    20      4     flags: 1 = counts are sorted in ascending order
+//    24      8     number of values n
+//    32            n counts
+//                  n keys (if any), from the next multiple of 8 bytes
+//
+// The keys are the sizes (x-axis) of bySizeHistogram(); byRankHistogram()
+// ignores them. A file flagged as sorted is fitted by byRankHistogram()
+// in place, without the sorted copy byRank() makes.
+//*****************************************************************************
+struct ZipfHistogram *openZipfHistogram(const char *path)
+{
+   static const size_t countSizes[] = { 0, sizeof(uint32_t), sizeof(uint64_t), sizeof(double) };
+   static const size_t keySizes[]   = { 0, sizeof(int32_t), sizeof(int64_t) };
+   struct ZipfHistogram *histogram;
+   struct stat status;
+   unsigned char *header;
+   uint32_t version, countType, keyType, flags;
+   uint64_t numValues;
+   size_t fileSize, keyOffset;
+   void *map;
+   int fd, truncated;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+   fprintf(stderr, "Histogram files can only be read on little-endian machines.\n");
+   return NULL;
+#endif
+
+   if((fd = open(path, O_RDONLY)) < 0)
+   {
+      fprintf(stderr, "Could not open the histogram file %s.\n", path);
+      return NULL;
+   }
+
+   if(fstat(fd, &status) != 0 || (size_t)status.st_size < ZIPF_HISTOGRAM_HEADER_SIZE)
+   {
+      fprintf(stderr, "%s is not a histogram file (too short).\n", path);
+      close(fd);
+      return NULL;
+   }
+
+   // the mapping outlives the descriptor
+   fileSize = (size_t)status.st_size;
+   map = mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if(map == MAP_FAILED)
+   {
+      fprintf(stderr, "Could not map the histogram file %s.\n", path);
+      return NULL;
+   }
+
+   header = (unsigned char *)map;
+   memcpy(&version,   header + 8,  sizeof(version));
+   memcpy(&countType, header + 12, sizeof(countType));
+   memcpy(&keyType,   header + 16, sizeof(keyType));
+   memcpy(&flags,     header + 20, sizeof(flags));
+   memcpy(&numValues, header + 24, sizeof(numValues));
+
+   if(memcmp(header, ZIPF_HISTOGRAM_MAGIC, 8) != 0 || version != ZIPF_HISTOGRAM_VERSION ||
+      countType < ZIPF_COUNT_UINT32 || countType > ZIPF_COUNT_DOUBLE || keyType > ZIPF_KEY_INT64)
+   {
+      fprintf(stderr, "%s is not a version %d histogram file.\n", path, ZIPF_HISTOGRAM_VERSION);
+      munmap(map, fileSize);
+      return NULL;
+   }
+
+   // checked by division, so that a corrupt n cannot overflow the sizes
+   truncated = numValues > (fileSize - ZIPF_HISTOGRAM_HEADER_SIZE) / countSizes[countType];
+   keyOffset = truncated ? 0 : (ZIPF_HISTOGRAM_HEADER_SIZE + numValues * countSizes[countType] + 7) & ~(size_t)7;
+   if(!truncated && keyType != ZIPF_KEY_NONE)
+      truncated = keyOffset > fileSize || numValues > (fileSize - keyOffset) / keySizes[keyType];
+
+   if(truncated)
+   {
+      fprintf(stderr, "%s is truncated (%llu values expected).\n", path, (unsigned long long)numValues);
+      munmap(map, fileSize);
+      return NULL;
+   }
+
+   // the fits read the file front to back
+   madvise(map, fileSize, MADV_SEQUENTIAL);
+
+   histogram = (struct ZipfHistogram *)malloc(sizeof(struct ZipfHistogram));
+   histogram->map       = map;
+   histogram->mapSize   = fileSize;
+   histogram->numValues = numValues;
+   histogram->countType = countType;
+   histogram->keyType   = keyType;
+   histogram->flags     = flags;
+   histogram->counts    = header + ZIPF_HISTOGRAM_HEADER_SIZE;
+   histogram->keys      = keyType != ZIPF_KEY_NONE ? header + keyOffset : NULL;
+
+   return histogram;
+}
+
+//*****************************************************************************
+// Unmaps a histogram opened by openZipfHistogram() and frees it.
+//*****************************************************************************
+void closeZipfHistogram(struct ZipfHistogram *histogram)
+{
+   if(histogram == NULL)
+      return;
+
+   munmap(histogram->map, histogram->mapSize);
+   free(histogram);
+}
+
+//*****************************************************************************
+// Same as byRank(), for the counts of a histogram file.
+//*****************************************************************************
+struct ZipfValues *byRankHistogram(const struct ZipfHistogram *histogram)
+{
+   struct ZipfValues *results = (struct ZipfValues *)malloc(sizeof(struct ZipfValues));
+
+   byRankHistogramInto(histogram, results, NULL);
+
+   return results;
+}
+
+//*****************************************************************************
+// Reentrant version of byRankHistogram() (see byRankInto()). Sorted files
+// are fitted straight from the mapping; the others are converted to
+// doubles and sorted in the workspace.
+//*****************************************************************************
+int byRankHistogramInto(const struct ZipfHistogram *histogram, struct ZipfValues *results, struct ZipfWorkspace *workspace)
+{
+   struct ZipfWorkspace temporary = { NULL, 0, 0 };
+   struct ZipfWorkspace *scratch = workspace != NULL ? workspace : &temporary;
+   size_t numCounts = histogram->numValues;
+   struct SumsTask task = { NULL, NULL, NULL, NULL, NULL, numCounts, NULL, NULL, 0, 0, 0 };
+
+   checkNumRanksAndCounts(numCounts, numCounts);
+
+   if(histogram->flags & ZIPF_HISTOGRAM_SORTED)
+      setTaskCounts(&task, histogram);
+   else
+      task.counts = sortedHistogramCopy(histogram, scratch);
+
+   fitSlopeR2(&task, results);
+
+   free(temporary.arena);
+
+   return 0;
+}
+
+//*****************************************************************************
+// Same as bySize(), for the keys (sizes) and counts of a histogram file.
+//*****************************************************************************
+struct ZipfValues *bySizeHistogram(const struct ZipfHistogram *histogram)
+{
+   struct ZipfValues *results = (struct ZipfValues *)malloc(sizeof(struct ZipfValues));
+
+   bySizeHistogramInto(histogram, results);
+
+   return results;
+}
+
+//*****************************************************************************
+// Reentrant version of bySizeHistogram(). The keys and counts are read
+// straight from the mapping, so it never allocates.
+//*****************************************************************************
+int bySizeHistogramInto(const struct ZipfHistogram *histogram, struct ZipfValues *results)
+{
+   struct SumsTask task = { NULL, NULL, NULL, NULL, NULL, histogram->numValues, NULL, NULL, 0, 0, 0 };
+
+   if(histogram->keyType == ZIPF_KEY_NONE)
+   {
+      fprintf(stderr, "The histogram file has no keys (sizes).\n");
+      exit(0);
+   }
+
+   checkNumRanksAndCounts(histogram->numValues, histogram->numValues);
+
+   if(histogram->keyType == ZIPF_KEY_INT32)
+      task.ranks = (int *)histogram->keys;
+   else
+      task.ranks64 = (int64_t *)histogram->keys;
+   setTaskCounts(&task, histogram);
+
+   return fitSlopeR2(&task, results);
+}
+
+//*****************************************************************************
+// Supporting function for the histogram fits. Points the task's counts
+// at the histogram's counts, as they are stored in the file.
+//*****************************************************************************
+void setTaskCounts(struct SumsTask *task, const struct ZipfHistogram *histogram)
+{
+   if(histogram->countType == ZIPF_COUNT_UINT32)
+      task->counts32 = (const uint32_t *)histogram->counts;
+   else if(histogram->countType == ZIPF_COUNT_UINT64)
+      task->counts64 = (const uint64_t *)histogram->counts;
+   else
+      task->counts = (const double *)histogram->counts;
+}
+
+//*****************************************************************************
+// Supporting function for byRankHistogramInto(). Same as sortedCopy(),
+// for counts of any of the histogram file's types.
+//*****************************************************************************
+double *sortedHistogramCopy(const struct ZipfHistogram *histogram, struct ZipfWorkspace *workspace)
+{
+   size_t numCounts = histogram->numValues;
+
+   if(histogram->countType == ZIPF_COUNT_DOUBLE)
+      return sortedCopy((double *)histogram->counts, numCounts, workspace);
+
+   reserveWorkspace(workspace, 2 * sizeof(double) * numCounts + sortTallyBytes(numCounts));
+   double *newCounts = (double *)allocWorkspace(workspace, sizeof(double) * numCounts);
+   double *buffer = (double *)allocWorkspace(workspace, sizeof(double) * numCounts);
+
+   double min = HUGE_VAL, max = -HUGE_VAL;
+   size_t index;
+   for(index=0;index<numCounts;index++)
+   {
+      double count = histogram->countType == ZIPF_COUNT_UINT32 ? ((const uint32_t *)histogram->counts)[index]
+                                                               : (double)((const uint64_t *)histogram->counts)[index];
+      newCounts[index] = count;
+      if(count < min) min = count;
+      if(count > max) max = count;
+   }
+
+   sortCopiedCounts(newCounts, numCounts, buffer, min, max, TRUE, workspace);
+
+   return newCounts;
+}
+
+//*****************************************************************************
+// Creates an empty accumulator for an incremental bySize fit: points are
+// added with addZipfPoint(), taken out again with removeZipfPoint(), and
+// the fit of the points currently in it is read with
+// finalizeZipfAccumulator(). Each update is O(1), so a fit over a sliding
+// window can follow every event without refitting the whole window.
+//*****************************************************************************
+struct ZipfAccumulator *createZipfAccumulator(void)
+{
+   struct ZipfAccumulator *accumulator = (struct ZipfAccumulator *)malloc(sizeof(struct ZipfAccumulator));
+
+   clearZipfAccumulator(accumulator);
+
+   return accumulator;
+}
+
+//*****************************************************************************
+// Frees an accumulator created by createZipfAccumulator().
+//*****************************************************************************
+void freeZipfAccumulator(struct ZipfAccumulator *accumulator)
+{
+   free(accumulator);
+}
+
+//*****************************************************************************
+// Takes all points out of an accumulator.
+//*****************************************************************************
+void clearZipfAccumulator(struct ZipfAccumulator *accumulator)
+{
+   memset(accumulator, 0, sizeof(struct ZipfAccumulator));
+}
+
+//*****************************************************************************
+// Adds the point (size, count) to an accumulator, as if it were one more
+// element of the sizes and counts passed to bySize().
+//*****************************************************************************
+void addZipfPoint(struct ZipfAccumulator *accumulator, int64_t size, double count)
+{
+   updateZipfAccumulator(accumulator, size, count, 1);
+}
+
+//*****************************************************************************
+// Takes a point added by addZipfPoint() out of an accumulator again.
+// The point must be in it (this is not checked); afterwards the
+// accumulator is exactly as if the point had never been added.
+//*****************************************************************************
+void removeZipfPoint(struct ZipfAccumulator *accumulator, int64_t size, double count)
+{
+   if(accumulator->numPoints == 0)
+   {
+      fprintf(stderr, "Cannot remove a point from an empty accumulator.\n");
+      exit(0);
+   }
+
+   updateZipfAccumulator(accumulator, size, count, -1);
+}
+
+//*****************************************************************************
+// Supporting function for addZipfPoint() and removeZipfPoint(). Checks the
+// point like bySize() does, and adds it to (sign 1) or subtracts it from
+// (sign -1) the accumulator's sums.
+//*****************************************************************************
+void updateZipfAccumulator(struct ZipfAccumulator *accumulator, int64_t size, double count, int sign)
+{
+   double x, y;
+   uint64_t bits, squareWords[3];
+   unsigned __int128 square;
+
+   if(size <= 0)
+   {
+      fprintf(stderr, "Ranks should be strictly positive.\n");
+      exit(0);
+   }
+
+   // written so that NaNs are rejected too
+   if(!(count > 0.0))
+   {
+      fprintf(stderr, "Counts and values should be strictly positive.\n");
+      exit(0);
+   }
+
+   if(count == HUGE_VAL)
+   {
+      fprintf(stderr, "Counts should be finite.\n");
+      exit(0);
+   }
+
+   x = sign * log10((double)size);
+   y = log10(count);
+
+   // the products are split into their rounded value and its rounding
+   // error (both exact doubles), so that they are added exactly too
+   addExactSum(&accumulator->sumX, x);
+   addExactSum(&accumulator->sumY, sign * y);
+   addExactSum(&accumulator->sumXY, x * y);
+   addExactSum(&accumulator->sumXY, fma(x, y, -(x * y)));
+   addExactSum(&accumulator->sumX2, sign * (x * x));
+   addExactSum(&accumulator->sumX2, sign * fma(x, x, -(x * x)));
+   addExactSum(&accumulator->sumY2, sign * (y * y));
+   addExactSum(&accumulator->sumY2, sign * fma(y, y, -(y * y)));
+
+   memcpy(&bits, &count, sizeof(bits));
+   square = (unsigned __int128)bits * bits;
+   squareWords[0] = (uint64_t)square;
+   squareWords[1] = (uint64_t)(square >> 64);
+   squareWords[2] = 0;
+   addCountWords(accumulator->countSquares, squareWords, 3, sign);
+   if(sign > 0)
+   {
+      accumulator->numPoints++;
+      accumulator->countBits += bits;
+   }
+   else
+   {
+      accumulator->numPoints--;
+      accumulator->countBits -= bits;
+   }
+}
+
+//*****************************************************************************
+// Fits the points in an accumulator; the results are those of bySize()
+// over the same points (up to the rounding of bySize()'s own sums), with
+// the same special cases.
+//
+// The returned struct is malloc'ed and must be freed by the caller
+// (see finalizeZipfAccumulatorInto() for a version that does not allocate).
+//*****************************************************************************
+struct ZipfValues *finalizeZipfAccumulator(const struct ZipfAccumulator *accumulator)
+{
+   struct ZipfValues *results = (struct ZipfValues *)malloc(sizeof(struct ZipfValues));
+
+   finalizeZipfAccumulatorInto(accumulator, results);
+
+   return results;
+}
+
+//*****************************************************************************
+// Reentrant version of finalizeZipfAccumulator(); the zipf values are
+// stored in the caller's results struct. The accumulator is not changed,
+// so points can still be added and removed afterwards.
+//*****************************************************************************
+int finalizeZipfAccumulatorInto(const struct ZipfAccumulator *accumulator, struct ZipfValues *results)
+{
+   struct ZipfSums sums;
+
+   checkNumRanksAndCounts(accumulator->numPoints, accumulator->numPoints);
+
+   sums.sumX  = exactSumValue(&accumulator->sumX);
+   sums.sumY  = exactSumValue(&accumulator->sumY);
+   sums.sumXY = exactSumValue(&accumulator->sumXY);
+   sums.sumX2 = exactSumValue(&accumulator->sumX2);
+   sums.sumY2 = exactSumValue(&accumulator->sumY2);
+
+   // the points were checked as they were added, and the ranges of the
+   // counts are not kept: only whether they are all equal
+   sums.minX = 1.0;
+   sums.minY = 1.0;
+   sums.maxY = isAccumulatorUniform(accumulator) ? 1.0 : 2.0;
+
+   finishSlopeR2(accumulator->numPoints, &sums, results);
+
+   return 0;
+}
+
+//*****************************************************************************
+// Tells whether all counts in an accumulator are equal. With b the bits
+// of the counts, n * sum(b^2) >= sum(b)^2 (Cauchy-Schwarz), with equality
+// exactly when all the b are equal; both sides are computed exactly, in
+// 256 bits, so the answer is never wrong.
+//*****************************************************************************
+int isAccumulatorUniform(const struct ZipfAccumulator *accumulator)
+{
+   uint64_t numPoints = accumulator->numPoints;
+   uint64_t bits[2], left[4], right[4];
+
+   bits[0] = (uint64_t)accumulator->countBits;
+   bits[1] = (uint64_t)(accumulator->countBits >> 64);
+   multiplyCountWords(&numPoints, 1, accumulator->countSquares, 3, left);
+   multiplyCountWords(bits, 2, bits, 2, right);
+
+   return memcmp(left, right, sizeof(left)) == 0;
+}
+
+//*****************************************************************************
+// Supporting functions for isAccumulatorUniform(), on unsigned integers
+// of 64-bit words, lowest first. addCountWords() adds (sign 1) or
+// subtracts (sign -1) addend to or from sum, both numWords long (modulo
+// 2^(64 numWords), so that points can be taken out again);
+// multiplyCountWords() stores the numA + numB words of a * b in product.
+//*****************************************************************************
+static inline void addCountWords(uint64_t *sum, const uint64_t *addend, int numWords, int sign)
+{
+   unsigned __int128 carry = sign < 0;   // sum - addend = sum + ~addend + 1
+   int word;
+
+   for(word=0;word<numWords;word++)
+   {
+      carry += (unsigned __int128)sum[word] + (sign < 0 ? ~addend[word] : addend[word]);
+      sum[word] = (uint64_t)carry;
+      carry >>= 64;
+   }
+}
+
+static inline void multiplyCountWords(const uint64_t *a, int numA, const uint64_t *b, int numB, uint64_t *product)
+{
+   unsigned __int128 carry;
+   int i, j;
+
+   memset(product, 0, sizeof(uint64_t) * (numA + numB));
+   for(i=0;i<numA;i++)
+   {
+      carry = 0;
+      for(j=0;j<numB;j++)
+      {
+         carry += (unsigned __int128)a[i] * b[j] + product[i + j];
+         product[i + j] = (uint64_t)carry;
+         carry >>= 64;
+      }
+      product[i + numB] = (uint64_t)carry;
+   }
+}
+
+//*****************************************************************************
+// Adds all points of one accumulator to another, as if each had been
+// added to it with addZipfPoint(). The sums are exact, so merging is
+// associative and commutative: accumulators filled on separate shards
+// of the data and merged in any grouping give the same fit, to the last
+// bit, as a single accumulator over all the points.
+//*****************************************************************************
+void mergeZipfAccumulator(struct ZipfAccumulator *accumulator, const struct ZipfAccumulator *other)
+{
+   addExactWords(&accumulator->sumX,  other->sumX.words);
+   addExactWords(&accumulator->sumY,  other->sumY.words);
+   addExactWords(&accumulator->sumXY, other->sumXY.words);
+   addExactWords(&accumulator->sumX2, other->sumX2.words);
+   addExactWords(&accumulator->sumY2, other->sumY2.words);
+
+   accumulator->numPoints += other->numPoints;
+   accumulator->countBits += other->countBits;
+   addCountWords(accumulator->countSquares, other->countSquares, 3, 1);
+}
+
+//*****************************************************************************
+// Writes the state of an accumulator into a buffer of
+// ZIPF_ACCUMULATOR_ENCODED_SIZE bytes, so that it can be sent to another
+// process and read back with decodeZipfAccumulator(). The encoding is the
+// same on every machine; it is little-endian:
+//
+//    offset  size  field
+//    0       8     magic "ZIPFACCU"
+//    8       4     version (2)
+//    12      4     number of 64-bit words of each sum (5)
+//    16      4     scale of the sums (232: the lowest bit weighs 2^-232)
+//    20      4     zero
+//    24      8     number of points n
+//    32      16    sum of the bits of the counts (128 bits, low half first)
+//    48      24    sum of the squares of the counts' bits (192 bits, lowest
+//                  word first)
+//    72      200   sumX, sumY, sumXY, sumX2 and sumY2, each as 5 words of
+//                  two's complement fixed point, lowest word first
+//*****************************************************************************
+void encodeZipfAccumulator(const struct ZipfAccumulator *accumulator, unsigned char *buffer)
+{
+   const struct ZipfExactSum *sums[5] = { &accumulator->sumX, &accumulator->sumY, &accumulator->sumXY,
+                                         &accumulator->sumX2, &accumulator->sumY2 };
+   unsigned char *field = buffer + 72;
+   int sum, word;
+
+   memcpy(buffer, ZIPF_ACCUMULATOR_MAGIC, 8);
+   storeLittle32(buffer + 8,  ZIPF_ACCUMULATOR_VERSION);
+   storeLittle32(buffer + 12, ZIPF_EXACT_WORDS);
+   storeLittle32(buffer + 16, ZIPF_EXACT_SCALE);
+   storeLittle32(buffer + 20, 0);
+   storeLittle64(buffer + 24, accumulator->numPoints);
+   storeLittle64(buffer + 32, (uint64_t)accumulator->countBits);
+   storeLittle64(buffer + 40, (uint64_t)(accumulator->countBits >> 64));
+   for(word=0;word<3;word++)
+      storeLittle64(buffer + 48 + 8 * word, accumulator->countSquares[word]);
+
+   for(sum=0;sum<5;sum++)
+      for(word=0;word<ZIPF_EXACT_WORDS;word++, field += 8)
+         storeLittle64(field, sums[sum]->words[word]);
+}
+
+//*****************************************************************************
+// Reads an accumulator written by encodeZipfAccumulator(). Returns -1
+// (with a message), leaving the accumulator unchanged, if the buffer is
+// not a valid encoding.
+//*****************************************************************************
+int decodeZipfAccumulator(struct ZipfAccumulator *accumulator, const unsigned char *buffer, size_t size)
+{
+   struct ZipfExactSum *sums[5] = { &accumulator->sumX, &accumulator->sumY, &accumulator->sumXY,
+                                   &accumulator->sumX2, &accumulator->sumY2 };
+   const unsigned char *field = buffer + 72;
+   int sum, word;
+
+   if(size < ZIPF_ACCUMULATOR_ENCODED_SIZE || memcmp(buffer, ZIPF_ACCUMULATOR_MAGIC, 8) != 0 ||
+      loadLittle32(buffer + 8) != ZIPF_ACCUMULATOR_VERSION || loadLittle32(buffer + 12) != ZIPF_EXACT_WORDS ||
+      loadLittle32(buffer + 16) != ZIPF_EXACT_SCALE)
+   {
+      fprintf(stderr, "Not a version %d accumulator encoding.\n", ZIPF_ACCUMULATOR_VERSION);
+      return -1;
+   }
+
+   accumulator->numPoints = loadLittle64(buffer + 24);
+   accumulator->countBits = (unsigned __int128)loadLittle64(buffer + 40) << 64 | loadLittle64(buffer + 32);
+   for(word=0;word<3;word++)
+      accumulator->countSquares[word] = loadLittle64(buffer + 48 + 8 * word);
+
+   for(sum=0;sum<5;sum++)
+      for(word=0;word<ZIPF_EXACT_WORDS;word++, field += 8)
+         sums[sum]->words[word] = loadLittle64(field);
+
+   return 0;
+}
+
+//*****************************************************************************
+// Supporting functions for encodeZipfAccumulator() and
+// decodeZipfAccumulator(): little-endian integers, on any machine.
+//*****************************************************************************
+static inline void storeLittle32(unsigned char *bytes, uint32_t value)
+{
+   int index;
+
+   for(index=0;index<4;index++)
+      bytes[index] = (unsigned char)(value >> (8 * index));
+}
+
+static inline void storeLittle64(unsigned char *bytes, uint64_t value)
+{
+   int index;
+
+   for(index=0;index<8;index++)
+      bytes[index] = (unsigned char)(value >> (8 * index));
+}
+
+static inline uint32_t loadLittle32(const unsigned char *bytes)
+{
+   uint32_t value = 0;
+   int index;
+
+   for(index=3;index>=0;index--)
+      value = value << 8 | bytes[index];
+
+   return value;
+}
+
+static inline uint64_t loadLittle64(const unsigned char *bytes)
+{
+   uint64_t value = 0;
+   int index;
+
+   for(index=7;index>=0;index--)
+      value = value << 8 | bytes[index];
+
+   return value;
+}
+
+//*****************************************************************************
+// Adds a double to an exact fixed-point sum, without rounding. Bits below
+// the sum's resolution would be dropped, and values beyond its range
+// wrap around, but neither happens with the sums of log10()s kept by a
+// ZipfAccumulator.
+//*****************************************************************************
+void addExactSum(struct ZipfExactSum *sum, double value)
+{
+   uint64_t bits, mantissa, carry;
+   uint64_t addend[ZIPF_EXACT_WORDS] = { 0 };
+   int exponent, shift, word, index;
+
+   memcpy(&bits, &value, sizeof(bits));
+   exponent = (int)((bits >> 52) & 0x7FF);
+   mantissa = bits & ((1ull << 52) - 1);
+
+   if(exponent == 0 && mantissa == 0)
+      return;
+
+   if(exponent != 0)
+      mantissa |= 1ull << 52;
+   else
+      exponent = 1;   // subnormal
+
+   // position of the mantissa's lowest bit in the fixed-point sum
+   shift = exponent - 1075 + ZIPF_EXACT_SCALE;
+   if(shift < 0)
+   {
+      mantissa = shift > -64 ? mantissa >> -shift : 0;
+      shift = 0;
+   }
+
+   word = shift / 64;
+   shift %= 64;
+   if(word >= ZIPF_EXACT_WORDS)
+      return;
+
+   addend[word] = mantissa << shift;
+   if(shift != 0 && word + 1 < ZIPF_EXACT_WORDS)
+      addend[word + 1] = mantissa >> (64 - shift);
+
+   // two's complement of negative values
+   if(value < 0.0)
+   {
+      carry = 1;
+      for(index=0;index<ZIPF_EXACT_WORDS;index++)
+      {
+         addend[index] = ~addend[index] + carry;
+         carry = carry && addend[index] == 0;
+      }
+   }
+
+   addExactWords(sum, addend);
+}
+
+//*****************************************************************************
+// Adds fixed-point words (in the format of a ZipfExactSum) to an exact sum.
+//*****************************************************************************
+void addExactWords(struct ZipfExactSum *sum, const uint64_t *addend)
+{
+   uint64_t carry = 0;
+   int index;
+
+   for(index=0;index<ZIPF_EXACT_WORDS;index++)
+   {
+      uint64_t total = sum->words[index] + addend[index];
+      uint64_t next = total < addend[index];
+
+      total += carry;
+      next |= total < carry;
+      sum->words[index] = total;
+      carry = next;
+   }
+}
+
+//*****************************************************************************
+// Rounds an exact fixed-point sum to a double. The words are converted
+// and added up from the lowest, so the result is within an ulp or so of
+// the exact sum, and depends only on the sum.
+//*****************************************************************************
+double exactSumValue(const struct ZipfExactSum *sum)
+{
+   uint64_t words[ZIPF_EXACT_WORDS];
+   uint64_t carry = 1;
+   int negative = (int64_t)sum->words[ZIPF_EXACT_WORDS - 1] < 0;
+   double value = 0.0;
+   int index;
+
+   for(index=0;index<ZIPF_EXACT_WORDS;index++)
+   {
+      words[index] = sum->words[index];
+      if(negative)
+      {
+         words[index] = ~words[index] + carry;
+         carry = carry && words[index] == 0;
+      }
+   }
+
+   for(index=0;index<ZIPF_EXACT_WORDS;index++)
+      value += ldexp((double)words[index], 64 * index - ZIPF_EXACT_SCALE);
+
+   return negative ? -value : value;
+}
+
+//*****************************************************************************
+// Builds an index of the counts for fitting many ranges of their ranks
+// (see byRankIndex()): sorts them once, and stores for every rank r the
+// regression sums of ranks 1..r. It takes 88 bytes per count. The counts
+// are not changed.
+//
+// The returned index is malloc'ed and must be freed with freeZipfIndex().
+//*****************************************************************************
+struct ZipfIndex *createZipfIndex(double *counts, size_t numCounts)
+{
+   struct ZipfWorkspace scratch = { NULL, 0, 0 };
+   struct ZipfIndex *index;
+   size_t rank, end;
+   int positive = TRUE;
+
+   checkNumRanksAndCounts(numCounts, numCounts);
+
+   for(rank=0;rank<numCounts;rank++)
+      positive &= counts[rank] > 0.0;   // false for NaNs too
+
+   if(!positive)
+   {
+      fprintf(stderr, "Counts and values should be strictly positive.\n");
+      exit(0);
+   }
+
+   index = (struct ZipfIndex *)malloc(sizeof(struct ZipfIndex));
+   index->counts = (double *)malloc(sizeof(double) * numCounts);
+   index->prefix = (struct ZipfIndexEntry *)malloc(sizeof(struct ZipfIndexEntry) * (numCounts + 1));
+   index->numCounts = numCounts;
+   if(index->counts == NULL || index->prefix == NULL)
+   {
+      fprintf(stderr, "Could not allocate the index (%zu counts).\n", numCounts);
+      exit(0);
+   }
+
+   // sortedCopy() sorts in ascending order, so the ranks go the other way
+   double *sorted = sortedCopy(counts, numCounts, &scratch);
+   for(rank=1;rank<=numCounts;rank++)
+      index->counts[rank - 1] = sorted[numCounts - rank];
+   free(scratch.arena);
+
+   // each prefix sum is carried along with the exact rounding error of
+   // every addition (Knuth's TwoSum)
+   const struct RankLogTable *table = getRankLogTable(numCounts < ZIPF_RANK_LOG_TABLE_MAX ? numCounts : ZIPF_RANK_LOG_TABLE_MAX);
+   memset(&index->prefix[0], 0, sizeof(struct ZipfIndexEntry));
+   for(rank=1;rank<=numCounts;rank=end)
+   {
+      double count = index->counts[rank - 1];
+      double y = log10(count);
+
+      for(end=rank;end<=numCounts && index->counts[end - 1] == count;end++)
+      {
+         const struct ZipfIndexEntry *previous = &index->prefix[end - 1];
+         struct ZipfIndexEntry *entry = &index->prefix[end];
+         double x = end < table->size ? table->logs[end] : log10((double)end);
+         double terms[5] = { x, y, x * y, x * x, y * y };
+         int sum;
+
+         for(sum=0;sum<5;sum++)
+         {
+            double total = previous->sums[sum] + terms[sum];
+            double part = total - previous->sums[sum];
+
+            entry->sums[sum] = total;
+            entry->errors[sum] = previous->errors[sum] + ((previous->sums[sum] - (total - part)) + (terms[sum] - part));
+         }
+      }
+   }
+
+   return index;
+}
+
+//*****************************************************************************
+// Frees an index created by createZipfIndex().
+//*****************************************************************************
+void freeZipfIndex(struct ZipfIndex *index)
+{
+   if(index == NULL)
+      return;
+
+   free(index->counts);
+   free(index->prefix);
+   free(index);
+}
+
+//*****************************************************************************
+// Same as byRankRange() on the counts of the index, in O(1): the sums of
+// ranks firstRank..lastRank are the differences of two prefix sums, and
+// the smallest and largest counts are those of lastRank and firstRank.
+//
+// The returned struct is malloc'ed and must be freed by the caller
+// (see byRankIndexInto() for a version that does not allocate).
+//*****************************************************************************
+struct ZipfValues *byRankIndex(const struct ZipfIndex *index, size_t firstRank, size_t lastRank)
+{
+   struct ZipfValues *results = (struct ZipfValues *)malloc(sizeof(struct ZipfValues));
+
+   byRankIndexInto(index, firstRank, lastRank, results);
+
+   return results;
+}
+
+//*****************************************************************************
+// Reentrant version of byRankIndex().
+//*****************************************************************************
+int byRankIndexInto(const struct ZipfIndex *index, size_t firstRank, size_t lastRank, struct ZipfValues *results)
+{
+   struct ZipfSums sums;
+
+   checkRankRange(firstRank, lastRank, index->numCounts);
+
+   indexRangeSums(index, firstRank, lastRank, &sums);
+   finishSlopeR2(lastRank - firstRank + 1, &sums, results);
+
+   return 0;
+}
+
+//*****************************************************************************
+// Supporting function for byRankIndexInto() and the segmented fits. Sets
+// the sums of ranks firstRank..lastRank (a valid range) from the prefix
+// sums of the index, and the range of their counts.
+//*****************************************************************************
+void indexRangeSums(const struct ZipfIndex *index, size_t firstRank, size_t lastRank, struct ZipfSums *sums)
+{
+   const struct ZipfIndexEntry *before = &index->prefix[firstRank - 1], *last = &index->prefix[lastRank];
+   double range[5];
+   int sum;
+
+   for(sum=0;sum<5;sum++)
+      range[sum] = (last->sums[sum] - before->sums[sum]) + (last->errors[sum] - before->errors[sum]);
+
+   sums->sumX  = range[0];
+   sums->sumY  = range[1];
+   sums->sumXY = range[2];
+   sums->sumX2 = range[3];
+   sums->sumY2 = range[4];
+   sums->minX  = (double)firstRank;
+   sums->minY  = index->counts[lastRank - 1];
+   sums->maxY  = index->counts[firstRank - 1];
+}
+
+//*****************************************************************************
+// Fits many ranges of ranks of the same index in one call: range i is
+// firstRanks[i]..lastRanks[i], and its zipf values go to results[i]. The
+// ranges are spread over getZipfThreads() threads.
+//*****************************************************************************
+int byRankIndexBatch(const struct ZipfIndex *index, const size_t *firstRanks, const size_t *lastRanks,
+                     size_t numRanges, struct ZipfValues *results)
+{
+   struct IndexTask task = { index, firstRanks, lastRanks, numRanges, results, 0 };
+   size_t numChunks = (numRanges + ZIPF_INDEX_CHUNK - 1) / ZIPF_INDEX_CHUNK;
+   int numThreads = (size_t)getZipfThreads() < numChunks ? getZipfThreads() : (int)numChunks;
+
+   if(numThreads <= 1)
+      indexThread(&task, 0, 1);
+   else
+      runParallel(numThreads, indexThread, &task);
+
+   return 0;
+}
+
+//*****************************************************************************
+// Supporting function for byRankIndexBatch(), run by each thread: takes
+// the next unclaimed chunk of ranges until there are none left.
+//*****************************************************************************
+void indexThread(void *argument, int thread, int numThreads)
+{
+   struct IndexTask *task = (struct IndexTask *)argument;
+   size_t numChunks = (task->numRanges + ZIPF_INDEX_CHUNK - 1) / ZIPF_INDEX_CHUNK;
+   size_t chunk, range, last;
+
+   (void)thread;
+   (void)numThreads;
+
+   while((chunk = __atomic_fetch_add(&task->nextChunk, 1, __ATOMIC_RELAXED)) < numChunks)
+   {
+      range = chunk * ZIPF_INDEX_CHUNK;
+      last = task->numRanges - range < ZIPF_INDEX_CHUNK ? task->numRanges : range + ZIPF_INDEX_CHUNK;
+
+      for(;range<last;range++)
+         byRankIndexInto(task->index, task->firstRanks[range], task->lastRanks[range], &task->results[range]);
+   }
+}
+
+//*****************************************************************************
+// Fits the counts with two regimes, for distributions with a knee where
+// the head and the tail follow different exponents: ranks 1..kneeRank and
+// kneeRank + 1..numCounts are each fitted by byRank(), at the knee that
+// leaves the smallest total of squared residuals (each regime having at
+// least ZIPF_SEGMENT_MIN ranks). Ties go to the smallest knee.
+//
+// The counts are indexed once (see createZipfIndex()), after which every
+// knee is tried in O(1), so the search is O(n) after the sort; it is
+// spread over getZipfThreads() threads.
+//
+// The returned struct is malloc'ed and must be freed by the caller
+// (see byRankSegmentedInto() for a version that does not allocate).
+//*****************************************************************************
+struct ZipfSegmentedValues *byRankSegmented(double *counts, size_t numCounts)
+{
+   struct ZipfSegmentedValues *results = (struct ZipfSegmentedValues *)malloc(sizeof(struct ZipfSegmentedValues));
+
+   byRankSegmentedInto(counts, numCounts, results);
+
+   return results;
+}
+
+//*****************************************************************************
+// Reentrant version of byRankSegmented() (it still builds a temporary
+// index; see byRankIndexSegmentedInto() to reuse one).
+//*****************************************************************************
+int byRankSegmentedInto(double *counts, size_t numCounts, struct ZipfSegmentedValues *results)
+{
+   struct ZipfIndex *index = createZipfIndex(counts, numCounts);
+
+   byRankIndexSegmentedInto(index, results);
+   freeZipfIndex(index);
+
+   return 0;
+}
+
+//*****************************************************************************
+// Same as byRankSegmented(), on the counts of an index.
+//*****************************************************************************
+int byRankIndexSegmentedInto(const struct ZipfIndex *index, struct ZipfSegmentedValues *results)
+{
+   size_t numCounts = index->numCounts;
+   size_t numKnees, numChunks, chunk, knee;
+   double error;
+
+   if(numCounts < 2 * ZIPF_SEGMENT_MIN)
+   {
+      fprintf(stderr, "Counts should contain at least %d elements for a segmented fit.\n", 2 * ZIPF_SEGMENT_MIN);
+      exit(0);
+   }
+
+   // the knees are ZIPF_SEGMENT_MIN..numCounts - ZIPF_SEGMENT_MIN; each
+   // chunk of them keeps its best, and the chunks are merged in order, so
+   // the knee does not depend on the number of threads
+   numKnees = numCounts - 2 * ZIPF_SEGMENT_MIN + 1;
+   numChunks = (numKnees + ZIPF_CHUNK_SIZE - 1) / ZIPF_CHUNK_SIZE;
+   int numThreads = (size_t)getZipfThreads() < numChunks ? getZipfThreads() : (int)numChunks;
+
+   if(numThreads <= 1)
+   {
+      scanKnees(index, ZIPF_SEGMENT_MIN, numCounts - ZIPF_SEGMENT_MIN, &error, &knee);
+   }
+   else
+   {
+      struct SegmentTask task = { index, NULL, NULL, 0 };
+      task.bestErrors = (double *)malloc(sizeof(double) * numChunks);
+      task.bestKnees = (size_t *)malloc(sizeof(size_t) * numChunks);
+      runParallel(numThreads, segmentThread, &task);
+
+      error = task.bestErrors[0];
+      knee = task.bestKnees[0];
+      for(chunk=1;chunk<numChunks;chunk++)
+         if(task.bestErrors[chunk] < error)
+         {
+            error = task.bestErrors[chunk];
+            knee = task.bestKnees[chunk];
+         }
+
+      free(task.bestErrors);
+      free(task.bestKnees);
+   }
+
+   results->kneeRank = knee;
+   byRankIndexInto(index, 1, knee, &results->head);
+   byRankIndexInto(index, knee + 1, numCounts, &results->tail);
+
+   return 0;
+}
+
+//*****************************************************************************
+// Supporting function for byRankIndexSegmentedInto(), run by each thread:
+// takes the next unclaimed chunk of knees until there are none left.
+//*****************************************************************************
+void segmentThread(void *argument, int thread, int numThreads)
+{
+   struct SegmentTask *task = (struct SegmentTask *)argument;
+   size_t lastKnee = task->index->numCounts - ZIPF_SEGMENT_MIN;
+   size_t numChunks = (lastKnee - ZIPF_SEGMENT_MIN + ZIPF_CHUNK_SIZE) / ZIPF_CHUNK_SIZE;
+   size_t chunk, first;
+
+   (void)thread;
+   (void)numThreads;
+
+   while((chunk = __atomic_fetch_add(&task->nextChunk, 1, __ATOMIC_RELAXED)) < numChunks)
+   {
+      first = ZIPF_SEGMENT_MIN + chunk * ZIPF_CHUNK_SIZE;
+      scanKnees(task->index, first, lastKnee - first < ZIPF_CHUNK_SIZE ? lastKnee : first + ZIPF_CHUNK_SIZE - 1,
+                &task->bestErrors[chunk], &task->bestKnees[chunk]);
+   }
+}
+
+//*****************************************************************************
+// Supporting function for byRankIndexSegmentedInto(). Tries the knees
+// firstKnee..lastKnee and returns the smallest total of squared residuals
+// of the two regimes, and its (smallest) knee.
+//*****************************************************************************
+void scanKnees(const struct ZipfIndex *index, size_t firstKnee, size_t lastKnee, double *bestError, size_t *bestKnee)
+{
+   struct ZipfSums head, tail;
+   size_t knee;
+   double error;
+
+   *bestError = HUGE_VAL;
+   *bestKnee = firstKnee;
+
+   for(knee=firstKnee;knee<=lastKnee;knee++)
+   {
+      indexRangeSums(index, 1, knee, &head);
+      indexRangeSums(index, knee + 1, index->numCounts, &tail);
+
+      error = residualSquares(knee, &head) + residualSquares(index->numCounts - knee, &tail);
+      if(error < *bestError)
+      {
+         *bestError = error;
+         *bestKnee = knee;
+      }
+   }
+}
+
+//*****************************************************************************
+// Returns the sum of the squared residuals of the least-squares line of
+// numPoints points with the given sums (0 for a flat or exact fit).
+//*****************************************************************************
+double residualSquares(size_t numPoints, const struct ZipfSums *sums)
+{
+   double n = (double)numPoints;
+   double sxx = sums->sumX2 - sums->sumX * sums->sumX / n;
+   double sxy = sums->sumXY - sums->sumX * sums->sumY / n;
+   double syy = sums->sumY2 - sums->sumY * sums->sumY / n;
+   double error;
+
+   if(sums->minY == sums->maxY)
+      return 0.0;
+
+   error = sxx > 0.0 ? syy - sxy * sxy / sxx : syy;
+
+   return error > 0.0 ? error : 0.0;
+}
+
+//*****************************************************************************
+// Fits the values (e.g., the counts of a histogram, as observations) with
+// a discrete power law p(x) = x^-alpha / zeta(alpha, xmin) for x >= xmin,
+// following Clauset, Shalizi and Newman (2009), "Power-law distributions
+// in empirical data": alpha is the maximum-likelihood exponent of the
+// tail, which, unlike the slope of the log-log regression, converges to
+// the true exponent as the tail grows (its bias is of order 1 / numTail),
+// and xmin is the value for which the tail and its fit are closest in
+// Kolmogorov-Smirnov distance.
+//
+// Every distinct value leaving at least ZIPF_POWER_LAW_TAIL_MIN values in
+// the tail is tried as xmin (the smallest one if there are fewer values).
+// If there are more than ZIPF_POWER_LAW_CANDIDATES_MAX of them, only every
+// k-th is, as with the "sample" option of Clauset's plfit, and then all
+// those between the best one and its sampled neighbours. Only candidates
+// with at least two distinct values in their tail are tried: if all of
+// the tail is xmin, the likelihood grows without bound in alpha.
+// Alpha solves the likelihood equation exactly (see powerLawAlpha()),
+// starting from their approximation
+//    alpha = 1 + n / sum(ln(x / (xmin - 1/2)), x >= xmin)
+// which, with suffix sums of the sorted values, is O(1) per candidate (and
+// good to a few percent past xmin = 6, but far off below: 2.44 for a tail
+// of all ones); a few Newton steps then make it exact.
+// The KS distance is taken at the distinct values of the tail, skipping
+// the ranges of values where it provably cannot grow (see
+// powerLawDistance()). The candidates are spread over getZipfThreads()
+// threads. Ties go to the smallest xmin.
+//
+// The values should be positive integers; they are not changed. If they
+// are all equal, alpha and sigma are HUGE_VAL, and the KS distance 0.
+//
+// The returned struct is malloc'ed and must be freed by the caller
+// (see powerLawFitInto() for a version that does not allocate it).
+//*****************************************************************************
+struct ZipfPowerLaw *powerLawFit(double *values, size_t numValues)
+{
+   struct ZipfPowerLaw *results = (struct ZipfPowerLaw *)malloc(sizeof(struct ZipfPowerLaw));
+
+   powerLawFitInto(values, numValues, results);
+
+   return results;
+}
+
+//*****************************************************************************
+// Same as powerLawFit(), storing the fit in the caller's results struct.
+//*****************************************************************************
+int powerLawFitInto(double *values, size_t numValues, struct ZipfPowerLaw *results)
+{
+   struct ZipfWorkspace scratch = { NULL, 0, 0 };
+   struct PowerLawTask task;
+   size_t index, end, numDistinct, distinct, numCandidates, stride, size, first, last, best;
+   double variance;
+   int integral = TRUE;
+
+   checkNumRanksAndCounts(numValues, numValues);
+
+   double *sorted = sortedCopy(values, numValues, &scratch);
+
+   numDistinct = 0;
+   for(index=0;index<numValues;index++)
+   {
+      integral &= sorted[index] >= 1.0 && sorted[index] == floor(sorted[index]);   // false for NaNs too
+      numDistinct += index == 0 || sorted[index] != sorted[index - 1];
+   }
+
+   if(!integral)
+   {
+      fprintf(stderr, "Values should be positive integers for a discrete power-law fit.\n");
+      exit(0);
+   }
+
+   // all the values equal: the likelihood has no maximum
+   if(numDistinct == 1)
+   {
+      results->alpha = results->sigma = HUGE_VAL;
+      results->xmin = sorted[0];
+      results->ks = 0.0;
+      results->numTail = numValues;
+      free(scratch.arena);
+      return 0;
+   }
+
+   double *distinctValues = (double *)malloc(sizeof(double) * numDistinct);
+   double *logs = (double *)malloc(sizeof(double) * numDistinct);
+   double *tailCounts = (double *)malloc(sizeof(double) * (numDistinct + 1));
+   double *tailLogs = (double *)malloc(sizeof(double) * (numDistinct + 1));
+
+   // the distinct values and their multiplicities, then the suffix sums
+   for(index=0,distinct=0;index<numValues;index=end,distinct++)
+   {
+      for(end=index+1;end<numValues && sorted[end] == sorted[index];end++)
+         ;
+      distinctValues[distinct] = sorted[index];
+      logs[distinct] = log(sorted[index]);
+      tailCounts[distinct] = (double)(end - index);
+   }
+   free(scratch.arena);
+
+   tailCounts[numDistinct] = tailLogs[numDistinct] = 0.0;
+   for(distinct=numDistinct;distinct-->0;)
+   {
+      tailLogs[distinct] = tailLogs[distinct + 1] + tailCounts[distinct] * logs[distinct];
+      tailCounts[distinct] += tailCounts[distinct + 1];
+   }
+
+   task.values = distinctValues;
+   task.logs = logs;
+   task.tailCounts = tailCounts;
+   task.tailLogs = tailLogs;
+   task.numDistinct = numDistinct;
+   for(numCandidates=1;numCandidates<numDistinct-1;numCandidates++)
+      if(tailCounts[numCandidates] < ZIPF_POWER_LAW_TAIL_MIN)
+         break;
+
+   // past ZIPF_POWER_LAW_CANDIDATES_MAX candidates, an evenly spaced sample
+   // of them is tried, then all those between the best one's neighbours
+   stride = numCandidates > ZIPF_POWER_LAW_CANDIDATES_MAX ? (numCandidates - 1) / ZIPF_POWER_LAW_CANDIDATES_MAX + 1 : 1;
+   size = (numCandidates + stride - 1) / stride > 2 * stride ? (numCandidates + stride - 1) / stride : 2 * stride;
+   task.alphas = (double *)malloc(sizeof(double) * size);
+   task.distances = (double *)malloc(sizeof(double) * size);
+
+   best = scanPowerLawCandidates(&task, 0, stride, (numCandidates + stride - 1) / stride, &results->alpha, &results->ks);
+   if(stride > 1)
+   {
+      first = best >= stride ? best - stride + 1 : 0;
+      last = best + stride - 1 < numCandidates ? best + stride - 1 : numCandidates - 1;
+      best = scanPowerLawCandidates(&task, first, 1, last - first + 1, &results->alpha, &results->ks);
+   }
+
+   results->xmin = distinctValues[best];
+   results->numTail = (size_t)tailCounts[best];
+   powerLawLogMean(results->alpha, results->xmin, &variance);
+   results->sigma = 1.0 / sqrt(results->numTail * variance);
+
+   free(distinctValues);
+   free(logs);
+   free(tailCounts);
+   free(tailLogs);
+   free(task.alphas);
+   free(task.distances);
+
+   return 0;
+}
+
+//*****************************************************************************
+// Supporting function for powerLawFitInto(). Tries as xmin the count
+// distinct values first, first + stride, ..., on getZipfThreads() threads,
+// and returns the index of the best one (the smallest on ties), with its
+// alpha and KS distance.
+//
+// The best distance over a sample of the candidates, spread out
+// geometrically, is found first: it bounds the best one, so any candidate
+// that goes past it can be given up on at once.
+//*****************************************************************************
+size_t scanPowerLawCandidates(struct PowerLawTask *task, size_t first, size_t stride, size_t count, double *alpha, double *distance)
+{
+   size_t numChunks = (count + ZIPF_POWER_LAW_CHUNK - 1) / ZIPF_POWER_LAW_CHUNK;
+   int numThreads = (size_t)getZipfThreads() < numChunks ? getZipfThreads() : (int)numChunks;
+   size_t position, best, probe = 0;
+   double bound;
+
+   task->firstCandidate = first;
+   task->stride = stride;
+   task->numCandidates = count;
+   task->nextChunk = 0;
+
+   for(position=0,bound=HUGE_VAL;position<count;position+=1+position/ZIPF_POWER_LAW_SAMPLE)
+   {
+      fitPowerLawTail(task, first + position * stride, bound, alpha, distance, &probe);
+      if(*distance < bound)
+         bound = *distance;
+   }
+   task->cutoff = nextafter(bound, HUGE_VAL);   // ties with the bound are kept
+
+   if(numThreads <= 1)
+      powerLawThread(task, 0, 1);
+   else
+      runParallel(numThreads, powerLawThread, task);
+
+   best = 0;
+   for(position=1;position<count;position++)
+      if(task->distances[position] < task->distances[best])
+         best = position;
+
+   *alpha = task->alphas[best];
+   *distance = task->distances[best];
+
+   return first + best * stride;
+}
+
+//*****************************************************************************
+// Supporting function for scanPowerLawCandidates(), run by each thread:
+// takes the next unclaimed chunk of xmin candidates until there are none
+// left. Each candidate gives up once its distance exceeds the bound found
+// by scanPowerLawCandidates(), or reaches the best one before it in its
+// chunk, as it can then no longer be chosen; each first checks where the
+// one before it in its chunk had its largest difference, which is likely
+// close to its own. The chunks being fixed, the result does not depend
+// on the number of threads.
+//*****************************************************************************
+void powerLawThread(void *argument, int thread, int numThreads)
+{
+   struct PowerLawTask *task = (struct PowerLawTask *)argument;
+   size_t numChunks = (task->numCandidates + ZIPF_POWER_LAW_CHUNK - 1) / ZIPF_POWER_LAW_CHUNK;
+   size_t chunk, position, last, probe;
+   double best;
+
+   (void)thread;
+   (void)numThreads;
+
+   while((chunk = __atomic_fetch_add(&task->nextChunk, 1, __ATOMIC_RELAXED)) < numChunks)
+   {
+      position = chunk * ZIPF_POWER_LAW_CHUNK;
+      last = task->numCandidates - position < ZIPF_POWER_LAW_CHUNK ? task->numCandidates : position + ZIPF_POWER_LAW_CHUNK;
+
+      for(best=task->cutoff,probe=0;position<last;position++)
+      {
+         fitPowerLawTail(task, task->firstCandidate + position * task->stride, best,
+                         &task->alphas[position], &task->distances[position], &probe);
+         if(task->distances[position] < best)
+            best = task->distances[position];
+      }
+   }
+}
+
+//*****************************************************************************
+// Supporting function for powerLawFitInto(). Fits the tail starting at
+// the given distinct value, and returns alpha and the KS distance between
+// the tail's empirical distribution and the fitted one, whose CDF at x is
+// 1 - zeta(alpha, x + 1) / zeta(alpha, xmin) (see powerLawDistance()).
+// Stops as soon as the distance reaches cutoff, returning it unfinished.
+//
+// *probe is a distinct value to check first, if in the tail (e.g. where
+// the previous candidate's distance was found), and is replaced by where
+// this one's was found.
+//*****************************************************************************
+void fitPowerLawTail(const struct PowerLawTask *task, size_t candidate, double cutoff, double *alpha, double *distance,
+                     size_t *probe)
+{
+   struct PowerLawTail tail;
+   size_t last = task->numDistinct - 1;
+   double zetaFirst, zetaLast;
+
+   tail.task = task;
+   tail.numTail = task->tailCounts[candidate];
+   tail.alpha = 1.0 + tail.numTail / (task->tailLogs[candidate] - tail.numTail * log(task->values[candidate] - 0.5));
+   tail.alpha = powerLawAlpha(task->values[candidate], task->tailLogs[candidate] / tail.numTail - task->logs[candidate], tail.alpha);
+   tail.zetaMin = hurwitzZeta(tail.alpha, task->values[candidate]);
+   tail.zetaTerms[0] = tail.alpha / 12.0;
+   tail.zetaTerms[1] = tail.alpha * (tail.alpha + 1.0) * (tail.alpha + 2.0) / 720.0;
+   tail.zetaTerms[2] = tail.zetaTerms[1] * (tail.alpha + 3.0) * (tail.alpha + 4.0) / 42.0;
+   tail.largest = 0.0;
+   tail.largestIndex = candidate;
+   tail.cutoff = cutoff;
+
+   // the probe, the two ends of the tail, then what lies between them
+   if(*probe > candidate && *probe < last)
+      tailDifference(&tail, *probe, tailZeta(&tail, *probe));
+   zetaFirst = tail.zetaMin - exp(-tail.alpha * task->logs[candidate]);
+   zetaLast = last > candidate ? tailZeta(&tail, last) : zetaFirst;
+   tailDifference(&tail, candidate, zetaFirst);
+   tailDifference(&tail, last, zetaLast);
+   powerLawDistance(&tail, candidate, zetaFirst, last, zetaLast);
+
+   *alpha = tail.alpha;
+   *distance = tail.largest;
+   *probe = tail.largestIndex;
+}
+
+//*****************************************************************************
+// Supporting function for fitPowerLawTail(). Finds the largest difference
+// between the empirical and the fitted CDFs of the tail at the distinct
+// values strictly between first and last, whose zeta(alpha, value + 1)
+// are given (and whose differences are already in tail->largest).
+//
+// Both CDFs only grow, so no difference in between can exceed the larger
+// of (empirical at last - fitted at first) and (fitted at last - empirical
+// at first): ranges where that is no more than the largest difference so
+// far are skipped, and the others are split in two, the fitted CDF being
+// computed afresh at the middle. Short ranges are walked value by value,
+// with zeta(alpha, x + 1) = zeta(alpha, x) - x^-alpha, recomputing zeta
+// across gaps of more than ZIPF_ZETA_STEPS_MAX; past
+// ZIPF_ZETA_ASYMPTOTIC_MIN, where the values are mostly that far apart,
+// zeta is taken from its expansion (see tailZeta()), with the powers
+// x^-alpha of a range computed together by expBlock(): longer ranges are
+// split in ZIPF_POWER_LAW_SPLIT parts rather than two, and those of up to
+// ZIPF_POWER_LAW_LEAF values are walked at once. The result is that of
+// checking every value (up to rounding), in far fewer steps on long tails.
+//*****************************************************************************
+void powerLawDistance(struct PowerLawTail *tail, size_t first, double zetaFirst, size_t last, double zetaLast)
+{
+   const struct PowerLawTask *task = tail->task;
+   double bound, empiricalFirst, empiricalLast, zeta, x;
+   double powers[ZIPF_POWER_LAW_LEAF], zetas[ZIPF_POWER_LAW_SPLIT + 1];
+   size_t index, middle, points[ZIPF_POWER_LAW_SPLIT + 1];
+   int i, length;
+
+   if(last - first <= 1 || tail->largest >= tail->cutoff)
+      return;
+
+   // the empirical CDF just past first and just before last
+   empiricalFirst = 1.0 - task->tailCounts[first + 2] / tail->numTail;
+   empiricalLast = 1.0 - task->tailCounts[last] / tail->numTail;
+   bound = empiricalLast - (1.0 - zetaFirst / tail->zetaMin);
+   if((1.0 - zetaLast / tail->zetaMin) - empiricalFirst > bound)
+      bound = (1.0 - zetaLast / tail->zetaMin) - empiricalFirst;
+   if(bound <= tail->largest)
+      return;
+
+   if(last - first <= ZIPF_POWER_LAW_LEAF && task->values[first + 1] >= ZIPF_ZETA_ASYMPTOTIC_MIN)
+   {
+      length = (int)(last - first - 1);
+      for(i=0;i<length;i++)
+         powers[i] = -tail->alpha * task->logs[first + 1 + i];
+      expBlock(powers, powers, length);
+
+      for(i=0;i<length;i++)
+         tailDifference(tail, first + 1 + i, asymptoticZeta(tail, task->values[first + 1 + i], powers[i]));
+      return;
+   }
+
+   if(last - first <= ZIPF_ZETA_STEPS_MAX)
+   {
+      zeta = zetaFirst;
+      x = task->values[first] + 1.0;   // zeta = zeta(alpha, x)
+      for(index=first+1;index<last;index++)
+      {
+         double value = task->values[index];
+
+         if(value - x > ZIPF_ZETA_STEPS_MAX)
+            zeta = hurwitzZeta(tail->alpha, value);
+         else
+            for(;x<value;x+=1.0)
+               zeta -= pow(x, -tail->alpha);
+
+         zeta -= exp(-tail->alpha * task->logs[index]);
+         x = value + 1.0;
+         tailDifference(tail, index, zeta);
+      }
+      return;
+   }
+
+   // in parts, the lower ones first, where the differences tend to be largest
+   if(task->values[first + 1] >= ZIPF_ZETA_ASYMPTOTIC_MIN)
+   {
+      points[0] = first;
+      zetas[0] = zetaFirst;
+      points[ZIPF_POWER_LAW_SPLIT] = last;
+      zetas[ZIPF_POWER_LAW_SPLIT] = zetaLast;
+      for(i=1;i<ZIPF_POWER_LAW_SPLIT;i++)
+      {
+         points[i] = first + (last - first) * i / ZIPF_POWER_LAW_SPLIT;
+         powers[i - 1] = -tail->alpha * task->logs[points[i]];
+      }
+      expBlock(powers, powers, ZIPF_POWER_LAW_SPLIT - 1);
+
+      for(i=1;i<ZIPF_POWER_LAW_SPLIT;i++)
+      {
+         zetas[i] = asymptoticZeta(tail, task->values[points[i]], powers[i - 1]);
+         tailDifference(tail, points[i], zetas[i]);
+      }
+      for(i=0;i<ZIPF_POWER_LAW_SPLIT;i++)
+         powerLawDistance(tail, points[i], zetas[i], points[i + 1], zetas[i + 1]);
+      return;
+   }
+
+   middle = first + (last - first) / 2;
+   zeta = tailZeta(tail, middle);
+   tailDifference(tail, middle, zeta);
+   powerLawDistance(tail, first, zetaFirst, middle, zeta);
+   powerLawDistance(tail, middle, zeta, last, zetaLast);
+}
+
+//*****************************************************************************
+// Supporting function for powerLawDistance(). Takes the difference between
+// the empirical and the fitted CDFs at the given distinct value, whose
+// zeta(alpha, value + 1) is given, into tail->largest (and where it is,
+// into tail->largestIndex).
+//*****************************************************************************
+void tailDifference(struct PowerLawTail *tail, size_t index, double zeta)
+{
+   double empirical = tail->task->tailCounts[index + 1] / tail->numTail;
+   double difference = fabs(empirical - zeta / tail->zetaMin);
+
+   if(difference > tail->largest)
+   {
+      tail->largest = difference;
+      tail->largestIndex = index;
+   }
+}
+
+//*****************************************************************************
+// Supporting function for powerLawDistance(). Returns zeta(alpha, x + 1)
+// for the given distinct value x: past ZIPF_ZETA_ASYMPTOTIC_MIN, from
+// zeta(alpha, x) - x^-alpha expanded as in hurwitzZeta(), i.e.
+// x^-alpha (x / (alpha - 1) - 1/2 + alpha / (12 x) - ...), whose terms
+// from the fourth are below double precision there.
+//*****************************************************************************
+double tailZeta(const struct PowerLawTail *tail, size_t index)
+{
+   double value = tail->task->values[index];
+
+   if(value < ZIPF_ZETA_ASYMPTOTIC_MIN)
+      return hurwitzZeta(tail->alpha, value + 1.0);
+
+   return asymptoticZeta(tail, value, exp(-tail->alpha * tail->task->logs[index]));
+}
+
+//*****************************************************************************
+// Supporting function for tailZeta(). Returns the expansion of
+// zeta(alpha, x + 1) at the value x >= ZIPF_ZETA_ASYMPTOTIC_MIN, given its
+// power x^-alpha.
+//*****************************************************************************
+double asymptoticZeta(const struct PowerLawTail *tail, double value, double power)
+{
+   double inverse = 1.0 / value, inverse2 = inverse * inverse;
+
+   return power * (value / (tail->alpha - 1.0) - 0.5 +
+                   inverse * (tail->zetaTerms[0] - inverse2 * (tail->zetaTerms[1] - inverse2 * tail->zetaTerms[2])));
+}
+
+//*****************************************************************************
+// Supporting function for fitPowerLawTail(). Solves the likelihood
+// equation of the discrete power law with the given xmin,
+//    -zeta'(alpha, xmin) / zeta(alpha, xmin) = mean(ln(x)), x >= xmin
+// for alpha, given logMean = mean(ln(x / xmin)) > 0 over the tail and a
+// first guess: the left side, minus ln(xmin), is the mean of ln(x / xmin)
+// under the fit (see powerLawLogMean()), which decreases with alpha, its
+// derivative being minus the variance. Newton steps that would leave the
+// bracket of the root found so far are replaced by bisection (or by
+// doubling alpha, until the root is bracketed from above).
+//*****************************************************************************
+double powerLawAlpha(double xmin, double logMean, double alpha)
+{
+   double low = 1.0, high = HUGE_VAL, mean, variance, next;
+   int step;
+
+   for(step=0;step<ZIPF_POWER_LAW_STEPS_MAX;step++)
+   {
+      mean = powerLawLogMean(alpha, xmin, &variance);
+      if(mean > logMean)
+         low = alpha;
+      else
+         high = alpha;
+
+      next = alpha + (mean - logMean) / variance;
+      if(!(next > low && next < high))   // (false for NaNs too)
+         next = high < HUGE_VAL ? low + (high - low) / 2.0 : 2.0 * alpha;
+      if(fabs(next - alpha) <= 1e-12 * alpha)
+         return next;
+      alpha = next;
+   }
+
+   return alpha;
+}
+
+//*****************************************************************************
+// Supporting function for powerLawAlpha() and powerLawFitInto(). Returns
+// the mean of ln(x / a) under the discrete power law x^-s / zeta(s, a),
+// x >= a, and stores its variance in *variance: with Z(s) = a^s zeta(s, a),
+// they are -Z'/Z and Z''/Z - (Z'/Z)^2. Z and its derivatives in s follow
+// hurwitzZeta() term by term, each power (q / a)^-s being scaled by a^s so
+// that none underflows; the terms are summed up to past s as well, where
+// the Euler-Maclaurin corrections shrink, unless they fall below double
+// precision first.
+//*****************************************************************************
+double powerLawLogMean(double s, double a, double *variance)
+{
+   double sums[3] = { 0.0, 0.0, 0.0 };   // Z, -Z' and Z''
+   double logA = log(a), q, v, w, inverse, factor, factor1, factor2, grow, grow1, mean;
+   int j;
+
+   for(q=a;q<12.0 || q<s;q+=1.0)
+   {
+      v = log(q) - logA;
+      w = exp(-s * v);
+      addZetaTerm(sums, v, w, 1.0, 0.0, 0.0);
+      if(w * q < 0x1p-60 * (s - 1.0) * sums[0])
+         break;
+   }
+
+   if(q >= 12.0 && q >= s)
+   {
+      // the integral, the half term and the Bernoulli corrections, each a
+      // factor of s times q^-s; the factors of the corrections are
+      // B(2j) / (2j)! s (s + 1) ... (s + 2j - 2) q^(1 - 2j)
+      v = log(q) - logA;
+      w = exp(-s * v);
+      inverse = 1.0 / (s - 1.0);
+      addZetaTerm(sums, v, w, q * inverse, -q * inverse * inverse, 2.0 * q * inverse * inverse * inverse);
+      addZetaTerm(sums, v, w, 0.5, 0.0, 0.0);
+
+      factor = s / q;
+      factor1 = 1.0 / q;
+      factor2 = 0.0;
+      for(j=1;j<=6;j++)
+      {
+         addZetaTerm(sums, v, w, zetaBernoulli[j - 1] * factor, zetaBernoulli[j - 1] * factor1,
+                     zetaBernoulli[j - 1] * factor2);
+
+         // times (s + 2j - 1) (s + 2j) / q^2, by the product rule
+         grow = (s + 2 * j - 1) * (s + 2 * j) / (q * q);
+         grow1 = (2.0 * s + 4 * j - 1) / (q * q);
+         factor2 = factor2 * grow + 2.0 * factor1 * grow1 + factor * 2.0 / (q * q);
+         factor1 = factor1 * grow + factor * grow1;
+         factor *= grow;
+      }
+   }
+
+   mean = sums[1] / sums[0];
+   *variance = sums[2] / sums[0] - mean * mean;
+
+   return mean;
+}
+
+//*****************************************************************************
+// Supporting function for powerLawLogMean(). Adds a term f(s) (q / a)^-s
+// of Z(s), given v = ln(q / a), the power w = e^(-s v) and f and its
+// first two derivatives, to Z, -Z' and Z''.
+//*****************************************************************************
+static inline void addZetaTerm(double *sums, double v, double w, double f, double f1, double f2)
+{
+   sums[0] += f * w;
+   sums[1] += (v * f - f1) * w;
+   sums[2] += (f2 - 2.0 * v * f1 + v * v * f) * w;
+}
+
+//*****************************************************************************
+// Returns the Hurwitz zeta function zeta(s, a) = sum((a + k)^-s, k >= 0),
+// for s > 1 and a >= 1, by the Euler-Maclaurin formula: the terms below
+// 12 summed, the rest as an integral with 6 Bernoulli corrections (good to
+// double precision for the exponents of power laws).
+//*****************************************************************************
+double hurwitzZeta(double s, double a)
+{
+   double sum = 0.0, q, power, term;
+   int j;
+
+   for(q=a;q<12.0;q+=1.0)
+      sum += pow(q, -s);
+
+   power = pow(q, -s);
+   sum += power * q / (s - 1.0) + power / 2.0;
+
+   term = s * power / q;
+   for(j=1;j<=6;j++)
+   {
+      sum += zetaBernoulli[j - 1] * term;
+      term *= (s + 2 * j - 1) * (s + 2 * j) / (q * q);
+   }
+
+   return sum;
+}
+
+//*****************************************************************************
+// Checks that firstRank..lastRank is a non-empty range of the ranks
+// 1..numRanks (see byRankRange() and byRankIndex()).
+//*****************************************************************************
+void checkRankRange(size_t firstRank, size_t lastRank, size_t numRanks)
+{
+   if(firstRank < 1 || firstRank > lastRank || lastRank > numRanks)
+   {
+      fprintf(stderr, "Ranks %zu to %zu should be within 1 to %zu.\n", firstRank, lastRank, numRanks);
+      exit(0);
+   }
+}
+
+//*****************************************************************************
+// Counts the tokens of a text corpus file and fits them with byRank().
+// Returns NULL (with a message) if the file cannot be read.
+//
+// The returned struct is malloc'ed and must be freed by the caller.
+//*****************************************************************************
+struct ZipfValues *byRankCorpus(const char *path)
+{
+   struct ZipfTokenTable *table = createZipfTokenTable();
+   struct ZipfValues *results = NULL;
+
+   if(countZipfTokensFile(table, path) == 0)
+      results = byRankTokens(table);
+
+   freeZipfTokenTable(table);
+
+   return results;
+}
+
+//*****************************************************************************
+// Same as byRank(), for the counts of the tokens in a token table.
+//*****************************************************************************
+struct ZipfValues *byRankTokens(const struct ZipfTokenTable *table)
+{
+   struct ZipfValues *results = (struct ZipfValues *)malloc(sizeof(struct ZipfValues));
+
+   byRankTokensInto(table, results, NULL);
+
+   return results;
+}
+
+//*****************************************************************************
+// Reentrant version of byRankTokens() (see byRankInto()). The counts are
+// gathered from the table's slots straight into the workspace, where
+// they are sorted.
+//*****************************************************************************
+int byRankTokensInto(const struct ZipfTokenTable *table, struct ZipfValues *results, struct ZipfWorkspace *workspace)
+{
+   struct ZipfWorkspace temporary = { NULL, 0, 0 };
+   struct ZipfWorkspace *scratch = workspace != NULL ? workspace : &temporary;
+   size_t numCounts = getZipfTokenTypes(table);
+
+   checkNumRanksAndCounts(numCounts, numCounts);
+
+   reserveWorkspace(scratch, 2 * sizeof(double) * numCounts + sortTallyBytes(numCounts));
+   double *newCounts = (double *)allocWorkspace(scratch, sizeof(double) * numCounts);
+   double *buffer = (double *)allocWorkspace(scratch, sizeof(double) * numCounts);
+
+   double min = HUGE_VAL, max = -HUGE_VAL;
+   size_t slot, index = 0;
+   int shard;
+   for(shard=0;shard<ZIPF_TOKEN_SHARDS;shard++)
+   {
+      const struct ZipfTokenShard *tokens = &table->shards[shard];
+
+      for(slot=0;slot<tokens->numSlots;slot++)
+      {
+         if(tokens->slots[slot].count > 0)
+         {
+            double count = (double)tokens->slots[slot].count;
+            newCounts[index++] = count;
+            if(count < min) min = count;
+            if(count > max) max = count;
+         }
+      }
+   }
+
+   sortCopiedCounts(newCounts, numCounts, buffer, min, max, TRUE, scratch);
+
+   struct SumsTask task = { NULL, NULL, newCounts, NULL, NULL, numCounts, NULL, NULL, 0, 0, 0 };
+   fitSlopeR2(&task, results);
+
+   free(temporary.arena);
+
+   return 0;
+}
+
+//*****************************************************************************
+// Creates an empty token table.
+//*****************************************************************************
+struct ZipfTokenTable *createZipfTokenTable(void)
+{
+   struct ZipfTokenTable *table = (struct ZipfTokenTable *)malloc(sizeof(struct ZipfTokenTable));
+   int shard;
+
+   if(table == NULL)
+   {
+      fprintf(stderr, "Could not allocate the token table.\n");
+      exit(0);
+   }
+
+   for(shard=0;shard<ZIPF_TOKEN_SHARDS;shard++)
+      createZipfTokenShard(&table->shards[shard]);
+
+   return table;
+}
+
+//*****************************************************************************
+// Supporting function for createZipfTokenTable(). Sets up an empty shard.
+//*****************************************************************************
+void createZipfTokenShard(struct ZipfTokenShard *tokens)
+{
+   tokens->slots           = (struct ZipfToken *)calloc(ZIPF_TOKEN_SLOTS, sizeof(struct ZipfToken));
+   tokens->numSlots        = ZIPF_TOKEN_SLOTS;
+   tokens->numTypes        = 0;
+   tokens->strings         = (char *)malloc(ZIPF_TOKEN_BYTES);
+   tokens->stringsUsed     = 0;
+   tokens->stringsCapacity = ZIPF_TOKEN_BYTES;
+
+   if(tokens->slots == NULL || tokens->strings == NULL)
+   {
+      fprintf(stderr, "Could not allocate the token table.\n");
+      exit(0);
+   }
+}
+
+//*****************************************************************************
+// Frees a token table created by createZipfTokenTable().
+//*****************************************************************************
+void freeZipfTokenTable(struct ZipfTokenTable *table)
+{
+   int shard;
+
+   if(table == NULL)
+      return;
+
+   for(shard=0;shard<ZIPF_TOKEN_SHARDS;shard++)
+   {
+      free(table->shards[shard].slots);
+      free(table->shards[shard].strings);
+   }
+   free(table);
+}
+
+//*****************************************************************************
+// Returns the number of distinct tokens in the table.
+//*****************************************************************************
+size_t getZipfTokenTypes(const struct ZipfTokenTable *table)
+{
+   size_t numTypes = 0;
+   int shard;
+
+   for(shard=0;shard<ZIPF_TOKEN_SHARDS;shard++)
+      numTypes += table->shards[shard].numTypes;
+
+   return numTypes;
+}
+
+//*****************************************************************************
+// Counts the tokens of a text corpus file into the table. Regular files
+// are mapped into memory and tokenized in place; anything else (pipes,
+// devices) is read in chunks of ZIPF_READ_SIZE bytes. Returns 0, or -1
+// (with a message) if the file cannot be read or its read buffer cannot
+// be allocated.
+//*****************************************************************************
+int countZipfTokensFile(struct ZipfTokenTable *table, const char *path)
+{
+   struct stat status;
+   int fd;
+
+   if((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &status) != 0)
+   {
+      fprintf(stderr, "Could not open the corpus file %s.\n", path);
+      if(fd >= 0)
+         close(fd);
+      return -1;
+   }
+
+   if(S_ISREG(status.st_mode) && status.st_size > 0)
+   {
+      void *map = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if(map != MAP_FAILED)
+      {
+         close(fd);
+         madvise(map, (size_t)status.st_size, MADV_SEQUENTIAL);
+         countZipfTokens(table, (const char *)map, (size_t)status.st_size);
+         munmap(map, (size_t)status.st_size);
+         return 0;
+      }
+   }
+
+   // a token may straddle two reads, so the bytes after the last
+   // separator of each read are carried over to the front of the next
+   size_t capacity = ZIPF_READ_SIZE, carried = 0, filled, end;
+   char *buffer = (char *)malloc(capacity), *grown;
+   ssize_t bytes;
+
+   if(buffer == NULL)
+   {
+      fprintf(stderr, "Could not allocate %lu bytes to read the corpus file %s.\n", (unsigned long)capacity, path);
+      close(fd);
+      return -1;
+   }
+
+   while((bytes = read(fd, buffer + carried, capacity - carried)) > 0)
+   {
+      filled = carried + (size_t)bytes;
+      for(end=filled;end>0 && isTokenByte((unsigned char)buffer[end - 1]);end--)
+         ;
+
+      countZipfTokens(table, buffer, end);
+      carried = filled - end;
+      memmove(buffer, buffer + end, carried);
+
+      // a single token as long as the buffer
+      if(carried == capacity)
+      {
+         if((grown = (char *)realloc(buffer, 2 * capacity)) == NULL)
+         {
+            fprintf(stderr, "Could not allocate %lu bytes to read the corpus file %s.\n", (unsigned long)(2 * capacity), path);
+            free(buffer);
+            close(fd);
+            return -1;
+         }
+         buffer = grown;
+         capacity *= 2;
+      }
+   }
+
+   if(bytes < 0)
+   {
+      fprintf(stderr, "Could not read the corpus file %s.\n", path);
+      free(buffer);
+      close(fd);
+      return -1;
+   }
+
+   countZipfTokens(table, buffer, carried);
+   free(buffer);
+   close(fd);
+
+   return 0;
+}
+
+//*****************************************************************************
+// Counts the tokens of the given text into the table. Tokens are the
+// maximal runs of ASCII letters and digits and of non-ASCII bytes (so
+// UTF-8 letters stay inside words); whitespace, punctuation and control
+// characters separate them. Tokens are case-sensitive.
+//
+// The text is classified ZIPF_TOKEN_SPAN bytes at a time into bit masks
+// (one bit per byte, see tokenMaskBlock()), whose edges are the token
+// boundaries, so there is no branch per byte. The tokens of each span are
+// then hashed and added in batches of ZIPF_TOKEN_BATCH, with the slots of
+// a whole batch prefetched first, so the table's cache misses overlap.
+//
+// Texts of at least ZIPF_PARALLEL_TOKENS_MIN bytes are split into one
+// chunk per thread (see setZipfThreads()), on token boundaries. Each
+// thread counts its chunk into a table of its own, and the tables are
+// then merged shard by shard, each shard by one thread, so no thread ever
+// waits for a lock. The counts do not depend on the number of threads.
+//*****************************************************************************
+void countZipfTokens(struct ZipfTokenTable *table, const char *text, size_t length)
+{
+   int numThreads = getZipfThreads();
+   struct TokenTask task;
+   size_t bounds[ZIPF_MAX_THREADS + 1];
+   struct ZipfTokenTable *tables[ZIPF_MAX_THREADS];
+   int thread;
+
+   if(numThreads == 1 || length < ZIPF_PARALLEL_TOKENS_MIN)
+   {
+      countTokenRange(table, text, length);
+      return;
+   }
+
+   // each chunk boundary is moved forward past the token it falls into
+   bounds[0] = 0;
+   bounds[numThreads] = length;
+   for(thread=1;thread<numThreads;thread++)
+   {
+      size_t bound = length / numThreads * thread;
+
+      if(bound < bounds[thread - 1])
+         bound = bounds[thread - 1];
+      while(bound < length && isTokenByte((unsigned char)text[bound]))
+         bound++;
+      bounds[thread] = bound;
+   }
+
+   task.text      = text;
+   task.bounds    = bounds;
+   task.tables    = tables;
+   task.table     = table;
+   task.numTables = numThreads;
+
+   runParallel(numThreads, countTokensThread, &task);
+   runParallel(numThreads < ZIPF_TOKEN_SHARDS ? numThreads : ZIPF_TOKEN_SHARDS, mergeTokensThread, &task);
+
+   for(thread=0;thread<numThreads;thread++)
+      freeZipfTokenTable(tables[thread]);
+}
+
+//*****************************************************************************
+// Supporting function for countZipfTokens(), run by each thread: counts
+// the thread's chunk of the text into a table of its own.
+//*****************************************************************************
+void countTokensThread(void *argument, int thread, int numThreads)
+{
+   struct TokenTask *task = (struct TokenTask *)argument;
+
+   (void)numThreads;
+
+   task->tables[thread] = createZipfTokenTable();
+   countTokenRange(task->tables[thread], task->text + task->bounds[thread], task->bounds[thread + 1] - task->bounds[thread]);
+}
+
+//*****************************************************************************
+// Supporting function for countZipfTokens(), run by each thread: merges
+// every numThreads-th shard of the threads' tables into the same shard of
+// the destination table. A token's shard depends only on its hash, so
+// no two threads touch the same shard. When the destination shard is
+// still empty, the first thread's shard is moved into it rather than
+// copied.
+//*****************************************************************************
+void mergeTokensThread(void *argument, int thread, int numThreads)
+{
+   struct TokenTask *task = (struct TokenTask *)argument;
+   struct ZipfTokenShard *into, *from, swap;
+   size_t slot;
+   int shard, source;
+
+   for(shard=thread;shard<ZIPF_TOKEN_SHARDS;shard+=numThreads)
+   {
+      into = &task->table->shards[shard];
+      source = 0;
+      if(into->numTypes == 0)
+      {
+         swap = *into;
+         *into = task->tables[0]->shards[shard];
+         task->tables[0]->shards[shard] = swap;
+         source = 1;
+      }
+
+      for(;source<task->numTables;source++)
+      {
+         from = &task->tables[source]->shards[shard];
+         for(slot=0;slot<from->numSlots;slot++)
+         {
+            const struct ZipfToken *entry = &from->slots[slot];
+
+            if(entry->count > 0)
+               addZipfToken(into, from->strings + entry->offset, entry->length, entry->hash, entry->prefix, entry->count);
+         }
+      }
+   }
+}
+
+//*****************************************************************************
+// Supporting function for countZipfTokens(). Counts the tokens of the
+// text into the table, on the calling thread.
+//*****************************************************************************
+void countTokenRange(struct ZipfTokenTable *table, const char *text, size_t length)
+{
+   const unsigned char *bytes = (const unsigned char *)text;
+   uint64_t masks[ZIPF_TOKEN_SPAN / 64], edges, inToken = 0;
+   uint32_t positions[ZIPF_TOKEN_SPAN + 64];
+   const unsigned char *starts[ZIPF_TOKEN_SPAN / 2 + 1];
+   size_t lengths[ZIPF_TOKEN_SPAN / 2 + 1];
+   size_t spanStart, spanLength, word, tokenStart = (size_t)-1;
+   int numEdges, numTokens, count, index;
+
+   for(spanStart=0;spanStart<length;spanStart+=ZIPF_TOKEN_SPAN)
+   {
+      spanLength = length - spanStart < ZIPF_TOKEN_SPAN ? length - spanStart : ZIPF_TOKEN_SPAN;
+      tokenMaskBlock(bytes + spanStart, spanLength, masks);
+
+      // a bit is set where a byte differs from the one before it (bytes
+      // past the end of the text count as separators); the positions of
+      // these edges are written 4 at a time, so the loop rarely branches
+      // the wrong way (the extra positions are overwritten or ignored)
+      numEdges = 0;
+      for(word=0;word*64<spanLength;word++)
+      {
+         edges = masks[word] ^ ((masks[word] << 1) | inToken);
+         inToken = masks[word] >> 63;
+         count = __builtin_popcountll(edges);
+
+         for(index=0;index<count;index+=4)
+         {
+            positions[numEdges + index]     = (uint32_t)(word * 64 + __builtin_ctzll(edges | (1ull << 63)));
+            edges &= edges - 1;
+            positions[numEdges + index + 1] = (uint32_t)(word * 64 + __builtin_ctzll(edges | (1ull << 63)));
+            edges &= edges - 1;
+            positions[numEdges + index + 2] = (uint32_t)(word * 64 + __builtin_ctzll(edges | (1ull << 63)));
+            edges &= edges - 1;
+            positions[numEdges + index + 3] = (uint32_t)(word * 64 + __builtin_ctzll(edges | (1ull << 63)));
+            edges &= edges - 1;
+         }
+         numEdges += count;
+      }
+
+      // the edges alternate between token starts and token ends; a token
+      // left open by the previous span ends at the first edge
+      numTokens = 0;
+      index = 0;
+      if(tokenStart != (size_t)-1)
+      {
+         if(numEdges == 0)
+            continue;
+         starts[numTokens]    = bytes + tokenStart;
+         lengths[numTokens++] = spanStart + positions[0] - tokenStart;
+         index = 1;
+      }
+      for(;index+1<numEdges;index+=2)
+      {
+         starts[numTokens]    = bytes + spanStart + positions[index];
+         lengths[numTokens++] = positions[index + 1] - positions[index];
+      }
+      tokenStart = index < numEdges ? spanStart + positions[index] : (size_t)-1;
+
+      for(index=0;index<numTokens;index+=ZIPF_TOKEN_BATCH)
+         addTokenBatch(table, starts + index, lengths + index,
+                       numTokens - index < ZIPF_TOKEN_BATCH ? numTokens - index : ZIPF_TOKEN_BATCH, bytes + length);
+   }
+
+   // a token running to the very end of the text
+   if(tokenStart != (size_t)-1)
+   {
+      starts[0]  = bytes + tokenStart;
+      lengths[0] = length - tokenStart;
+      addTokenBatch(table, starts, lengths, 1, bytes + length);
+   }
+}
+
+//*****************************************************************************
+// Supporting function for countZipfTokens(). Hashes a batch of tokens and
+// prefetches their home slots, then adds them to the table.
+//*****************************************************************************
+void addTokenBatch(struct ZipfTokenTable *table, const unsigned char **starts, const size_t *lengths, int numTokens, const unsigned char *end)
+{
+   uint64_t hashes[ZIPF_TOKEN_BATCH], prefixes[ZIPF_TOKEN_BATCH];
+   int index;
+
+   struct ZipfTokenShard *shards[ZIPF_TOKEN_BATCH];
+
+   for(index=0;index<numTokens;index++)
+   {
+      prefixes[index] = loadTokenWord(starts[index], lengths[index] < 8 ? lengths[index] : 8, end);
+      hashes[index] = hashToken(starts[index], lengths[index], prefixes[index], end);
+      shards[index] = &table->shards[hashes[index] >> (64 - ZIPF_TOKEN_SHARD_BITS)];
+      __builtin_prefetch(&shards[index]->slots[(uint32_t)hashes[index] & (shards[index]->numSlots - 1)]);
+   }
+
+   // most tokens are found in their home slot, which is checked here
+   // first (only the words of up to 8 bytes, which need no memcmp())
+   for(index=0;index<numTokens;index++)
+   {
+      struct ZipfToken *entry = &shards[index]->slots[(uint32_t)hashes[index] & (shards[index]->numSlots - 1)];
+
+      if(entry->prefix == prefixes[index] && entry->length == lengths[index] && lengths[index] <= 8 && entry->count > 0)
+         entry->count++;
+      else
+         addZipfToken(shards[index], (const char *)starts[index], lengths[index], hashes[index], prefixes[index], 1);
+   }
+}
+
+//*****************************************************************************
+// Supporting function for countZipfTokens(). Returns whether the byte can
+// be part of a token (ASCII letters and digits, and bytes 0x80-0xFF).
+//*****************************************************************************
+static inline int isTokenByte(unsigned char c)
+{
+   static const uint64_t tokenBytes[4] = { 0x03FF000000000000ull, 0x07FFFFFE07FFFFFEull, ~0ull, ~0ull };
+
+   return (int)((tokenBytes[c >> 6] >> (c & 63)) & 1);
+}
+
+//*****************************************************************************
+// Supporting function for addTokenBatch() and hashToken(). Returns the
+// (at most 8) bytes at word as one zero-padded word, laid out as in memory.
+// The word is read whole and masked (without a branch on the length) when
+// the text goes on for 8 more bytes, so only the last few bytes of the
+// text are copied byte by byte.
+//*****************************************************************************
+static inline uint64_t loadTokenWord(const unsigned char *word, size_t length, const unsigned char *end)
+{
+   // shifted in two halves, so that length 0 (a shift by 64) works too
+   unsigned shift = 4 * (8 - (unsigned)length);
+   uint64_t value = 0;
+
+   if(word + 8 <= end)
+   {
+      memcpy(&value, word, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+      value &= (~0ull << shift) << shift;
+#else
+      value &= (~0ull >> shift) >> shift;
+#endif
+   }
+   else
+      memcpy(&value, word, length);
+
+   return value;
+}
+
+//*****************************************************************************
+// Supporting function for addTokenBatch(). Hashes the length bytes of a
+// token, whose first word (see loadTokenWord()) is given. The second word
+// is always mixed in (zero for short tokens), so only tokens longer than
+// 16 bytes take the loop.
+//*****************************************************************************
+static inline uint64_t hashToken(const unsigned char *token, size_t length, uint64_t prefix, const unsigned char *end)
+{
+   const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+   size_t second = length < 8 ? 8 : length;   // length clamped to 8..16, less 8
+   uint64_t hash = (prefix ^ length) * multiplier;
+   size_t index;
+
+   second = (second > 16 ? 16 : second) - 8;
+
+   hash = (hash ^ (hash >> 29) ^ loadTokenWord(token + 8, second, end)) * multiplier;
+
+   for(index=16;index<length;index+=8)
+   {
+      hash ^= hash >> 29;
+      hash = (hash ^ loadTokenWord(token + index, length - index < 8 ? length - index : 8, end)) * multiplier;
+   }
+
+   hash ^= hash >> 32;
+   hash *= multiplier;
+   return hash ^ (hash >> 29);
+}
+
+//*****************************************************************************
+// Adds count occurrences of a token, with the given hash and first word
+// (see loadTokenWord()), to its shard of a token table (only the low half
+// of the hash is used here). Tokens of up to 8 bytes are kept
+// whole in their slots; longer ones are interned in the arena the first
+// time they are seen. (Tokens are cut at 4 GB.)
+//*****************************************************************************
+void addZipfToken(struct ZipfTokenShard *tokens, const char *token, size_t length, uint64_t hash, uint64_t prefix, uint64_t count)
+{
+   size_t mask = tokens->numSlots - 1;
+   size_t slot = (uint32_t)hash & mask;
+   struct ZipfToken *entry;
+
+   if(length > UINT32_MAX)
+      length = UINT32_MAX;
+
+   for(;;slot=(slot + 1) & mask)
+   {
+      entry = &tokens->slots[slot];
+      if(entry->count == 0)
+         break;
+      if(entry->hash == (uint32_t)hash && entry->prefix == prefix && entry->length == length &&
+         (length <= 8 || memcmp(tokens->strings + entry->offset + 8, token + 8, length - 8) == 0))
+      {
+         entry->count += count;
+         return;
+      }
+   }
+
+   entry->hash   = (uint32_t)hash;
+   entry->length = (uint32_t)length;
+   entry->count  = count;
+   entry->prefix = prefix;
+   entry->offset = 0;
+
+   if(length > 8)
+   {
+      if(tokens->stringsUsed + length > tokens->stringsCapacity)
+      {
+         size_t capacity = tokens->stringsCapacity * 2 > tokens->stringsUsed + length ? tokens->stringsCapacity * 2 : tokens->stringsUsed + length;
+
+         tokens->strings = (char *)realloc(tokens->strings, capacity);
+         if(tokens->strings == NULL)
+         {
+            fprintf(stderr, "Could not allocate %lu bytes of tokens.\n", (unsigned long)capacity);
+            exit(0);
+         }
+         tokens->stringsCapacity = capacity;
+      }
+
+      memcpy(tokens->strings + tokens->stringsUsed, token, length);
+      entry->offset = tokens->stringsUsed;
+      tokens->stringsUsed += length;
+   }
+
+   if(++tokens->numTypes * 2 > tokens->numSlots)
+      growZipfTokenShard(tokens);
+}
+
+//*****************************************************************************
+// Supporting function for addZipfToken(). Doubles the number of slots of
+// a shard, re-inserting the tokens by their stored hashes (the interned
+// bytes do not move).
+//*****************************************************************************
+void growZipfTokenShard(struct ZipfTokenShard *tokens)
+{
+   size_t numSlots = tokens->numSlots * 2, mask = numSlots - 1, slot, index;
+   struct ZipfToken *slots = (struct ZipfToken *)calloc(numSlots, sizeof(struct ZipfToken));
+
+   if(slots == NULL)
+   {
+      fprintf(stderr, "Could not allocate %lu token slots.\n", (unsigned long)numSlots);
+      exit(0);
+   }
+
+   for(index=0;index<tokens->numSlots;index++)
+   {
+      if(tokens->slots[index].count > 0)
+      {
+         for(slot=tokens->slots[index].hash & mask;slots[slot].count>0;slot=(slot + 1) & mask)
+            ;
+         slots[slot] = tokens->slots[index];
+      }
+   }
+
+   free(tokens->slots);
+   tokens->slots    = slots;
+   tokens->numSlots = numSlots;
+}
+
+//*****************************************************************************
+// Supporting function for bySize() and byRank(). Checks the passed values
+// for correctness.
+//*****************************************************************************
+int checkRanksAndCounts(int *ranks, size_t numRanks, double *counts, size_t numCounts)
+{
+   checkNumRanksAndCounts(numRanks, numCounts);
+
+   size_t i;
+   for(i=0;i<numRanks;i++)
+   {
+      if(ranks[i] <= 0.0)
+      {
+         fprintf(stderr, "Ranks should be strictly positive.\n");
+         exit(0);
+      }
+
+      if(counts[i] <= 0.0)
+      {
+         fprintf(stderr, "Counts and values should be strictly positive.\n");
+         exit(0);
+      }
+   }
+
+   return 0;
+}
+
+//*****************************************************************************
+// Supporting function for checkRanksAndCounts(). Checks only the number of
+// ranks and counts, which is all that can be checked without reading them.
+//*****************************************************************************
+int checkNumRanksAndCounts(size_t numRanks, size_t numCounts)
+{
+   if(numCounts == 0)
+   {
+      fprintf(stderr, "Counts should contain at least one element.\n");
+      exit(0);
+   }
+
+   if(numRanks == 0)
+   {
+      fprintf(stderr, "Ranks should contain at least one element.\n");
+      exit(0);
+   }
+
+   if(numRanks != numCounts)
+   {
+      fprintf(stderr, "Ranks (%zu) and counts (%zu) should have the same size.\n", numRanks, numCounts);
+      exit(0);
+   }
+
+   return 0;
+}
+
+//*****************************************************************************
+// Supporting function for getSlopeR2(). Checks the smallest rank and count
+// seen by accumulateSums() for correctness (the per-element counterpart
+// of checkRanksAndCounts()).
+//*****************************************************************************
+int checkSums(struct ZipfSums *sums)
+{
+   // written so that NaNs are rejected too
+   if(!(sums->minX > 0.0))
+   {
+      fprintf(stderr, "Ranks should be strictly positive.\n");
+      exit(0);
+   }
+
+   if(!(sums->minY > 0.0))
+   {
+      fprintf(stderr, "Counts and values should be strictly positive.\n");
+      exit(0);
+   }
+
+   return 0;
+}
+
+//*****************************************************************************
+// Supporting function for byRank() and bySize(). The actual zipf values 
+// (slope, R2 and yint) are calculated in this function and returned
+// as a struct.
+//
+// If ranks is NULL, the ranks are implicit: counts[i] gets rank
+// numRanks - i, which is the byRank ranking when the counts are sorted
+// in ascending order. (getSlopeR2_64() takes 64-bit ranks.)
+//*****************************************************************************
+struct ZipfValues *getSlopeR2(int *ranks, size_t numRanks, double *counts, size_t numCounts)
+{
+   struct ZipfValues *results = (struct ZipfValues *)malloc(sizeof(struct ZipfValues));
+
+   getSlopeR2Into(ranks, numRanks, counts, numCounts, results);
+
+   return results;
+}
+
+//*****************************************************************************
+// Same as getSlopeR2(), for 64-bit ranks.
+//*****************************************************************************
+struct ZipfValues *getSlopeR2_64(int64_t *ranks, size_t numRanks, double *counts, size_t numCounts)
+{
+   struct ZipfValues *results = (struct ZipfValues *)malloc(sizeof(struct ZipfValues));
+
+   getSlopeR2_64Into(ranks, numRanks, counts, numCounts, results);
+
+   return results;
+}
+
+//*****************************************************************************
+// Reentrant version of getSlopeR2(); the zipf values are stored in the
+// caller's results struct. It never allocates.
+//*****************************************************************************
+int getSlopeR2Into(int *ranks, size_t numRanks, double *counts, size_t numCounts, struct ZipfValues *results)
+{
+   struct SumsTask task = { ranks, NULL, counts, NULL, NULL, numRanks, NULL, NULL, 0, 0, 0 };
+
+   (void)numCounts;
+   return fitSlopeR2(&task, results);
+}
+
+//*****************************************************************************
+// Reentrant version of getSlopeR2_64() (see getSlopeR2Into()).
+//*****************************************************************************
+int getSlopeR2_64Into(int64_t *ranks, size_t numRanks, double *counts, size_t numCounts, struct ZipfValues *results)
+{
+   struct SumsTask task = { NULL, ranks, counts, NULL, NULL, numRanks, NULL, NULL, 0, 0, 0 };
+
+   (void)numCounts;
+   return fitSlopeR2(&task, results);
+}
+
+//*****************************************************************************
+// Supporting function for getSlopeR2Into() and getSlopeR2_64Into(), which
+// pass either 32-bit or 64-bit ranks (or neither, for implicit ranks), and
+// for the histogram files, whose counts may also be integers (see
+// openZipfHistogram()).
+//*****************************************************************************
+int fitSlopeR2(struct SumsTask *task, struct ZipfValues *results)
+{
+   struct ZipfSums sums;
+
+   // validation, the all-equal check and the regression sums all come
+   // out of this single pass over the data
+   clearSums(&sums);
+   accumulateSums(task, &sums);
+   checkSums(&sums);
+
+   // implicit ranks are 1..numRanks, whose own sums have closed forms
+   // (more accurate than the ones added up point by point)
+   if(task->ranks == NULL && task->ranks64 == NULL)
+      rankLogSums(task->numPoints, &sums.sumX, &sums.sumX2);
+
+   finishSlopeR2(task->numPoints, &sums, results);
+
+   return 0;
+}
+
+//*****************************************************************************
+// Resets the regression sums and the rank/count ranges before a pass.
+//*****************************************************************************
+void clearSums(struct ZipfSums *sums)
+{
+   sums->sumX = sums->sumY = sums->sumXY = sums->sumX2 = sums->sumY2 = 0.0;
+   sums->minX = sums->minY = HUGE_VAL;
+   sums->maxY = -HUGE_VAL;
+}
+
+//*****************************************************************************
+// The single streaming pass behind getSlopeR2(), split into chunks of
+// ZIPF_CHUNK_SIZE points that are spread over getZipfThreads() threads
+// (see accumulateChunk()). The caller fills in the task's ranks, counts
+// and numPoints.
+//*****************************************************************************
+void accumulateSums(struct SumsTask *task, struct ZipfSums *sums)
+{
+   // with implicit ranks, log10 of the ranks comes from the shared table
+   // (if it can hold numPoints ranks), and the ranks are positive by construction
+   size_t numPoints = task->numPoints;
+   int implicit = task->ranks == NULL && task->ranks64 == NULL;
+   const struct RankLogTable *table = implicit ? getRankLogTable(numPoints) : NULL;
+   struct ZipfSums part, partials[ZIPF_CHUNK_ROUND];
+   size_t numChunks = (numPoints + ZIPF_CHUNK_SIZE - 1) / ZIPF_CHUNK_SIZE;
+   int numThreads = (size_t)getZipfThreads() < numChunks ? getZipfThreads() : (int)numChunks;
+   size_t chunk, round;
+
+   task->rankLogs  = table != NULL ? table->logs : NULL;
+   task->nextChunk = 0;
+
+   if(implicit && sums->minX > 1.0)
+      sums->minX = 1.0;
+
+   // the points are summed in fixed chunks, whose sums are then merged in
+   // chunk order, so the result is bitwise the same for any number of threads
+   if(numThreads <= 1)
+   {
+      for(chunk=0;chunk<numChunks;chunk++)
+      {
+         clearSums(&part);
+         accumulateChunk(task, chunk, &part);
+         mergeSums(sums, &part);
+      }
+   }
+   else
+   {
+      // a round of chunks at a time, so that no call allocates
+      task->partials = partials;
+      for(round=0;round<numChunks;round+=ZIPF_CHUNK_ROUND)
+      {
+         task->nextChunk = task->firstChunk = round;
+         task->lastChunk = numChunks - round < ZIPF_CHUNK_ROUND ? numChunks : round + ZIPF_CHUNK_ROUND;
+         runParallel(numThreads, sumsThread, task);
+
+         for(chunk=round;chunk<task->lastChunk;chunk++)
+            mergeSums(sums, &partials[chunk - round]);
+      }
+      task->partials = NULL;
+   }
+}
+
+//*****************************************************************************
+// Supporting function for accumulateSums(), run by each thread: takes the
+// next unclaimed chunk of the round until there are none left.
+//*****************************************************************************
+void sumsThread(void *argument, int thread, int numThreads)
+{
+   struct SumsTask *task = (struct SumsTask *)argument;
+   size_t chunk;
+
+   (void)thread;
+   (void)numThreads;
+
+   while((chunk = __atomic_fetch_add(&task->nextChunk, 1, __ATOMIC_RELAXED)) < task->lastChunk)
+   {
+      clearSums(&task->partials[chunk - task->firstChunk]);
+      accumulateChunk(task, chunk, &task->partials[chunk - task->firstChunk]);
+   }
+}
+
+//*****************************************************************************
+// Supporting function for accumulateSums(). One block at a time, the
+// ranks (and integer counts) of the given chunk are converted to doubles, the smallest rank
+// and the range of the counts are tracked (for checkSums() and the
+// all-equal check), both are log'ed (or looked up, if they are small
+// integers) and added into the regression sums.
+// Every block is still in L1 cache for the later steps, so the data goes
+// through memory only once.
+//*****************************************************************************
+void accumulateChunk(struct SumsTask *task, size_t chunk, struct ZipfSums *sums)
+{
+   double rankBlock[ZIPF_BLOCK_SIZE], countBlock[ZIPF_BLOCK_SIZE], logX[ZIPF_BLOCK_SIZE], logY[ZIPF_BLOCK_SIZE];
+   double minX, maxX, minY, maxY;
+   int *ranks = task->ranks;
+   int64_t *ranks64 = task->ranks64;
+   const uint32_t *counts32 = task->counts32;
+   const uint64_t *counts64 = task->counts64;
+   const double *counts;
+   const double *rankLogs = task->rankLogs;
+   size_t numPoints = task->numPoints;
+   size_t first = chunk * ZIPF_CHUNK_SIZE;
+   size_t last = numPoints - first < ZIPF_CHUNK_SIZE ? numPoints : first + ZIPF_CHUNK_SIZE;
+   size_t start;
+   int blockSize, index;
+
+   for(start=first;start<last;start+=ZIPF_BLOCK_SIZE)
+   {
+      blockSize = last - start < ZIPF_BLOCK_SIZE ? (int)(last - start) : ZIPF_BLOCK_SIZE;
+
+      if(rankLogs != NULL)
+      {
+         for(index=0;index<blockSize;index++)
+            logX[index] = rankLogs[numPoints - start - index];
+      }
+      else
+      {
+         if(ranks != NULL || ranks64 != NULL)
+         {
+            if(ranks != NULL)
+               for(index=0;index<blockSize;index++)
+                  rankBlock[index] = ranks[start + index];
+            else
+               for(index=0;index<blockSize;index++)
+                  rankBlock[index] = (double)ranks64[start + index];
+
+            // the ranks are integers, so small ones are looked up too
+            rangeBlock(rankBlock, blockSize, &minX, &maxX);
+            if(minX < sums->minX) sums->minX = minX;
+            if(!countLogBlock(rankBlock, logX, blockSize, minX, maxX))
+               log10Block(rankBlock, logX, blockSize);
+         }
+         else
+         {
+            for(index=0;index<blockSize;index++)
+               rankBlock[index] = (double)(numPoints - start - index);
+            log10Block(rankBlock, logX, blockSize);
+         }
+      }
+
+      if(counts32 != NULL)
+      {
+         for(index=0;index<blockSize;index++)
+            countBlock[index] = counts32[start + index];
+         counts = countBlock;
+      }
+      else if(counts64 != NULL)
+      {
+         for(index=0;index<blockSize;index++)
+            countBlock[index] = (double)counts64[start + index];
+         counts = countBlock;
+      }
+      else
+         counts = task->counts + start;
+
+      rangeBlock(counts, blockSize, &minY, &maxY);
+      if(minY < sums->minY) sums->minY = minY;
+      if(maxY > sums->maxY) sums->maxY = maxY;
+
+      if(!countLogBlock(counts, logY, blockSize, minY, maxY))
+         log10Block(counts, logY, blockSize);
+      accumulateLogBlock(logX, logY, blockSize, sums);
+   }
+}
+
+//*****************************************************************************
+// Adds the sums (and ranges) of another set of points into sums.
+//*****************************************************************************
+void mergeSums(struct ZipfSums *sums, const struct ZipfSums *other)
+{
+   sums->sumX  += other->sumX;
+   sums->sumY  += other->sumY;
+   sums->sumXY += other->sumXY;
+   sums->sumX2 += other->sumX2;
+   sums->sumY2 += other->sumY2;
+
+   if(other->minX < sums->minX) sums->minX = other->minX;
+   if(other->minY < sums->minY) sums->minY = other->minY;
+   if(other->maxY > sums->maxY) sums->maxY = other->maxY;
+}
+
+//*****************************************************************************
+// Returns the process-wide table of log10() of the ranks, such that
+// logs[r] = log10(r) and squarePrefix[r] = log10(1)^2 + ... + log10(r)^2
+// for 1 <= r <= numRanks, growing it first if needed.
+// Returns NULL if numRanks is above ZIPF_RANK_LOG_TABLE_MAX (the caller
+// then computes the logs itself).
+//
+// The table is shared by all threads. Lookups are lock-free; growing
+// takes a lock, fills a larger copy and then publishes it. Replaced tables
+// are never freed, since other threads may still be reading them (together
+// they take less memory than the current table).
+//*****************************************************************************
+const struct RankLogTable *getRankLogTable(size_t numRanks)
+{
+   struct RankLogTable *table = __atomic_load_n(&rankLogTable, __ATOMIC_ACQUIRE);
+
+   if(table != NULL && table->size > numRanks)
+      return table;
+
+   if(numRanks > ZIPF_RANK_LOG_TABLE_MAX)
+      return NULL;
+
+   pthread_mutex_lock(&rankLogTableLock);
+
+   table = rankLogTable;   // another thread may have grown it meanwhile
+   if(table == NULL || table->size <= numRanks)
+   {
+      size_t oldSize = table != NULL ? table->size : 1;
+      size_t size = 2 * oldSize > numRanks + 1 ? 2 * oldSize : numRanks + 1;
+      if(size > ZIPF_RANK_LOG_TABLE_MAX + 1)
+         size = ZIPF_RANK_LOG_TABLE_MAX + 1;
+
+      struct RankLogTable *grown = (struct RankLogTable *)malloc(sizeof(struct RankLogTable));
+      grown->logs = (double *)malloc(sizeof(double) * size);
+      grown->squarePrefix = (double *)malloc(sizeof(double) * size);
+      grown->size = size;
+      if(grown->logs == NULL || grown->squarePrefix == NULL)
+      {
+         fprintf(stderr, "Could not allocate the rank log table (%zu ranks).\n", size - 1);
+         exit(0);
+      }
+
+      // the prefix sums are Kahan-summed, so even the last entries are
+      // good to about one rounding error
+      size_t rank;
+      double sum = 0.0, compensation = 0.0, term, next;
+      grown->logs[0] = 0.0;   // unused (there is no rank 0)
+      grown->squarePrefix[0] = 0.0;
+      for(rank=1;rank<size;rank++)
+      {
+         grown->logs[rank] = rank < oldSize ? table->logs[rank] : log10((double)rank);
+
+         term = grown->logs[rank] * grown->logs[rank] - compensation;
+         next = sum + term;
+         compensation = (next - sum) - term;
+         sum = next;
+         grown->squarePrefix[rank] = sum;
+      }
+
+      __atomic_store_n(&rankLogTable, grown, __ATOMIC_RELEASE);
+      table = grown;
+   }
+
+   pthread_mutex_unlock(&rankLogTableLock);
+
+   return table;
+}
+
+//*****************************************************************************
+// Computes sumX = log10(1) + ... + log10(numRanks) = log10(numRanks!) and
+// sumX2 = log10(1)^2 + ... + log10(numRanks)^2 in O(1): the first from
+// lgamma(), the second from the cached prefix sums of the rank log table,
+// continued past ZIPF_RANK_LOG_TABLE_MAX with the Euler-Maclaurin formula
+//    sum(f(r), r=a+1..n) = integral(f, a..n) + (f(n) - f(a))/2
+//                          + (f'(n) - f'(a))/12 - (f'''(n) - f'''(a))/720
+// for f(x) = ln(x)^2 (the next term is below 1e-20 for a >= 1000).
+//*****************************************************************************
+void rankLogSums(size_t numRanks, double *sumX, double *sumX2)
+{
+   const struct RankLogTable *table = getRankLogTable(numRanks < ZIPF_RANK_LOG_TABLE_MAX ? numRanks : ZIPF_RANK_LOG_TABLE_MAX);
+   size_t base = numRanks < table->size - 1 ? numRanks : table->size - 1;
+
+   *sumX  = lgamma((double)numRanks + 1.0) / log(10.0);
+   *sumX2 = table->squarePrefix[base];
+
+   if(numRanks > base)
+   {
+      double a = (double)base, n = (double)numRanks;
+      double la = log(a), ln = log(n);
+      double tail = (n * ln * ln - 2.0 * n * ln + 2.0 * n) - (a * la * la - 2.0 * a * la + 2.0 * a)
+                  + (ln * ln - la * la) / 2.0
+                  + (2.0 * ln / n - 2.0 * la / a) / 12.0
+                  - ((4.0 * ln - 6.0) / (n * n * n) - (4.0 * la - 6.0) / (a * a * a)) / 720.0;
+
+      *sumX2 += tail / (log(10.0) * log(10.0));
+   }
+}
+
+//*****************************************************************************
+// Returns log10(firstRank) + ... + log10(lastRank). Short ranges are
+// added up from the rank log table; long ones are a difference of
+// lgamma()s, which is O(1) but loses a few digits to cancellation (still
+// far fewer than the range contributes to the sums).
+//*****************************************************************************
+double rankRangeLogSum(const struct RankLogTable *table, int64_t firstRank, int64_t lastRank)
+{
+   double sum = 0.0;
+   int64_t rank;
+
+   if(lastRank - firstRank >= ZIPF_SHORT_RUN)
+      return (lgamma((double)lastRank + 1.0) - lgamma((double)firstRank)) / log(10.0);
+
+   for(rank=firstRank;rank<=lastRank;rank++)
+      sum += (size_t)rank < table->size ? table->logs[rank] : log10((double)rank);
+
+   return sum;
+}
+
+//*****************************************************************************
+// Adds a run of equal counts, holding ranks firstRank..lastRank, to the
+// count-dependent regression sums (sumY, sumXY, sumY2) and the count
+// range. The rank-only sums (sumX, sumX2) are left to rankLogSums().
+//*****************************************************************************
+void accumulateRun(const struct RankLogTable *table, double count, int64_t firstRank, int64_t lastRank, struct ZipfSums *sums)
+{
+   double logCount;
+   double length = (double)(lastRank - firstRank + 1);
+
+   if(!countLogBlock(&count, &logCount, 1, count, count))
+      logCount = log10(count);
+
+   sums->sumY  += length * logCount;
+   sums->sumXY += logCount * rankRangeLogSum(table, firstRank, lastRank);
+   sums->sumY2 += length * logCount * logCount;
+
+   if(count < sums->minY) sums->minY = count;
+   if(count > sums->maxY) sums->maxY = count;
+}
+
+//*****************************************************************************
+// Turns the sums of numPoints points into the zipf values (slope, R2 and
+// yint), handling the monotonous and uniformly distributed cases.
+//*****************************************************************************
+void finishSlopeR2(size_t numPoints, struct ZipfSums *sums, struct ZipfValues *results)
+{
+   double sumX, sumY, sumXY, sumX2, sumY2,slope, r2, yint;
+
+   sumX = sumY = sumXY = sumX2 = sumY2 = 0.0;
+
+   // one exterme case:
+   // if the phenomenon is monotonous (only one type of event, e.g., ['a', 'a', 'a']),
+   // then the slope is negative infinity (cannot draw a line with only one data point),
+   // so indicate this with slope = 0 AND r2 = 0
+   if(numPoints == 1)
+   {
+      slope = 0.0;
+      r2 = 0.0;
+   }
+   //the other extreme case:
+   //if the phenomenon is uniformly distributed (several types of events,
+   //but all having the same number of instances, e.g., ['a', 'b', 'a', 'b', 'a', 'b']),
+   //then the slope = 0 and r2 = 1 (a horizontal line).
+   //(all counts are equal exactly when the smallest equals the largest)
+   else if(sums->minY == sums->maxY)
+   {
+      slope = 0.0;
+      r2 = 1.0;
+   }
+   else // general case, so calculate actual slope and r2 values
+   {
+      // the sums are only used here, so the special cases above keep yint = 0
+      sumX  = sums->sumX;
+      sumY  = sums->sumY;
+      sumXY = sums->sumXY;
+      sumX2 = sums->sumX2;
+      sumY2 = sums->sumY2;
+
+      // calculate slope
+      if((numPoints*sumX2 - sumX*sumX) == 0.0)
+         slope = 0.0;
+      else
+         slope = ((numPoints*sumXY - sumX*sumY) / (numPoints*sumX2 - sumX*sumX));
+
+      // calculate r2   
+      if(sqrt((numPoints*sumX2 - sumX*sumX) * (numPoints*sumY2 - sumY*sumY)) == 0.0)
+      {
+         r2 = 0.0;
+      }
+      else
+      {
+         r2 = (numPoints*sumXY - sumX*sumY)/(sqrt(numPoints*sumX2 - sumX*sumX)*sqrt(numPoints*sumY2 - sumY*sumY));
+         r2 = r2 * r2;
+      }
+   }
+
+   // calculate y-intercept
+   yint = (sumY - slope * sumX) / numPoints;
+
+   // packing slope, r2 and yint into a ZipfValues struct
+   // so that all three can be returned at once.
+   results->slope = slope;
+   results->r2    = r2;
+   results->yint  = yint;
+}
+
+
+//*****************************************************************************
+// Creates an empty workspace for byRankInto(); the arena is allocated by
+// the first call that uses it.
+//*****************************************************************************
+struct ZipfWorkspace *createZipfWorkspace(void)
+{
+   struct ZipfWorkspace *workspace = (struct ZipfWorkspace *)malloc(sizeof(struct ZipfWorkspace));
+
+   workspace->arena    = NULL;
+   workspace->capacity = 0;
+   workspace->used     = 0;
+
+   return workspace;
+}
+
+//*****************************************************************************
+// Frees a workspace created by createZipfWorkspace() and its arena.
+//*****************************************************************************
+void freeZipfWorkspace(struct ZipfWorkspace *workspace)
+{
+   if(workspace == NULL)
+      return;
+
+   free(workspace->arena);
+   free(workspace);
+}
+
+//*****************************************************************************
+// Starts a call that needs (at most) the given number of bytes of scratch
+// space: grows the arena if it is too small, and releases everything
+// handed out by the previous call. Since the arena is only grown here,
+// pointers from allocWorkspace() stay valid for the rest of the call.
+//*****************************************************************************
+void reserveWorkspace(struct ZipfWorkspace *workspace, size_t bytes)
+{
+   // leave room for aligning each piece handed out by allocWorkspace()
+   bytes += 4 * 64;
+
+   if(bytes > workspace->capacity)
+   {
+      // grow geometrically, so that slowly increasing sizes settle quickly
+      size_t capacity = workspace->capacity * 2 > bytes ? workspace->capacity * 2 : bytes;
+
+      free(workspace->arena);
+      workspace->arena = (char *)malloc(capacity);
+      if(workspace->arena == NULL)
+      {
+         fprintf(stderr, "Could not allocate %lu bytes of workspace.\n", (unsigned long)capacity);
+         exit(0);
+      }
+      workspace->capacity = capacity;
+   }
+
+   workspace->used = 0;
+}
+
+//*****************************************************************************
+// Hands out the next piece of the arena reserved by reserveWorkspace(),
+// aligned to a cache line.
+//*****************************************************************************
+void *allocWorkspace(struct ZipfWorkspace *workspace, size_t bytes)
+{
+   size_t offset = (workspace->used + 63) & ~(size_t)63;
+
+   if(offset + bytes > workspace->capacity)
+   {
+      fprintf(stderr, "Workspace too small (%lu bytes needed, %lu reserved).\n",
+              (unsigned long)(offset + bytes), (unsigned long)workspace->capacity);
+      exit(0);
+   }
+
+   workspace->used = offset + bytes;
+   return workspace->arena + offset;
+}
+
+//*****************************************************************************
+// Sets the number of threads used by the fits on large inputs (the
+// parallel sorts of byRank() and the chunked sums of getSlopeR2()).
+// 0 means one per online CPU. The default is 1. The results do not depend
+// on the number of threads.
+//*****************************************************************************
+void setZipfThreads(int numThreads)
+{
+   if(numThreads <= 0)
+      numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   if(numThreads < 1)
+      numThreads = 1;
+   if(numThreads > ZIPF_MAX_THREADS)
+      numThreads = ZIPF_MAX_THREADS;
+
+   __atomic_store_n(&zipfThreads, numThreads, __ATOMIC_RELAXED);
+}
+
+//*****************************************************************************
+// Returns the number of threads set by setZipfThreads().
+//*****************************************************************************
+int getZipfThreads(void)
+{
+   return __atomic_load_n(&zipfThreads, __ATOMIC_RELAXED);
+}
+
+//*****************************************************************************
+// Opts in to approximate log10()s of the points' ranks and counts in the
+// per-point passes of getSlopeR2(), bySize() and byRankBatchEqual(), for
+// exploratory scans that can trade accuracy for speed: ZIPF_LOG_FINE,
+// ZIPF_LOG_FAST or ZIPF_LOG_FASTEST (a polynomial of degree 9, 5 or 3 in
+// the mantissa, without the division of the exact vectorized log10()),
+// or back to the default ZIPF_LOG_EXACT. Logs that come from tables
+// (implicit ranks, explicit ranks and integer counts up to
+// ZIPF_COUNT_LOG_TABLE_MAX) or once per run (sorted byRank()) stay
+// exact.
+//
+// If every log10() is off by at most e (see the ZIPF_LOG_ tiers), the
+// slope is off by at most about e (1 + |slope|) / sd(log10(ranks)),
+// sd being the standard deviation, and r2 by about as much again times
+// 2 / sd(log10(counts)). In practice the errors mostly cancel: on 1e7
+// noisy relative frequencies with exponents 0.8 to 1.5, the slope was off
+// by up to 6e-8 with ZIPF_LOG_FAST and 5e-6 with ZIPF_LOG_FASTEST, and r2
+// by up to 6e-8 and 7e-7 (ZIPF_LOG_FINE is below the floats' precision).
+//*****************************************************************************
+void setZipfLogAccuracy(int tier)
+{
+   if(tier < ZIPF_LOG_EXACT || tier > ZIPF_LOG_FASTEST)
+   {
+      fprintf(stderr, "Unknown log accuracy tier (%d).\n", tier);
+      exit(0);
+   }
+
+   __atomic_store_n(&zipfLogAccuracy, tier, __ATOMIC_RELAXED);
+}
+
+//*****************************************************************************
+// Returns the log accuracy tier set by setZipfLogAccuracy().
+//*****************************************************************************
+int getZipfLogAccuracy(void)
+{
+   return __atomic_load_n(&zipfLogAccuracy, __ATOMIC_RELAXED);
+}
+
+//*****************************************************************************
+// Runs run(argument, thread, numThreads) on numThreads threads (the
+// calling one being thread 0) and waits for all of them to return.
+//*****************************************************************************
+void runParallel(int numThreads, void (*run)(void *, int, int), void *argument)
+{
+   pthread_t threads[ZIPF_MAX_THREADS];
+   struct ParallelStart starts[ZIPF_MAX_THREADS];
+   int thread;
+
+   for(thread=1;thread<numThreads;thread++)
+   {
+      starts[thread].run        = run;
+      starts[thread].argument   = argument;
+      starts[thread].thread     = thread;
+      starts[thread].numThreads = numThreads;
+      if(pthread_create(&threads[thread], NULL, parallelStart, &starts[thread]) != 0)
+      {
+         fprintf(stderr, "Could not start thread %d of %d.\n", thread, numThreads);
+         exit(0);
+      }
+   }
+
+   run(argument, 0, numThreads);
+
+   for(thread=1;thread<numThreads;thread++)
+      pthread_join(threads[thread], NULL);
+}
+
+//*****************************************************************************
+// Supporting function for runParallel(); the start routine of each thread.
+//*****************************************************************************
+void *parallelStart(void *argument)
+{
+   struct ParallelStart *start = (struct ParallelStart *)argument;
+
+   start->run(start->argument, start->thread, start->numThreads);
+
+   return NULL;
+}
+
+//*****************************************************************************
+// Parallel version of countingSortCounts() and radixSortCounts() (as
+// selected by maxCount: the counting sort if it is at least 0). Each
+// thread tallies its own slice of the input, the tallies give every
+// (thread, digit) pair its place in the output, and the threads scatter
+// their slices independently, so the sort is stable and needs no locks.
+// The tallies hold numThreads times the number of digits.
+//*****************************************************************************
+void parallelSortCounts(double *counts, size_t numCounts, double *buffer, size_t *tallies, int64_t maxCount, int numThreads)
+{
+   size_t numDigits = maxCount >= 0 ? (size_t)maxCount + 1 : 1 << ZIPF_RADIX_BITS;
+   struct SortTask task;
+
+   task.counts    = counts;
+   task.buffer    = buffer;
+   task.numCounts = numCounts;
+   task.maxCount  = maxCount;
+   task.numDigits = numDigits;
+   task.tallies   = tallies;
+   pthread_barrier_init(&task.barrier, NULL, numThreads);
+
+   runParallel(numThreads, sortThread, &task);
+
+   pthread_barrier_destroy(&task.barrier);
+}
+
+//*****************************************************************************
+// Supporting function for parallelSortCounts(), run by each thread.
+//*****************************************************************************
+void sortThread(void *argument, int thread, int numThreads)
+{
+   static const int shifts[ZIPF_RADIX_PASSES] = { 0, 11, 22, 33, 44, 55 };
+   struct SortTask *task = (struct SortTask *)argument;
+   size_t numCounts = task->numCounts, numDigits = task->numDigits;
+   size_t first = numCounts / numThreads * thread + (numCounts % numThreads) * thread / numThreads;
+   size_t last  = numCounts / numThreads * (thread + 1) + (numCounts % numThreads) * (thread + 1) / numThreads;
+   size_t *tally = task->tallies + numDigits * thread;
+   double *from = task->counts, *to = task->buffer, *swap;
+   const unsigned long long mask = (1 << ZIPF_RADIX_BITS) - 1;
+   unsigned long long bits, firstDigit;
+   size_t index, digit, offset, total;
+   int pass, other;
+
+   if(task->maxCount >= 0)
+   {
+      // counting sort: tally the values of this slice, then fill the
+      // output positions of this slice (found from all tallies)
+      memset(tally, 0, sizeof(size_t) * numDigits);
+      for(index=first;index<last;index++)
+         tally[(int64_t)from[index]]++;
+
+      pthread_barrier_wait(&task->barrier);
+
+      for(digit=1,offset=0;digit<numDigits;digit++)
+      {
+         for(other=0,total=0;other<numThreads;other++)
+            total += task->tallies[numDigits * other + digit];
+
+         // values digit fill positions offset..offset+total-1; write the
+         // part of that range that falls within this slice
+         for(index=offset>first?offset:first;index<offset+total && index<last;index++)
+            task->buffer[index] = (double)digit;
+         offset += total;
+      }
+
+      pthread_barrier_wait(&task->barrier);
+
+      memcpy(task->counts + first, task->buffer + first, sizeof(double) * (last - first));
+      return;
+   }
+
+   for(pass=0;pass<ZIPF_RADIX_PASSES;pass++)
+   {
+      memset(tally, 0, sizeof(size_t) * numDigits);
+      for(index=first;index<last;index++)
+      {
+         memcpy(&bits, &from[index], sizeof(bits));
+         tally[(bits >> shifts[pass]) & mask]++;
+      }
+
+      pthread_barrier_wait(&task->barrier);
+
+      // skip the pass if every count has the same digit (all threads see
+      // the same tallies, so they all agree)
+      memcpy(&bits, &from[0], sizeof(bits));
+      firstDigit = (bits >> shifts[pass]) & mask;
+      for(other=0,total=0;other<numThreads;other++)
+         total += task->tallies[numDigits * other + firstDigit];
+
+      if(total == numCounts)
+      {
+         pthread_barrier_wait(&task->barrier);
+         continue;
+      }
+
+      // this thread's digit d goes after all smaller digits, and after
+      // digit d of the threads before it
+      size_t offsets[1 << ZIPF_RADIX_BITS];
+      for(digit=0,offset=0;digit<numDigits;digit++)
+      {
+         for(other=0;other<numThreads;other++)
+         {
+            if(other == thread)
+               offsets[digit] = offset;
+            offset += task->tallies[numDigits * other + digit];
+         }
+      }
+
+      for(index=first;index<last;index++)
+      {
+         memcpy(&bits, &from[index], sizeof(bits));
+         to[offsets[(bits >> shifts[pass]) & mask]++] = from[index];
+      }
+
+      // nobody may read the output or overwrite the tallies before
+      // everybody is done scattering
+      pthread_barrier_wait(&task->barrier);
+
+      swap = from; from = to; to = swap;
+   }
+
+   if(from != task->counts)
+      memcpy(task->counts + first, from + first, sizeof(double) * (last - first));
+}
+
+//*****************************************************************************
+// Block kernels used by getSlopeR2(). Each one comes in a scalar version and,
+// on x86 with GCC or clang, AVX2 and AVX-512 versions selected at runtime
+// according to what the CPU supports.
+//
+// The vectorized log10() splits x into 2^e * m (sqrt(1/2) <= m < sqrt(2)) and
+// evaluates log(m) = 2 f (1 + f^2/3 + f^4/5 + ...), f = (m-1)/(m+1), which for
+// |f| <= 0.1716 converges to double precision after the f^20 term.
+// The split only holds for normal, finite inputs: AVX-512's getexp/getmant
+// handle the others, while the AVX2 kernels hand the lanes holding
+// subnormals, infinities, NaNs, zeros or negatives to libm (see
+// patchLog10Avx2()), so every path returns the same for them.
+//*****************************************************************************
+
+#ifdef ZIPF_X86_SIMD
+
+#define ZIPF_LN2      0.693147180559945309417232121458
+#define ZIPF_INV_LN10 0.434294481903251827651128918917
+
+__attribute__((target("avx2,fma")))
+static __m256d log10Avx2(__m256d x)
+{
+   const __m256d one = _mm256_set1_pd(1.0);
+   __m256i bits = _mm256_castpd_si256(x);
+
+   // mantissa in [1, 2) and unbiased exponent (converted through the 2^52 trick,
+   // since AVX2 has no int64 -> double conversion)
+   __m256d m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+                                                   _mm256_set1_epi64x(0x3FF0000000000000LL)));
+   __m256d e = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52),
+                                                                 _mm256_set1_epi64x(0x4330000000000000LL))),
+                             _mm256_set1_pd(4503599627370496.0 + 1023.0));
+
+   // move m into [sqrt(1/2), sqrt(2))
+   __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(ZIPF_SQRT2), _CMP_GT_OQ);
+   m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+   e = _mm256_add_pd(e, _mm256_and_pd(big, one));
+
+   __m256d f = _mm256_div_pd(_mm256_sub_pd(m, one), _mm256_add_pd(m, one));
+   __m256d s = _mm256_mul_pd(f, f);
+   __m256d p = _mm256_set1_pd(1.0 / 21);
+   p = _mm256_fmadd_pd(p, s, _mm256_set1_pd(1.0 / 19));
+   p = _mm256_fmadd_pd(p, s, _mm256_set1_pd(1.0 / 17));
+   p = _mm256_fmadd_pd(p, s, _mm256_set1_pd(1.0 / 15));
+   p = _mm256_fmadd_pd(p, s, _mm256_set1_pd(1.0 / 13));
+   p = _mm256_fmadd_pd(p, s, _mm256_set1_pd(1.0 / 11));
+   p = _mm256_fmadd_pd(p, s, _mm256_set1_pd(1.0 / 9));
+   p = _mm256_fmadd_pd(p, s, _mm256_set1_pd(1.0 / 7));
+   p = _mm256_fmadd_pd(p, s, _mm256_set1_pd(1.0 / 5));
+   p = _mm256_fmadd_pd(p, s, _mm256_set1_pd(1.0 / 3));
+   p = _mm256_fmadd_pd(p, s, one);
+
+   __m256d lnm = _mm256_mul_pd(_mm256_add_pd(f, f), p);
+   return _mm256_mul_pd(_mm256_fmadd_pd(e, _mm256_set1_pd(ZIPF_LN2), lnm), _mm256_set1_pd(ZIPF_INV_LN10));
+}
+
+__attribute__((target("avx512f")))
+static __m512d log10Avx512(__m512d x)
+{
+   const __m512d one = _mm512_set1_pd(1.0);
+
+   // getmant/getexp give m in [1, 2) and the unbiased exponent directly,
+   // subnormals included (and m = NaN for negatives)
+   __m512d m = _mm512_getmant_pd(x, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_nan);
+   __m512d e = _mm512_getexp_pd(x);
+
+   // move m into [sqrt(1/2), sqrt(2))
+   __mmask8 big = _mm512_cmp_pd_mask(m, _mm512_set1_pd(ZIPF_SQRT2), _CMP_GT_OQ);
+   m = _mm512_mask_mul_pd(m, big, m, _mm512_set1_pd(0.5));
+   e = _mm512_mask_add_pd(e, big, e, one);
+
+   __m512d f = _mm512_div_pd(_mm512_sub_pd(m, one), _mm512_add_pd(m, one));
+   __m512d s = _mm512_mul_pd(f, f);
+   __m512d p = _mm512_set1_pd(1.0 / 21);
+   p = _mm512_fmadd_pd(p, s, _mm512_set1_pd(1.0 / 19));
+   p = _mm512_fmadd_pd(p, s, _mm512_set1_pd(1.0 / 17));
+   p = _mm512_fmadd_pd(p, s, _mm512_set1_pd(1.0 / 15));
+   p = _mm512_fmadd_pd(p, s, _mm512_set1_pd(1.0 / 13));
+   p = _mm512_fmadd_pd(p, s, _mm512_set1_pd(1.0 / 11));
+   p = _mm512_fmadd_pd(p, s, _mm512_set1_pd(1.0 / 9));
+   p = _mm512_fmadd_pd(p, s, _mm512_set1_pd(1.0 / 7));
+   p = _mm512_fmadd_pd(p, s, _mm512_set1_pd(1.0 / 5));
+   p = _mm512_fmadd_pd(p, s, _mm512_set1_pd(1.0 / 3));
+   p = _mm512_fmadd_pd(p, s, one);
+
+   __m512d lnm = _mm512_mul_pd(_mm512_add_pd(f, f), p);
+   return _mm512_mul_pd(_mm512_fmadd_pd(e, _mm512_set1_pd(ZIPF_LN2), lnm), _mm512_set1_pd(ZIPF_INV_LN10));
+}
+
+// Overwrites with libm's log10() the first n lanes of out[] whose inputs
+// x (loaded from in[]) are outside the normal, finite, positive doubles.
+__attribute__((target("avx2")))
+static inline void patchLog10Avx2(__m256d x, const double *in, double *out, int n)
+{
+   __m256d normal = _mm256_and_pd(_mm256_cmp_pd(x, _mm256_set1_pd(DBL_MIN), _CMP_GE_OQ),
+                                  _mm256_cmp_pd(x, _mm256_set1_pd(DBL_MAX), _CMP_LE_OQ));
+   int special = ~_mm256_movemask_pd(normal) & ((1 << n) - 1);
+
+   for(;special;special&=special-1)
+      out[__builtin_ctz(special)] = log10(in[__builtin_ctz(special)]);
+}
+
+__attribute__((target("avx2,fma")))
+static void log10BlockAvx2(const double *in, double *out, int n)
+{
+   int i;
+   for(i=0;i+4<=n;i+=4)
+   {
+      __m256d x = _mm256_loadu_pd(in + i);
+      _mm256_storeu_pd(out + i, log10Avx2(x));
+      patchLog10Avx2(x, in + i, out + i, 4);
+   }
+
+   for(;i<n;i++)
+      out[i] = log10(in[i]);
+}
+
+__attribute__((target("avx512f")))
+static void log10BlockAvx512(const double *in, double *out, int n)
+{
+   int i;
+   for(i=0;i+8<=n;i+=8)
+      _mm512_storeu_pd(out + i, log10Avx512(_mm512_loadu_pd(in + i)));
+
+   // the last partial vector is handled with a mask rather than libm,
+   // so every element of the block goes through the same log10()
+   if(i < n)
+   {
+      __mmask8 tail = (__mmask8)((1u << (n - i)) - 1);
+      __m512d x = _mm512_mask_loadu_pd(_mm512_set1_pd(1.0), tail, in + i);
+      _mm512_mask_storeu_pd(out + i, tail, log10Avx512(x));
+   }
+}
+
+// The approximate log10()s of approxLog10Block() split x into 2^e * m
+// (sqrt(1/2) <= m < sqrt(2)) as above and evaluate the tier's polynomial
+// in t = m - 1 (inputs outside the normal doubles are log'ed exactly).
+__attribute__((target("avx2,fma")))
+static void approxLog10BlockAvx2(const double *in, double *out, int n, const double *coefficients, int degree)
+{
+   const __m256d one = _mm256_set1_pd(1.0);
+   int i, k;
+
+   for(i=0;i<n;i+=4)
+   {
+      // the last partial vector is masked (its other lanes are log'ed as 0
+      // but not stored)
+      __m256i lanes = _mm256_cmpgt_epi64(_mm256_set1_epi64x(n - i), _mm256_setr_epi64x(0, 1, 2, 3));
+      __m256d x = _mm256_maskload_pd(in + i, lanes);
+      __m256i bits = _mm256_castpd_si256(x);
+      __m256d m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+                                                      _mm256_set1_epi64x(0x3FF0000000000000LL)));
+      __m256d e = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52),
+                                                                    _mm256_set1_epi64x(0x4330000000000000LL))),
+                                _mm256_set1_pd(4503599627370496.0 + 1023.0));
+      __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(ZIPF_SQRT2), _CMP_GT_OQ);
+      m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+      e = _mm256_add_pd(e, _mm256_and_pd(big, one));
+
+      __m256d t = _mm256_sub_pd(m, one);
+      __m256d p = _mm256_set1_pd(coefficients[degree]);
+      for(k=degree-1;k>=0;k--)
+         p = _mm256_fmadd_pd(p, t, _mm256_set1_pd(coefficients[k]));
+
+      _mm256_maskstore_pd(out + i, lanes, _mm256_fmadd_pd(e, _mm256_set1_pd(ZIPF_LOG10_2), _mm256_mul_pd(t, p)));
+      patchLog10Avx2(x, in + i, out + i, n - i < 4 ? n - i : 4);
+   }
+}
+
+__attribute__((target("avx512f")))
+static void approxLog10BlockAvx512(const double *in, double *out, int n, const double *coefficients, int degree)
+{
+   const __m512d one = _mm512_set1_pd(1.0);
+   int i, k;
+
+   for(i=0;i<n;i+=8)
+   {
+      __mmask8 lanes = n - i >= 8 ? 0xFF : (__mmask8)((1u << (n - i)) - 1);
+      __m512d x = _mm512_mask_loadu_pd(one, lanes, in + i);
+      __m512d m = _mm512_getmant_pd(x, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_nan);
+      __m512d e = _mm512_getexp_pd(x);
+      __mmask8 big = _mm512_cmp_pd_mask(m, _mm512_set1_pd(ZIPF_SQRT2), _CMP_GT_OQ);
+      m = _mm512_mask_mul_pd(m, big, m, _mm512_set1_pd(0.5));
+      e = _mm512_mask_add_pd(e, big, e, one);
+
+      __m512d t = _mm512_sub_pd(m, one);
+      __m512d p = _mm512_set1_pd(coefficients[degree]);
+      for(k=degree-1;k>=0;k--)
+         p = _mm512_fmadd_pd(p, t, _mm512_set1_pd(coefficients[k]));
+
+      _mm512_mask_storeu_pd(out + i, lanes, _mm512_fmadd_pd(e, _mm512_set1_pd(ZIPF_LOG10_2), _mm512_mul_pd(t, p)));
+   }
+}
+
+// The vectorized exp() of expBlock() splits x into k ln2 + r (|r| <= ln2/2,
+// with ln2 in two parts so that r is exact) and evaluates e^r by its Taylor
+// series up to r^12 (within an ulp or so of libm). Lanes outside
+// [-708, 709], where 2^k is not a normal double (or r not exact), are
+// handed to libm.
+#define ZIPF_LOG2_E  1.44269504088896340735992468100
+#define ZIPF_LN2_HIGH 6.93147180369123816490e-01
+#define ZIPF_LN2_LOW  1.90821492927058770002e-10
+
+static const double zipfExpCoefficients[13] =
+{
+   1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040, 1.0 / 40320, 1.0 / 362880,
+   1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600
+};
+
+__attribute__((target("avx2,fma")))
+static __m256d expAvx2(__m256d x, __m256d *k)
+{
+   __m256d r, p;
+   int j;
+
+   *k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(ZIPF_LOG2_E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+   r = _mm256_fnmadd_pd(*k, _mm256_set1_pd(ZIPF_LN2_HIGH), x);
+   r = _mm256_fnmadd_pd(*k, _mm256_set1_pd(ZIPF_LN2_LOW), r);
+
+   p = _mm256_set1_pd(zipfExpCoefficients[12]);
+   for(j=11;j>=0;j--)
+      p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(zipfExpCoefficients[j]));
+
+   return p;
+}
+
+__attribute__((target("avx2,fma")))
+static void expBlockAvx2(const double *in, double *out, int n)
+{
+   int i, special;
+
+   for(i=0;i<n;i+=4)
+   {
+      __m256i lanes = _mm256_cmpgt_epi64(_mm256_set1_epi64x(n - i), _mm256_setr_epi64x(0, 1, 2, 3));
+      __m256d x = _mm256_maskload_pd(in + i, lanes), k;
+      __m256d p = expAvx2(x, &k);
+
+      // 2^k from k + 1023 put in the exponent bits (converted through the
+      // 2^52 trick, since AVX2 has no double -> int64 conversion)
+      __m256i e = _mm256_slli_epi64(_mm256_castpd_si256(_mm256_add_pd(k, _mm256_set1_pd(4503599627370496.0 + 1023.0))), 52);
+      _mm256_maskstore_pd(out + i, lanes, _mm256_mul_pd(p, _mm256_castsi256_pd(e)));
+
+      __m256d normal = _mm256_and_pd(_mm256_cmp_pd(x, _mm256_set1_pd(-708.0), _CMP_GE_OQ),
+                                     _mm256_cmp_pd(x, _mm256_set1_pd(709.0), _CMP_LE_OQ));
+      special = ~_mm256_movemask_pd(normal) & ((1 << (n - i < 4 ? n - i : 4)) - 1);
+      for(;special;special&=special-1)
+         out[i + __builtin_ctz(special)] = exp(in[i + __builtin_ctz(special)]);
+   }
+}
+
+__attribute__((target("avx512f")))
+static void expBlockAvx512(const double *in, double *out, int n)
+{
+   int i, j, special;
+
+   for(i=0;i<n;i+=8)
+   {
+      __mmask8 lanes = n - i >= 8 ? 0xFF : (__mmask8)((1u << (n - i)) - 1);
+      __m512d x = _mm512_mask_loadu_pd(_mm512_setzero_pd(), lanes, in + i);
+      __m512d k = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(ZIPF_LOG2_E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+      __m512d r = _mm512_fnmadd_pd(k, _mm512_set1_pd(ZIPF_LN2_HIGH), x);
+      r = _mm512_fnmadd_pd(k, _mm512_set1_pd(ZIPF_LN2_LOW), r);
+
+      __m512d p = _mm512_set1_pd(zipfExpCoefficients[12]);
+      for(j=11;j>=0;j--)
+         p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(zipfExpCoefficients[j]));
+
+      _mm512_mask_storeu_pd(out + i, lanes, _mm512_scalef_pd(p, k));
+
+      special = lanes & ~(_mm512_cmp_pd_mask(x, _mm512_set1_pd(-708.0), _CMP_GE_OQ) &
+                          _mm512_cmp_pd_mask(x, _mm512_set1_pd(709.0), _CMP_LE_OQ));
+      for(;special;special&=special-1)
+         out[i + __builtin_ctz(special)] = exp(in[i + __builtin_ctz(special)]);
+   }
+}
+
+// The table lookups of countLogBlock() convert the counts to int32 indices
+// (they are at most ZIPF_COUNT_LOG_TABLE_MAX) and gather the logs, only in
+// the lanes that hold an integer in [1, maxCount], so nothing outside the
+// table is read.
+__attribute__((target("avx2")))
+static int countLogBlockAvx2(const double *in, double *out, int n, const double *logs, double maxCount)
+{
+   const __m256d one = _mm256_set1_pd(1.0), max = _mm256_set1_pd(maxCount);
+   __m256d valid = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+   int i;
+
+   for(i=0;i+4<=n;i+=4)
+   {
+      __m256d x = _mm256_loadu_pd(in + i);
+      __m128i index = _mm256_cvttpd_epi32(x);
+      __m256d ok = _mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(x, one, _CMP_GE_OQ), _mm256_cmp_pd(x, max, _CMP_LE_OQ)),
+                                 _mm256_cmp_pd(_mm256_cvtepi32_pd(index), x, _CMP_EQ_OQ));
+      valid = _mm256_and_pd(valid, ok);
+      _mm256_storeu_pd(out + i, _mm256_mask_i32gather_pd(one, logs, index, ok, 8));
+   }
+
+   for(;i<n;i++)
+   {
+      if(!(in[i] >= 1.0 && in[i] <= maxCount) || (double)(size_t)in[i] != in[i])
+         return FALSE;
+      out[i] = logs[(size_t)in[i]];
+   }
+
+   return _mm256_movemask_pd(valid) == 0xF;
+}
+
+__attribute__((target("avx512f")))
+static int countLogBlockAvx512(const double *in, double *out, int n, const double *logs, double maxCount)
+{
+   const __m512d one = _mm512_set1_pd(1.0), max = _mm512_set1_pd(maxCount);
+   __mmask8 valid = 0xFF;
+   int i;
+
+   for(i=0;i<n;i+=8)
+   {
+      __mmask8 lanes = n - i >= 8 ? 0xFF : (__mmask8)((1u << (n - i)) - 1);
+      __m512d x = _mm512_mask_loadu_pd(one, lanes, in + i);
+      __m256i index = _mm512_cvttpd_epi32(x);
+      __mmask8 ok = _mm512_cmp_pd_mask(x, one, _CMP_GE_OQ) & _mm512_cmp_pd_mask(x, max, _CMP_LE_OQ)
+                  & _mm512_cmp_pd_mask(_mm512_cvtepi32_pd(index), x, _CMP_EQ_OQ);
+      valid &= ok;
+      _mm512_mask_storeu_pd(out + i, lanes, _mm512_mask_i32gather_pd(one, ok, index, logs, 8));
+   }
+
+   return valid == 0xFF;
+}
+
+__attribute__((target("avx2")))
+static void rangeBlockAvx2(const double *in, int n, double *min, double *max)
+{
+   __m256d lo = _mm256_set1_pd(HUGE_VAL), hi = _mm256_set1_pd(-HUGE_VAL);
+   double lanes[2][4];
+   int i, lane;
+
+   for(i=0;i+4<=n;i+=4)
+   {
+      __m256d x = _mm256_loadu_pd(in + i);
+      lo = _mm256_min_pd(lo, x);
+      hi = _mm256_max_pd(hi, x);
+   }
+
+   _mm256_storeu_pd(lanes[0], lo);
+   _mm256_storeu_pd(lanes[1], hi);
+   *min = HUGE_VAL;
+   *max = -HUGE_VAL;
+   for(lane=0;lane<4;lane++)
+   {
+      if(lanes[0][lane] < *min) *min = lanes[0][lane];
+      if(lanes[1][lane] > *max) *max = lanes[1][lane];
+   }
+
+   for(;i<n;i++)
+   {
+      if(in[i] < *min) *min = in[i];
+      if(in[i] > *max) *max = in[i];
+   }
+}
+
+__attribute__((target("avx512f")))
+static void rangeBlockAvx512(const double *in, int n, double *min, double *max)
+{
+   __m512d lo = _mm512_set1_pd(HUGE_VAL), hi = _mm512_set1_pd(-HUGE_VAL);
+   int i;
+
+   for(i=0;i<n;i+=8)
+   {
+      __mmask8 live = n - i >= 8 ? (__mmask8)0xFF : (__mmask8)((1u << (n - i)) - 1);
+      lo = _mm512_mask_min_pd(lo, live, lo, _mm512_maskz_loadu_pd(live, in + i));
+      hi = _mm512_mask_max_pd(hi, live, hi, _mm512_maskz_loadu_pd(live, in + i));
+   }
+
+   *min = _mm512_reduce_min_pd(lo);
+   *max = _mm512_reduce_max_pd(hi);
+}
+
+__attribute__((target("avx2,fma")))
+static void accumulateLogBlockAvx2(const double *logX, const double *logY, int n, struct ZipfSums *sums)
+{
+   __m256d sx = _mm256_setzero_pd(), sy = _mm256_setzero_pd(), sxy = _mm256_setzero_pd();
+   __m256d sx2 = _mm256_setzero_pd(), sy2 = _mm256_setzero_pd();
+   double lanes[5][4];
+   int i, lane;
+
+   for(i=0;i+4<=n;i+=4)
+   {
+      __m256d x = _mm256_loadu_pd(logX + i);
+      __m256d y = _mm256_loadu_pd(logY + i);
+      sx  = _mm256_add_pd(sx, x);
+      sy  = _mm256_add_pd(sy, y);
+      sxy = _mm256_fmadd_pd(x, y, sxy);
+      sx2 = _mm256_fmadd_pd(x, x, sx2);
+      sy2 = _mm256_fmadd_pd(y, y, sy2);
+   }
+
+   _mm256_storeu_pd(lanes[0], sx);
+   _mm256_storeu_pd(lanes[1], sy);
+   _mm256_storeu_pd(lanes[2], sxy);
+   _mm256_storeu_pd(lanes[3], sx2);
+   _mm256_storeu_pd(lanes[4], sy2);
+   for(lane=0;lane<4;lane++)
+   {
+      sums->sumX  += lanes[0][lane];
+      sums->sumY  += lanes[1][lane];
+      sums->sumXY += lanes[2][lane];
+      sums->sumX2 += lanes[3][lane];
+      sums->sumY2 += lanes[4][lane];
+   }
+
+   for(;i<n;i++)
+   {
+      sums->sumX  += logX[i];
+      sums->sumY  += logY[i];
+      sums->sumXY += logX[i] * logY[i];
+      sums->sumX2 += logX[i] * logX[i];
+      sums->sumY2 += logY[i] * logY[i];
+   }
+}
+
+__attribute__((target("avx512f")))
+static void accumulateLogBlockAvx512(const double *logX, const double *logY, int n, struct ZipfSums *sums)
+{
+   __m512d sx = _mm512_setzero_pd(), sy = _mm512_setzero_pd(), sxy = _mm512_setzero_pd();
+   __m512d sx2 = _mm512_setzero_pd(), sy2 = _mm512_setzero_pd();
+   int i;
+
+   for(i=0;i<n;i+=8)
+   {
+      // masked loads zero the lanes past the end, which then add nothing
+      __mmask8 live = n - i >= 8 ? (__mmask8)0xFF : (__mmask8)((1u << (n - i)) - 1);
+      __m512d x = _mm512_maskz_loadu_pd(live, logX + i);
+      __m512d y = _mm512_maskz_loadu_pd(live, logY + i);
+      sx  = _mm512_add_pd(sx, x);
+      sy  = _mm512_add_pd(sy, y);
+      sxy = _mm512_fmadd_pd(x, y, sxy);
+      sx2 = _mm512_fmadd_pd(x, x, sx2);
+      sy2 = _mm512_fmadd_pd(y, y, sy2);
+   }
+
+   sums->sumX  += _mm512_reduce_add_pd(sx);
+   sums->sumY  += _mm512_reduce_add_pd(sy);
+   sums->sumXY += _mm512_reduce_add_pd(sxy);
+   sums->sumX2 += _mm512_reduce_add_pd(sx2);
+   sums->sumY2 += _mm512_reduce_add_pd(sy2);
+}
+
+__attribute__((target("avx2")))
+static void sortLanesAvx2(double *block, const uint16_t *comparators, int numComparators)
+{
+   int c, half;
+
+   for(c=0;c<numComparators;c++)
+      for(half=0;half<ZIPF_LANES;half+=4)
+      {
+         double *lo = block + comparators[2 * c] * ZIPF_LANES + half;
+         double *hi = block + comparators[2 * c + 1] * ZIPF_LANES + half;
+         __m256d a = _mm256_loadu_pd(lo), b = _mm256_loadu_pd(hi);
+         _mm256_storeu_pd(lo, _mm256_min_pd(a, b));
+         _mm256_storeu_pd(hi, _mm256_max_pd(a, b));
+      }
+}
+
+__attribute__((target("avx512f")))
+static void sortLanesAvx512(double *block, const uint16_t *comparators, int numComparators)
+{
+   int c;
+
+   for(c=0;c<numComparators;c++)
+   {
+      double *lo = block + comparators[2 * c] * ZIPF_LANES;
+      double *hi = block + comparators[2 * c + 1] * ZIPF_LANES;
+      __m512d a = _mm512_loadu_pd(lo), b = _mm512_loadu_pd(hi);
+      _mm512_storeu_pd(lo, _mm512_min_pd(a, b));
+      _mm512_storeu_pd(hi, _mm512_max_pd(a, b));
+   }
+}
+
+__attribute__((target("avx2,fma")))
+static void accumulateLanesAvx2(const double *logs, const double *rankLogs, int numBins, double (*sums)[ZIPF_LANES])
+{
+   int bin, half;
+
+   for(half=0;half<ZIPF_LANES;half+=4)
+   {
+      __m256d sy = _mm256_setzero_pd(), sxy = _mm256_setzero_pd(), sy2 = _mm256_setzero_pd();
+
+      for(bin=0;bin<numBins;bin++)
+      {
+         __m256d x = _mm256_set1_pd(rankLogs[numBins - bin]);
+         __m256d y = _mm256_loadu_pd(logs + bin * ZIPF_LANES + half);
+         sy  = _mm256_add_pd(sy, y);
+         sxy = _mm256_fmadd_pd(x, y, sxy);
+         sy2 = _mm256_fmadd_pd(y, y, sy2);
+      }
+
+      _mm256_storeu_pd(sums[0] + half, sy);
+      _mm256_storeu_pd(sums[1] + half, sxy);
+      _mm256_storeu_pd(sums[2] + half, sy2);
+   }
+}
+
+__attribute__((target("avx512f")))
+static void accumulateLanesAvx512(const double *logs, const double *rankLogs, int numBins, double (*sums)[ZIPF_LANES])
+{
+   __m512d sy = _mm512_setzero_pd(), sxy = _mm512_setzero_pd(), sy2 = _mm512_setzero_pd();
+   int bin;
+
+   for(bin=0;bin<numBins;bin++)
+   {
+      __m512d x = _mm512_set1_pd(rankLogs[numBins - bin]);
+      __m512d y = _mm512_loadu_pd(logs + bin * ZIPF_LANES);
+      sy  = _mm512_add_pd(sy, y);
+      sxy = _mm512_fmadd_pd(x, y, sxy);
+      sy2 = _mm512_fmadd_pd(y, y, sy2);
+   }
+
+   _mm512_storeu_pd(sums[0], sy);
+   _mm512_storeu_pd(sums[1], sxy);
+   _mm512_storeu_pd(sums[2], sy2);
+}
+
+__attribute__((target("avx2")))
+static void tokenMaskBlockAvx2(const unsigned char *in, size_t n, uint64_t *masks)
+{
+   const __m256i zero = _mm256_setzero_si256();
+   size_t i, half;
+
+   for(i=0;i+64<=n;i+=64)
+   {
+      uint64_t mask = 0;
+
+      for(half=0;half<2;half++)
+      {
+         __m256i c = _mm256_loadu_si256((const __m256i *)(in + i + 32 * half));
+         __m256i digit  = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+         __m256i letter = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+
+         // x <= k (unsigned) exactly when min(x, k) == x; bytes 0x80-0xFF
+         // are picked up by their sign bits
+         digit  = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+         letter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(25)), letter);
+         __m256i token = _mm256_or_si256(_mm256_or_si256(digit, letter), _mm256_cmpgt_epi8(zero, c));
+
+         mask |= (uint64_t)(uint32_t)_mm256_movemask_epi8(token) << (32 * half);
+      }
+
+      masks[i / 64] = mask;
+   }
+}
+
+#endif // ZIPF_X86_SIMD
+
+//*****************************************************************************
+// Stores log10() of the n values of in[] into out[].
+//*****************************************************************************
+void log10Block(const double *in, double *out, int n)
+{
+   int tier = getZipfLogAccuracy();
+
+   if(tier != ZIPF_LOG_EXACT)
+   {
+      approxLog10Block(in, out, n, tier);
+      return;
+   }
+
+#ifdef ZIPF_X86_SIMD
+   __builtin_cpu_init();
+   if(__builtin_cpu_supports("avx512f"))
+   {
+      log10BlockAvx512(in, out, n);
+      return;
+   }
+   if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+   {
+      log10BlockAvx2(in, out, n);
+      return;
+   }
+#endif
+
+   int i;
+   for(i=0;i<n;i++)
+      out[i] = log10(in[i]);
+}
+
+//*****************************************************************************
+// Stores the approximate log10() of the given tier (see setZipfLogAccuracy())
+// of the n values of in[] into out[]. Subnormals, infinities, NaNs, zeros
+// and negatives, outside the polynomials' domain, get libm's log10().
+//*****************************************************************************
+void approxLog10Block(const double *in, double *out, int n, int tier)
+{
+   const double *coefficients = zipfLogCoefficients[tier - 1];
+   int degree = zipfLogDegrees[tier - 1];
+   int start, i, k;
+
+#ifdef ZIPF_X86_SIMD
+   __builtin_cpu_init();
+   if(__builtin_cpu_supports("avx512f"))
+   {
+      approxLog10BlockAvx512(in, out, n, coefficients, degree);
+      return;
+   }
+   if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+   {
+      approxLog10BlockAvx2(in, out, n, coefficients, degree);
+      return;
+   }
+#endif
+
+   // a sub-block at a time, each step for all its values, so that the
+   // polynomials are evaluated side by side rather than one after another
+   for(start=0;start<n;start+=64)
+   {
+      int length = n - start < 64 ? n - start : 64;
+      double t[64], p[64], exponent[64];
+
+      for(i=0;i<length;i++)
+      {
+         uint64_t bits;
+         double m;
+
+         memcpy(&bits, &in[start + i], sizeof(double));
+         exponent[i] = (double)((int)(bits >> 52) - 1023);
+         bits = (bits & 0x000FFFFFFFFFFFFFULL) | 0x3FF0000000000000ULL;
+         memcpy(&m, &bits, sizeof(double));
+         if(m > ZIPF_SQRT2)
+         {
+            m *= 0.5;
+            exponent[i] += 1.0;
+         }
+         t[i] = m - 1.0;
+         p[i] = coefficients[degree];
+      }
+
+      for(k=degree-1;k>=0;k--)
+         for(i=0;i<length;i++)
+            p[i] = p[i] * t[i] + coefficients[k];
+
+      for(i=0;i<length;i++)
+         out[start + i] = exponent[i] * ZIPF_LOG10_2 + t[i] * p[i];
+   }
+
+   for(i=0;i<n;i++)
+      if(!(in[i] >= DBL_MIN && in[i] <= DBL_MAX))
+         out[i] = log10(in[i]);
+}
+
+//*****************************************************************************
+// Stores exp() of the n values of in[] into out[], which may be in[]
+// itself (see powerLawDistance()).
+//*****************************************************************************
+void expBlock(const double *in, double *out, int n)
+{
+   int i;
+
+#ifdef ZIPF_X86_SIMD
+   __builtin_cpu_init();
+   if(__builtin_cpu_supports("avx512f"))
+   {
+      expBlockAvx512(in, out, n);
+      return;
+   }
+   if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+   {
+      expBlockAvx2(in, out, n);
+      return;
+   }
+#endif
+
+   for(i=0;i<n;i++)
+      out[i] = exp(in[i]);
+}
+
+//*****************************************************************************
+// Stores log10() of the n counts of in[] into out[], looking them up in the
+// shared table of log10() of the integers (see getRankLogTable()), and
+// returns TRUE, if they are all integers from 1 to ZIPF_COUNT_LOG_TABLE_MAX
+// (minCount and maxCount being their range). Returns FALSE otherwise, and
+// the caller logs them with log10Block().
+//
+// The table holds libm's log10(), so looked-up logs are correctly rounded
+// where the vectorized log10() is a few ulps off.
+//*****************************************************************************
+int countLogBlock(const double *in, double *out, int n, double minCount, double maxCount)
+{
+   const struct RankLogTable *table;
+   const double *logs;
+   int index;
+
+   // false for NaNs too
+   if(!(minCount >= 1.0 && maxCount <= ZIPF_COUNT_LOG_TABLE_MAX))
+      return FALSE;
+
+   // (only NULL past ZIPF_RANK_LOG_TABLE_MAX, which the bound above rules out)
+   if((table = getRankLogTable((size_t)maxCount)) == NULL)
+      return FALSE;
+   logs = table->logs;
+
+#ifdef ZIPF_X86_SIMD
+   __builtin_cpu_init();
+   if(__builtin_cpu_supports("avx512f"))
+      return countLogBlockAvx512(in, out, n, logs, maxCount);
+   if(__builtin_cpu_supports("avx2"))
+      return countLogBlockAvx2(in, out, n, logs, maxCount);
+#endif
+
+   for(index=0;index<n;index++)
+   {
+      double count = in[index];
+      size_t integer = (size_t)count;
+
+      // the range check keeps the cast defined if minCount/maxCount
+      // missed a NaN
+      if(!(count >= 1.0 && count <= maxCount) || (double)integer != count)
+         return FALSE;
+
+      out[index] = logs[integer];
+   }
+
+   return TRUE;
+}
+
+//*****************************************************************************
+// Finds the smallest and largest of the n values of in[].
+//*****************************************************************************
+void rangeBlock(const double *in, int n, double *min, double *max)
+{
+#ifdef ZIPF_X86_SIMD
+   __builtin_cpu_init();
+   if(__builtin_cpu_supports("avx512f"))
+   {
+      rangeBlockAvx512(in, n, min, max);
+      return;
+   }
+   if(__builtin_cpu_supports("avx2"))
+   {
+      rangeBlockAvx2(in, n, min, max);
+      return;
+   }
+#endif
+
+   int i;
+   *min = HUGE_VAL;
+   *max = -HUGE_VAL;
+   for(i=0;i<n;i++)
+   {
+      if(in[i] < *min) *min = in[i];
+      if(in[i] > *max) *max = in[i];
+   }
+}
+
+//*****************************************************************************
+// Adds the n (already log'ed) points of logX[] and logY[] into the
+// regression sums.
+//*****************************************************************************
+void accumulateLogBlock(const double *logX, const double *logY, int n, struct ZipfSums *sums)
+{
+#ifdef ZIPF_X86_SIMD
+   __builtin_cpu_init();
+   if(__builtin_cpu_supports("avx512f"))
+   {
+      accumulateLogBlockAvx512(logX, logY, n, sums);
+      return;
+   }
+   if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+   {
+      accumulateLogBlockAvx2(logX, logY, n, sums);
+      return;
+   }
+#endif
+
+   int i;
+   for(i=0;i<n;i++)
+   {
+      sums->sumX  += logX[i];
+      sums->sumY  += logY[i];
+      sums->sumXY += logX[i] * logY[i];
+      sums->sumX2 += logX[i] * logX[i];
+      sums->sumY2 += logY[i] * logY[i];
+   }
+}
+
+//*****************************************************************************
+// Sorts each lane of a bins x ZIPF_LANES block (bin-major) in ascending
+// order, by applying the comparators of sortingNetwork() to whole rows.
+//*****************************************************************************
+void sortLanes(double *block, const uint16_t *comparators, int numComparators)
+{
+#ifdef ZIPF_X86_SIMD
+   __builtin_cpu_init();
+   if(__builtin_cpu_supports("avx512f"))
+   {
+      sortLanesAvx512(block, comparators, numComparators);
+      return;
+   }
+   if(__builtin_cpu_supports("avx2"))
+   {
+      sortLanesAvx2(block, comparators, numComparators);
+      return;
+   }
+#endif
+
+   int c, lane;
+   for(c=0;c<numComparators;c++)
+   {
+      double *lo = block + comparators[2 * c] * ZIPF_LANES;
+      double *hi = block + comparators[2 * c + 1] * ZIPF_LANES;
+      for(lane=0;lane<ZIPF_LANES;lane++)
+      {
+         double a = lo[lane], b = hi[lane];
+         lo[lane] = b < a ? b : a;
+         hi[lane] = b < a ? a : b;
+      }
+   }
+}
+
+//*****************************************************************************
+// Adds up sumY, sumXY and sumY2 of each lane of a sorted bins x ZIPF_LANES
+// block of logs into sums[0], sums[1] and sums[2]; bin b has the implicit
+// rank numBins - b, whose log10() is rankLogs[numBins - b].
+//*****************************************************************************
+void accumulateLanes(const double *logs, const double *rankLogs, int numBins, double (*sums)[ZIPF_LANES])
+{
+#ifdef ZIPF_X86_SIMD
+   __builtin_cpu_init();
+   if(__builtin_cpu_supports("avx512f"))
+   {
+      accumulateLanesAvx512(logs, rankLogs, numBins, sums);
+      return;
+   }
+   if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+   {
+      accumulateLanesAvx2(logs, rankLogs, numBins, sums);
+      return;
+   }
+#endif
+
+   int bin, lane;
+   for(lane=0;lane<ZIPF_LANES;lane++)
+      sums[0][lane] = sums[1][lane] = sums[2][lane] = 0.0;
+
+   for(bin=0;bin<numBins;bin++)
+      for(lane=0;lane<ZIPF_LANES;lane++)
+      {
+         double x = rankLogs[numBins - bin], y = logs[bin * ZIPF_LANES + lane];
+         sums[0][lane] += y;
+         sums[1][lane] += x * y;
+         sums[2][lane] += y * y;
+      }
+}
+
+//*****************************************************************************
+// Classifies the n bytes of in[] (see isTokenByte()) into masks[], one bit
+// per byte, 64 bytes per mask; the bits past n are cleared.
+//*****************************************************************************
+void tokenMaskBlock(const unsigned char *in, size_t n, uint64_t *masks)
+{
+   size_t i = 0;
+
+#ifdef ZIPF_X86_SIMD
+   __builtin_cpu_init();
+   if(__builtin_cpu_supports("avx2"))
+   {
+      tokenMaskBlockAvx2(in, n, masks);
+      i = n & ~(size_t)63;
+   }
+#endif
+
+   for(;i<n;i++)
+   {
+      if(i % 64 == 0)
+         masks[i / 64] = 0;
+      masks[i / 64] |= (uint64_t)isTokenByte(in[i]) << (i % 64);
+   }
+}
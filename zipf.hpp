@@ -0,0 +1,577 @@
+// Copyright 2003-2009 Bill Manaris, Dana Hughes, J.R. Armstrong, Thomas Zalonis, Luca Pellicoro,
+//                     Chris Wagner, Chuck McCormick
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/* zipf.hpp     Version 1.6          16-Oct-2026
+ *
+ * Header-only C++ (C++17) version of the byRank and bySize fits of zipf.c,
+ * specialized at compile time for histograms of a fixed number of bins
+ * (e.g., 7 scale degrees, 12 pitch classes, 128 MIDI pitches).
+ *
+ * Usage: zipf::by_rank(std::array<double, N> counts) and
+ *        zipf::by_size(std::array<int64_t, N> sizes,
+ *                      std::array<double, N> counts),
+ *        or, with C++20, zipf::by_rank<T>(std::span<const T> counts) and
+ *        zipf::by_size<S, T>(std::span<const S> sizes,
+ *                            std::span<const T> counts)
+ *        for counts and sizes of any integer or floating-point type.
+ *
+ * Output: slope, R2 and yint, as zipf.c's ZipfValues (with the same special
+ *         cases: slope = 0 and r2 = 0 for a single count, slope = 0 and
+ *         r2 = 1 when all counts are equal).
+ *
+ * For each N, the log10() of the ranks 1..N, their sums and the sorting
+ * network of byRank (Batcher's odd-even merge sort) are computed at compile
+ * time, and the network is unrolled into straight-line min/max code (up to
+ * 128 bins; past that, it is applied by a loop). Counts and sizes that are
+ * integers up to 1024 have their log10() looked up in a table (filled on
+ * first use). The std::array versions allocate nothing; the std::span
+ * version of by_rank allocates its sorted copy, or its tally, in a
+ * std::vector, and looks the log10() of the first 1024 ranks up in a
+ * compile-time table too. The results agree with byRank() and bySize() up
+ * to the rounding of their sums.
+ *
+ * The networks pay off for small histograms: on small integer counts,
+ * by_rank<N> fits 7 or 12 bins 3-5 times faster than byRankInto(), but
+ * 128 or 256 bins slower than its counting sort (make bench, case fixed,
+ * measures this); byRankBatchEqual() is faster than either for batches.
+ *
+ * Unlike zipf.c, erroneous input (counts or sizes that are not strictly
+ * positive) raises std::invalid_argument, as in zipf.py and zipf.java.
+ *
+ */
+
+#ifndef ZIPF_HPP
+#define ZIPF_HPP
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <algorithm>
+#include <span>
+#include <type_traits>
+#include <vector>
+#endif
+
+namespace zipf
+{
+
+//*****************************************************************************
+// The zipf values of a fit (the same layout as zipf.c's ZipfValues).
+//*****************************************************************************
+struct values
+{
+   float slope;
+   float r2;
+   float yint;
+};
+
+namespace detail
+{
+
+//*****************************************************************************
+// log10() for constant expressions: splits x into 2^e * m
+// (sqrt(1/2) <= m < sqrt(2)) and sums log(m) = 2 f (1 + f^2/3 + f^4/5 + ...),
+// f = (m-1)/(m+1), until the terms no longer change it (to within an ulp or
+// so of libm for the ranks it is used for).
+//*****************************************************************************
+constexpr double constexpr_log10(double x)
+{
+   const double ln2 = 0.693147180559945309417232121458;
+   const double ln10 = 2.30258509299404568401799145468;
+   const double sqrt2 = 1.41421356237309504880168872421;
+   int e = 0;
+
+   while(x >= sqrt2)     { x /= 2.0; e++; }
+   while(x < sqrt2 / 2.0) { x *= 2.0; e--; }
+
+   double f = (x - 1.0) / (x + 1.0), f2 = f * f;
+   double term = f, sum = 0.0, previous = -1.0;
+   for(int k=1;sum!=previous;k+=2)
+   {
+      previous = sum;
+      sum += term / k;
+      term *= f2;
+   }
+
+   return (e * ln2 + 2.0 * sum) / ln10;
+}
+
+//*****************************************************************************
+// log10() of the ranks: rank_logs<N>::table[r] = log10(r) for 1 <= r <= N,
+// and the sums of the logs and of their squares over 1..N (the rank-only
+// regression sums of byRank, sumX and sumX2).
+//*****************************************************************************
+template<std::size_t N>
+struct rank_logs
+{
+   static constexpr std::array<double, N + 1> make_table()
+   {
+      std::array<double, N + 1> table {};
+      for(std::size_t rank=1;rank<=N;rank++)
+         table[rank] = constexpr_log10((double)rank);
+      return table;
+   }
+
+   static constexpr std::array<double, N + 1> table = make_table();
+
+   static constexpr double make_sum(int power)
+   {
+      double sum = 0.0;
+      for(std::size_t rank=1;rank<=N;rank++)
+         sum += power == 1 ? table[rank] : table[rank] * table[rank];
+      return sum;
+   }
+
+   static constexpr double sum = make_sum(1);
+   static constexpr double square_sum = make_sum(2);
+};
+
+//*****************************************************************************
+// log10() of the integers: integer_logs()[k] = log10(k) for 1 <= k <= 1024,
+// from std::log10() (as zipf.c's table of log10() of the integers), filled
+// on first use. log10_of() looks counts and sizes that are such integers up
+// in it, and computes the others.
+//*****************************************************************************
+constexpr std::size_t integer_log_max = 1024;
+
+inline const std::array<double, integer_log_max + 1> &integer_logs()
+{
+   static const std::array<double, integer_log_max + 1> logs = []
+   {
+      std::array<double, integer_log_max + 1> table {};
+      for(std::size_t k=1;k<=integer_log_max;k++)
+         table[k] = std::log10((double)k);
+      return table;
+   }();
+
+   return logs;
+}
+
+inline double log10_of(const std::array<double, integer_log_max + 1> &logs, double x)
+{
+   // (false for NaNs, which std::log10() then passes on)
+   if(x >= 1.0 && x <= (double)integer_log_max && x == (double)(std::size_t)x)
+      return logs[(std::size_t)x];
+
+   return std::log10(x);
+}
+
+inline double log10_of(const std::array<double, integer_log_max + 1> &logs, std::int64_t size)
+{
+   return size <= (std::int64_t)integer_log_max ? logs[(std::size_t)size] : std::log10((double)size);
+}
+
+//*****************************************************************************
+// Batcher's odd-even merge sorting network for N elements (as
+// sortingNetwork() in zipf.c): the network for the next power of two, less
+// the comparators that would touch the padding. network_size() counts the
+// comparators, network<N>::comparators lists them as (lower, higher)
+// index pairs.
+//*****************************************************************************
+template<std::size_t N>
+constexpr std::size_t network_size()
+{
+   std::size_t count = 0;
+   for(std::size_t p=1;p<N;p*=2)
+      for(std::size_t k=p;k>=1;k/=2)
+         for(std::size_t j=k%p;j+k<N;j+=2*k)
+            for(std::size_t i=0;i<k && i+j+k<N;i++)
+               if((i + j) / (2 * p) == (i + j + k) / (2 * p))
+                  count++;
+   return count;
+}
+
+struct comparator
+{
+   std::size_t lo;
+   std::size_t hi;
+};
+
+template<std::size_t N>
+struct network
+{
+   static constexpr std::array<comparator, network_size<N>()> make()
+   {
+      std::array<comparator, network_size<N>()> comparators {};
+      std::size_t count = 0;
+      for(std::size_t p=1;p<N;p*=2)
+         for(std::size_t k=p;k>=1;k/=2)
+            for(std::size_t j=k%p;j+k<N;j+=2*k)
+               for(std::size_t i=0;i<k && i+j+k<N;i++)
+                  if((i + j) / (2 * p) == (i + j + k) / (2 * p))
+                  {
+                     comparators[count].lo = i + j;
+                     comparators[count].hi = i + j + k;
+                     count++;
+                  }
+      return comparators;
+   }
+
+   static constexpr std::array<comparator, network_size<N>()> comparators = make();
+};
+
+//*****************************************************************************
+// One comparator of the network: leaves the smaller of the two counts at
+// index Lo and the larger at Hi (as selects, not branches).
+//*****************************************************************************
+template<std::size_t Lo, std::size_t Hi, std::size_t N>
+inline void compare_exchange(std::array<double, N> &counts)
+{
+   // two separate compares, so that they compile to min and max
+   // instructions rather than to a conditional swap
+   double a = counts[Lo], b = counts[Hi];
+   counts[Lo] = b < a ? b : a;
+   counts[Hi] = a < b ? b : a;
+}
+
+//*****************************************************************************
+// Sorts the counts in ascending order with the network for N, unrolled
+// into one compare_exchange() per comparator (up to network_max bins).
+//*****************************************************************************
+constexpr std::size_t network_max = 128;
+
+template<std::size_t N, std::size_t... I>
+inline void sort_network(std::array<double, N> &counts, std::index_sequence<I...>)
+{
+   (compare_exchange<network<N>::comparators[I].lo, network<N>::comparators[I].hi>(counts), ...);
+}
+
+template<std::size_t N>
+inline void sort(std::array<double, N> &counts)
+{
+   // past network_max bins, unrolling takes too long to compile, so the
+   // comparators are applied by a loop over the table instead
+   if constexpr(N <= network_max)
+      sort_network(counts, std::make_index_sequence<network_size<N>()>());
+   else
+      for(const comparator &c : network<N>::comparators)
+      {
+         double a = counts[c.lo], b = counts[c.hi];
+         counts[c.lo] = b < a ? b : a;
+         counts[c.hi] = a < b ? b : a;
+      }
+}
+
+//*****************************************************************************
+// Turns the regression sums of n points into the zipf values, handling
+// the monotonous and uniformly distributed cases (as finishSlopeR2() in
+// zipf.c, which this follows operation by operation).
+//*****************************************************************************
+inline values finish(std::size_t numPoints, bool allEqual, double sumX, double sumY, double sumXY, double sumX2, double sumY2)
+{
+   double slope, r2, yint;
+   double n = (double)numPoints;
+
+   if(numPoints == 1)
+   {
+      slope = 0.0;
+      r2 = 0.0;
+      sumX = sumY = 0.0;
+   }
+   else if(allEqual)
+   {
+      slope = 0.0;
+      r2 = 1.0;
+      sumX = sumY = 0.0;
+   }
+   else
+   {
+      if((n*sumX2 - sumX*sumX) == 0.0)
+         slope = 0.0;
+      else
+         slope = ((n*sumXY - sumX*sumY) / (n*sumX2 - sumX*sumX));
+
+      if(std::sqrt((n*sumX2 - sumX*sumX) * (n*sumY2 - sumY*sumY)) == 0.0)
+      {
+         r2 = 0.0;
+      }
+      else
+      {
+         r2 = (n*sumXY - sumX*sumY)/(std::sqrt(n*sumX2 - sumX*sumX)*std::sqrt(n*sumY2 - sumY*sumY));
+         r2 = r2 * r2;
+      }
+   }
+
+   yint = (sumY - slope * sumX) / n;
+
+   return values { (float)slope, (float)r2, (float)yint };
+}
+
+} // namespace detail
+
+//*****************************************************************************
+// The byRank distribution plots the values (y-axis)
+// against the ranks of the values from largest to smallest
+// (x-axis) in log-log scale. The ranks are generated automatically.
+//
+// The counts are taken by value and sorted in place by the network for N.
+//*****************************************************************************
+template<std::size_t N>
+values by_rank(std::array<double, N> counts)
+{
+   static_assert(N > 0, "Counts should contain at least one element.");
+
+   const std::array<double, detail::integer_log_max + 1> &logs = detail::integer_logs();
+   double sumY = 0.0, sumXY = 0.0, sumY2 = 0.0;
+   bool positive = true;
+
+   detail::sort(counts);
+
+   // the smallest count has rank N, the largest rank 1
+   for(std::size_t index=0;index<N;index++)
+   {
+      double x = detail::rank_logs<N>::table[N - index];
+      double y = detail::log10_of(logs, counts[index]);
+      positive &= counts[index] > 0.0;   // false for NaNs too
+      sumY  += y;
+      sumXY += x * y;
+      sumY2 += y * y;
+   }
+
+   if(!positive)
+      throw std::invalid_argument("Counts and values should be strictly positive.");
+
+   return detail::finish(N, counts[0] == counts[N - 1], detail::rank_logs<N>::sum, sumY, sumXY,
+                         detail::rank_logs<N>::square_sum, sumY2);
+}
+
+//*****************************************************************************
+// The bySize distribution plots the values (y-axis)
+// against the supplied keys (x-axis) in log-log scale.
+//*****************************************************************************
+template<std::size_t N>
+values by_size(const std::array<std::int64_t, N> &sizes, const std::array<double, N> &counts)
+{
+   static_assert(N > 0, "Counts should contain at least one element.");
+
+   const std::array<double, detail::integer_log_max + 1> &logs = detail::integer_logs();
+   double sumX = 0.0, sumY = 0.0, sumXY = 0.0, sumX2 = 0.0, sumY2 = 0.0;
+   bool positive = true, allEqual = true;
+
+   for(std::size_t index=0;index<N;index++)
+   {
+      if(sizes[index] <= 0)
+         throw std::invalid_argument("Ranks should be strictly positive.");
+
+      double x = detail::log10_of(logs, sizes[index]);
+      double y = detail::log10_of(logs, counts[index]);
+      positive &= counts[index] > 0.0;
+      allEqual &= counts[index] == counts[0];
+      sumX  += x;
+      sumY  += y;
+      sumXY += x * y;
+      sumX2 += x * x;
+      sumY2 += y * y;
+   }
+
+   if(!positive)
+      throw std::invalid_argument("Counts and values should be strictly positive.");
+
+   return detail::finish(N, allEqual, sumX, sumY, sumXY, sumX2, sumY2);
+}
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+
+//*****************************************************************************
+// Type-generic versions (C++20) of the fits, over std::span: the counts may
+// be of any integer or floating-point type, and the sizes of bySize of any
+// integer or floating-point type, so data held as, e.g., uint32 counts is
+// fitted without first being converted into a double array.
+//
+// Integer counts get their own kernels: byRank sorts them by counting sort
+// when they are smaller than their number (as zipf.c does), and both fits
+// take log10() only once per run of equal counts.
+//*****************************************************************************
+
+namespace detail
+{
+
+//*****************************************************************************
+// Tells whether a count or size is strictly positive (false for NaNs).
+//*****************************************************************************
+template<typename T>
+inline bool is_positive(T value)
+{
+   if constexpr(std::is_unsigned_v<T>)
+      return value != 0;
+   else
+      return value > 0;
+}
+
+//*****************************************************************************
+// Supporting function for by_rank(). Adds a run of equal counts holding
+// the ranks firstRank..lastRank (one point per rank) to the sums; the count
+// is log'ed once for the whole run, and the ranks up to span_rank_max are
+// looked up in rank_logs<span_rank_max>::table.
+//*****************************************************************************
+constexpr std::size_t span_rank_max = 1024;
+
+inline void add_run(double count, std::size_t firstRank, std::size_t lastRank, double *sums)
+{
+   const std::array<double, span_rank_max + 1> &rankLogs = rank_logs<span_rank_max>::table;
+   double y = std::log10(count);
+
+   for(std::size_t rank=lastRank;rank>=firstRank;rank--)
+   {
+      double x = rank <= span_rank_max ? rankLogs[rank] : std::log10((double)rank);
+      sums[0] += x;
+      sums[1] += y;
+      sums[2] += x * y;
+      sums[3] += x * x;
+      sums[4] += y * y;
+   }
+}
+
+//*****************************************************************************
+// Supporting function for by_rank(). Fits counts sorted in ascending order
+// (the smallest has rank n, the largest rank 1), a run of equal counts at
+// a time.
+//*****************************************************************************
+template<typename T>
+values fit_sorted(const T *sorted, std::size_t n)
+{
+   double sums[5] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+   std::size_t index, end;
+
+   for(index=0;index<n;index=end)
+   {
+      for(end=index+1;end<n && sorted[end] == sorted[index];end++)
+         ;
+      add_run((double)sorted[index], n - end + 1, n - index, sums);
+   }
+
+   return finish(n, sorted[0] == sorted[n - 1], sums[0], sums[1], sums[2], sums[3], sums[4]);
+}
+
+} // namespace detail
+
+//*****************************************************************************
+// byRank (see above) for counts of any arithmetic type T. The counts are
+// not changed; they are sorted in a copy of type T, or, for integer counts
+// smaller than their number, tallied and fitted straight from the tally.
+//*****************************************************************************
+template<typename T>
+values by_rank(std::span<const T> counts)
+{
+   static_assert(std::is_arithmetic_v<T>, "Counts should be integers or floating-point values.");
+
+   std::size_t n = counts.size();
+   bool positive = true;
+
+   if(n == 0)
+      throw std::invalid_argument("Counts should contain at least one element.");
+
+   for(T count : counts)
+      positive &= detail::is_positive(count);
+
+   if(!positive)
+      throw std::invalid_argument("Counts and values should be strictly positive.");
+
+   if constexpr(std::is_integral_v<T>)
+   {
+      T max = *std::max_element(counts.begin(), counts.end());
+
+      if((std::uint64_t)max < n)
+      {
+         std::vector<std::size_t> tally((std::size_t)max + 1, 0);
+         double sums[5] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+         std::size_t value, rank = n;
+
+         for(T count : counts)
+            tally[(std::size_t)count]++;
+
+         // ascending counts hold the ranks n, n - 1, ...
+         for(value=1;value<=(std::size_t)max;value++)
+            if(tally[value] != 0)
+            {
+               detail::add_run((double)value, rank - tally[value] + 1, rank, sums);
+               rank -= tally[value];
+            }
+
+         return detail::finish(n, tally[(std::size_t)max] == n, sums[0], sums[1], sums[2], sums[3], sums[4]);
+      }
+   }
+
+   std::vector<T> sorted(counts.begin(), counts.end());
+   std::sort(sorted.begin(), sorted.end());
+
+   return detail::fit_sorted(sorted.data(), n);
+}
+
+//*****************************************************************************
+// bySize (see above) for sizes and counts of any arithmetic types S and T.
+// For integer counts, log10() is taken once per run of equal counts.
+//*****************************************************************************
+template<typename S, typename T>
+values by_size(std::span<const S> sizes, std::span<const T> counts)
+{
+   static_assert(std::is_arithmetic_v<S> && std::is_arithmetic_v<T>, "Sizes and counts should be integers or floating-point values.");
+
+   const std::array<double, detail::integer_log_max + 1> &logs = detail::integer_logs();
+   double sumX = 0.0, sumY = 0.0, sumXY = 0.0, sumX2 = 0.0, sumY2 = 0.0;
+   double y = 0.0;
+   bool positive = true, allEqual = true;
+   std::size_t n = counts.size();
+
+   if(n == 0)
+      throw std::invalid_argument("Counts should contain at least one element.");
+
+   if(sizes.size() == 0)
+      throw std::invalid_argument("Ranks should contain at least one element.");
+
+   if(sizes.size() != n)
+      throw std::invalid_argument("Ranks and counts should have the same size.");
+
+   for(std::size_t index=0;index<n;index++)
+   {
+      if(!detail::is_positive(sizes[index]))
+         throw std::invalid_argument("Ranks should be strictly positive.");
+
+      if constexpr(std::is_integral_v<T>)
+      {
+         if(index == 0 || counts[index] != counts[index - 1])
+            y = std::log10((double)counts[index]);
+      }
+      else
+         y = std::log10((double)counts[index]);
+
+      double x = detail::log10_of(logs, (double)sizes[index]);
+      positive &= detail::is_positive(counts[index]);
+      allEqual &= counts[index] == counts[0];
+      sumX  += x;
+      sumY  += y;
+      sumXY += x * y;
+      sumX2 += x * x;
+      sumY2 += y * y;
+   }
+
+   if(!positive)
+      throw std::invalid_argument("Counts and values should be strictly positive.");
+
+   return detail::finish(n, allEqual, sumX, sumY, sumXY, sumX2, sumY2);
+}
+
+#endif // C++20
+
+} // namespace zipf
+
+#endif // ZIPF_HPP